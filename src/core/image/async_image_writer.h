@@ -0,0 +1,247 @@
+#ifndef CXXRAY_ASYNC_IMAGE_WRITER_H
+#define CXXRAY_ASYNC_IMAGE_WRITER_H
+
+#include "loaders/image_file.h"
+#include "image/image_write.h"
+#include "utils/data_array.h"
+#include "utils/profiler.h"
+#include "rgb/rgb.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <utility>
+#include <algorithm>
+
+namespace CxxRay {
+
+// saves images on a background thread so the caller can
+// go on rendering the next frame
+//
+// a frame is either handed over (the writer takes the
+// pixel array) or copied into a buffer from a small pool,
+// at most maxPending frames wait to be written and submit
+// blocks until one is done when that many are queued, so
+// memory stays bounded however fast frames come in
+struct AsyncImageWriter
+{
+    struct Job
+    {
+        std::string path = "";
+        DataArray<Rgb> pixels = DataArray<Rgb>{nullptr, 0};
+        long w = 0;
+        long h = 0;
+
+        // return the array to the pool when written
+        bool pooled = false;
+    };
+
+    size_t maxPending = 2;
+    ImageWriteMode mode = ImageWriteMode::Buffered;
+
+    std::deque<Job> queue = {};
+    std::vector<DataArray<Rgb>> pool = {};
+
+    // queued plus the one being written
+    size_t pending = 0;
+
+    // saved without an error
+    size_t written = 0;
+
+    // time submit spent waiting for room in the queue
+    double blockedMs = 0.0;
+
+    std::exception_ptr error = nullptr;
+
+    bool stopping = false;
+
+    std::mutex mutex = {};
+    std::condition_variable wake = {};
+    std::condition_variable done = {};
+
+    std::thread worker;
+
+    explicit AsyncImageWriter(
+        size_t const maxPending_ = 2,
+        ImageWriteMode const mode_ = ImageWriteMode::Buffered)
+        : maxPending{std::max<size_t>(maxPending_, 1)}
+        , mode{mode_}
+        , worker{[this]() { work(); }}
+    {
+    }
+
+    AsyncImageWriter(AsyncImageWriter const &) = delete;
+    AsyncImageWriter & operator=(AsyncImageWriter const &) = delete;
+
+    ~AsyncImageWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        worker.join();
+    }
+
+    // queue a copy of the pixels, the copy goes into a
+    // pooled array so steady streams do not allocate
+    void submit(
+        std::string const & path,
+        Rgb const * pixels,
+        long const w,
+        long const h)
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+
+        waitForRoom(lock);
+
+        Job job{};
+
+        if (!pool.empty() && pool.back().len == w * h) {
+            job.pixels = std::move(pool.back());
+            pool.pop_back();
+        } else {
+            job.pixels = DataArray<Rgb>{w * h, MemTag::Framebuffer};
+        }
+
+        job.pooled = true;
+
+        // copy outside the lock, the slot is already counted
+        pending++;
+
+        lock.unlock();
+
+        std::copy(pixels, pixels + w * h, job.pixels.data);
+
+        job.path = path;
+        job.w = w;
+        job.h = h;
+
+        enqueue(std::move(job));
+    }
+
+    // queue a finished image, the writer owns it from here
+    void submit(
+        std::string const & path,
+        DataArray<Rgb> && pixels,
+        long const w,
+        long const h)
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+
+        waitForRoom(lock);
+
+        pending++;
+
+        lock.unlock();
+
+        Job job{};
+
+        job.path = path;
+        job.pixels = std::move(pixels);
+        job.w = w;
+        job.h = h;
+
+        enqueue(std::move(job));
+    }
+
+    // block until everything queued is on disk, rethrows
+    // the first error the background thread ran into
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+
+        done.wait(lock, [this]() { return pending == 0; });
+
+        if (error != nullptr) {
+            auto e = error;
+            error = nullptr;
+
+            std::rethrow_exception(e);
+        }
+    }
+
+    void waitForRoom(std::unique_lock<std::mutex> & lock)
+    {
+        if (pending < maxPending) {
+            return;
+        }
+
+        Profiler timer;
+
+        done.wait(lock, [this]() { return pending < maxPending; });
+
+        blockedMs += timer.stop();
+    }
+
+    void enqueue(Job && job)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            queue.push_back(std::move(job));
+        }
+
+        wake.notify_one();
+    }
+
+    void work()
+    {
+        while (true)
+        {
+            Job job{};
+
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+
+                wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+
+                if (queue.empty()) {
+                    return;
+                }
+
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+
+            bool saved = true;
+
+            try {
+                saveImageFile(job.path, job.pixels.data, job.w, job.h, mode);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock{mutex};
+
+                saved = false;
+
+                if (error == nullptr) {
+                    error = std::current_exception();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+
+                if (job.pooled && pool.size() < maxPending) {
+                    pool.push_back(std::move(job.pixels));
+                }
+
+                pending--;
+
+                if (saved) {
+                    written++;
+                }
+            }
+
+            done.notify_all();
+        }
+    }
+};
+
+} // namespace CxxRay
+
+#endif
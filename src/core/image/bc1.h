@@ -0,0 +1,406 @@
+#ifndef CXXRAY_BC1_H
+#define CXXRAY_BC1_H
+
+#include "rgb/rgb_byte.h"
+
+#include "global/global.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+namespace CxxRay {
+
+// BC1 (DXT1) compressed block of 4x4 texels, 8 bytes for
+// what takes 48 uncompressed
+//
+// two RGB 565 end points and a 2 bit index per texel into
+// a palette of the end points and the colors a third and
+// two thirds of the way between them, texels in row order
+struct Bc1Block
+{
+    uint16_t c0 = 0;
+    uint16_t c1 = 0;
+    uint32_t indices = 0;
+};
+
+static_assert(sizeof(Bc1Block) == 8, "Bc1Block must be 8 packed bytes");
+
+namespace bc1
+{
+    constexpr long kBlockShift = 2;
+    constexpr long kBlock = 1l << kBlockShift;
+
+    inline
+    long
+    blocksAcross(
+        long const n)
+    {
+        return (n + kBlock - 1) >> kBlockShift;
+    }
+
+    inline
+    long
+    blockCount(
+        long const w,
+        long const h)
+    {
+        return blocksAcross(w) * blocksAcross(h);
+    }
+
+    inline
+    uint16_t
+    to565(
+        Real const r,
+        Real const g,
+        Real const b)
+    {
+        auto const q = [](Real const v, Real const top) {
+            return static_cast<unsigned>(std::clamp(std::lround(v * top / 255), 0l, static_cast<long>(top)));
+        };
+
+        return static_cast<uint16_t>(q(r, 31) << 11 | q(g, 63) << 5 | q(b, 31));
+    }
+
+    // expand to 8 bits, repeating the high bits in the low
+    inline
+    void
+    from565(
+        uint16_t const c,
+        int & r,
+        int & g,
+        int & b)
+    {
+        auto const r5 = (c >> 11) & 31;
+        auto const g6 = (c >> 5) & 63;
+        auto const b5 = c & 31;
+
+        r = (r5 << 3) | (r5 >> 2);
+        g = (g6 << 2) | (g6 >> 4);
+        b = (b5 << 3) | (b5 >> 2);
+    }
+
+    // the palette color picked by index sel
+    //
+    // with c0 > c1 the 4 colors are the end points and two
+    // blends, otherwise (never written here) the midpoint
+    // and black
+    inline
+    Rgb
+    paletteColor(
+        Bc1Block const & block,
+        unsigned const sel)
+    {
+        int r0 = 0, g0 = 0, b0 = 0;
+        int r1 = 0, g1 = 0, b1 = 0;
+
+        from565(block.c0, r0, g0, b0);
+        from565(block.c1, r1, g1, b1);
+
+        int r = r0, g = g0, b = b0;
+
+        if (sel == 1) {
+            r = r1; g = g1; b = b1;
+        } else if (sel >= 2) {
+            if (block.c0 > block.c1) {
+                // a third of the way from the nearer end point
+                auto const w0 = sel == 2 ? 2 : 1;
+                auto const w1 = 3 - w0;
+
+                r = (w0 * r0 + w1 * r1 + 1) / 3;
+                g = (w0 * g0 + w1 * g1 + 1) / 3;
+                b = (w0 * b0 + w1 * b1 + 1) / 3;
+            } else if (sel == 2) {
+                r = (r0 + r1) / 2;
+                g = (g0 + g1) / 2;
+                b = (b0 + b1) / 2;
+            } else {
+                r = 0; g = 0; b = 0;
+            }
+        }
+
+        Rgb p;
+        p.r = static_cast<ByteT>(r);
+        p.g = static_cast<ByteT>(g);
+        p.b = static_cast<ByteT>(b);
+        return p;
+    }
+
+    // how much of end point 0 each index holds
+    constexpr Real kWeight0[4] = {1.0, 0.0, 2.0 / 3.0, 1.0 / 3.0};
+
+    // pick each texel's nearest palette color, returns the
+    // summed squared error
+    inline
+    long
+    assignIndices(
+        Bc1Block & block,
+        Rgb const (&texels)[16])
+    {
+        Rgb palette[4];
+
+        for (unsigned i = 0; i < 4; i++) {
+            palette[i] = paletteColor(block, i);
+        }
+
+        long total = 0;
+
+        block.indices = 0;
+
+        for (unsigned i = 0; i < 16; i++)
+        {
+            long best = -1;
+            unsigned sel = 0;
+
+            for (unsigned k = 0; k < 4; k++)
+            {
+                long const dr = texels[i].r - palette[k].r;
+                long const dg = texels[i].g - palette[k].g;
+                long const db = texels[i].b - palette[k].b;
+
+                long const err = dr * dr + dg * dg + db * db;
+
+                if (best < 0 || err < best) {
+                    best = err;
+                    sel = k;
+                }
+            }
+
+            block.indices |= sel << (2 * i);
+            total += best;
+        }
+
+        return total;
+    }
+
+    // end points spanning the texels along their principal
+    // axis, refined by least squares against the indices
+    // they give
+    inline
+    Bc1Block
+    encodeBlock(
+        Rgb const (&texels)[16])
+    {
+        Real mean[3] = {0, 0, 0};
+
+        for (auto const & t : texels) {
+            mean[0] += t.r;
+            mean[1] += t.g;
+            mean[2] += t.b;
+        }
+
+        for (auto & m : mean) {
+            m /= 16;
+        }
+
+        Real cov[3][3] = {};
+
+        for (auto const & t : texels)
+        {
+            Real const d[3] = {t.r - mean[0], t.g - mean[1], t.b - mean[2]};
+
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++) {
+                    cov[i][j] += d[i] * d[j];
+                }
+            }
+        }
+
+        // power iteration for the principal axis, starting
+        // from the covariance of the channel that varies most
+        // since a fixed start can be orthogonal to the axis
+        int top = 0;
+
+        for (int i = 1; i < 3; i++) {
+            if (cov[i][i] > cov[top][top]) {
+                top = i;
+            }
+        }
+
+        Real axis[3] = {cov[top][0], cov[top][1], cov[top][2]};
+
+        if (cov[top][top] <= 0) {
+            axis[0] = axis[1] = axis[2] = 1;
+        }
+
+        for (int iter = 0; iter < 8; iter++)
+        {
+            Real next[3] = {0, 0, 0};
+
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++) {
+                    next[i] += cov[i][j] * axis[j];
+                }
+            }
+
+            auto const len = std::max({std::abs(next[0]), std::abs(next[1]), std::abs(next[2])});
+
+            if (len <= 0) {
+                break;
+            }
+
+            for (int i = 0; i < 3; i++) {
+                axis[i] = next[i] / len;
+            }
+        }
+
+        // the texels furthest apart along the axis
+        Real lo = 0;
+        Real hi = 0;
+
+        for (auto const & t : texels)
+        {
+            auto const p = (t.r - mean[0]) * axis[0] + (t.g - mean[1]) * axis[1] + (t.b - mean[2]) * axis[2];
+
+            lo = std::min(lo, p);
+            hi = std::max(hi, p);
+        }
+
+        auto const axisLen2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+        Real e0[3];
+        Real e1[3];
+
+        for (int i = 0; i < 3; i++) {
+            e0[i] = mean[i] + axis[i] * hi / axisLen2;
+            e1[i] = mean[i] + axis[i] * lo / axisLen2;
+        }
+
+        Bc1Block best{};
+        long bestErr = -1;
+
+        for (int pass = 0; pass < 3; pass++)
+        {
+            Bc1Block block{};
+
+            block.c0 = to565(e0[0], e0[1], e0[2]);
+            block.c1 = to565(e1[0], e1[1], e1[2]);
+
+            // c0 > c1 selects the 4 color palette, equal end
+            // points only need index 0
+            if (block.c0 < block.c1) {
+                std::swap(block.c0, block.c1);
+                std::swap(e0, e1);
+            }
+
+            long err = 0;
+
+            if (block.c0 == block.c1)
+            {
+                err = 0;
+
+                auto const p = paletteColor(block, 0);
+
+                for (auto const & t : texels) {
+                    err += (t.r - p.r) * (t.r - p.r) + (t.g - p.g) * (t.g - p.g) + (t.b - p.b) * (t.b - p.b);
+                }
+            }
+            else
+            {
+                err = assignIndices(block, texels);
+            }
+
+            if (bestErr < 0 || err < bestErr) {
+                best = block;
+                bestErr = err;
+            }
+
+            if (block.c0 == block.c1 || err == 0) {
+                break;
+            }
+
+            // least squares end points for these indices
+            Real aa = 0, ab = 0, bb = 0;
+            Real ax[3] = {0, 0, 0};
+            Real bx[3] = {0, 0, 0};
+
+            for (unsigned i = 0; i < 16; i++)
+            {
+                auto const a = kWeight0[(block.indices >> (2 * i)) & 3];
+                auto const b = 1 - a;
+
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+
+                Real const x[3] = {static_cast<Real>(texels[i].r), static_cast<Real>(texels[i].g), static_cast<Real>(texels[i].b)};
+
+                for (int c = 0; c < 3; c++) {
+                    ax[c] += a * x[c];
+                    bx[c] += b * x[c];
+                }
+            }
+
+            auto const det = aa * bb - ab * ab;
+
+            if (std::abs(det) < 1e-9) {
+                break;
+            }
+
+            for (int c = 0; c < 3; c++) {
+                e0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / det, 0.0, 255.0);
+                e1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / det, 0.0, 255.0);
+            }
+        }
+
+        return best;
+    }
+
+    // compress a row major w by h image, blocks past the
+    // right and top edges repeat the edge texels
+    inline
+    void
+    encodeImage(
+        Rgb const * pixels,
+        long const w,
+        long const h,
+        Bc1Block * out)
+    {
+        auto const bw = blocksAcross(w);
+        auto const bh = blocksAcross(h);
+
+        for (long by = 0; by < bh; by++)
+        {
+            for (long bx = 0; bx < bw; bx++)
+            {
+                Rgb texels[16];
+
+                for (long j = 0; j < kBlock; j++)
+                {
+                    auto const y = std::min(by * kBlock + j, h - 1);
+
+                    for (long i = 0; i < kBlock; i++)
+                    {
+                        auto const x = std::min(bx * kBlock + i, w - 1);
+
+                        texels[j * kBlock + i] = pixels[y * w + x];
+                    }
+                }
+
+                out[by * bw + bx] = encodeBlock(texels);
+            }
+        }
+    }
+}
+
+// texel at column x of row y of a BC1 compressed w wide image
+inline
+Rgb
+bc1Texel(
+    Bc1Block const * blocks,
+    long const w,
+    long const x,
+    long const y)
+{
+    using namespace bc1;
+
+    auto const & block = blocks[(y >> kBlockShift) * blocksAcross(w) + (x >> kBlockShift)];
+
+    auto const i = (y & (kBlock - 1)) * kBlock + (x & (kBlock - 1));
+
+    return paletteColor(block, (block.indices >> (2 * i)) & 3);
+}
+
+} // namespace CxxRay
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef CXXRAY_COST_HEATMAP_H
+#define CXXRAY_COST_HEATMAP_H
+
+#include "image/pixel.h"
+#include "rgb/rgb.h"
+#include "utils/data_array.h"
+
+#include "global/global.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+namespace CxxRay {
+
+// per tile counters of the work done by the rasterizer,
+// a tile size of one counts every pixel separately
+//
+// - triangles: triangles whose bounding box overlaps the tile
+// - depthTests: pixels inside a triangle that were depth tested
+// - shaded: pixels that passed the depth test and were shaded
+struct CostHeatmap
+{
+    using CountArray = std::vector<uint32_t>;
+
+    PixVal w = 0;
+    PixVal h = 0;
+    PixVal tile = 8;
+
+    PixVal tilesX = 0;
+    PixVal tilesY = 0;
+
+    CountArray triangles = {};
+    CountArray depthTests = {};
+    CountArray shaded = {};
+
+    CostHeatmap()
+    {
+    }
+
+    CostHeatmap(
+        PixVal const w_,
+        PixVal const h_,
+        PixVal const tile_ = 8)
+        : w{w_}
+        , h{h_}
+        , tile{tile_ > 0 ? tile_ : 1}
+    {
+        tilesX = (w + tile - 1) / tile;
+        tilesY = (h + tile - 1) / tile;
+
+        auto const len = static_cast<size_t>(tilesX * tilesY);
+
+        triangles.assign(len, 0);
+        depthTests.assign(len, 0);
+        shaded.assign(len, 0);
+    }
+
+    size_t tileIndex(
+        PixVal const x,
+        PixVal const y) const
+    {
+        return static_cast<size_t>((y / tile) * tilesX + (x / tile));
+    }
+
+    // count a triangle against every tile its
+    // (clamped) pixel bounding box overlaps
+    void addTriangle(
+        PixVal const xmin, PixVal const xmax,
+        PixVal const ymin, PixVal const ymax)
+    {
+        if (xmax <= xmin || ymax <= ymin) {
+            return;
+        }
+
+        auto const tx0 = xmin / tile;
+        auto const ty0 = ymin / tile;
+        auto const tx1 = std::min((xmax - 1) / tile, tilesX - 1);
+        auto const ty1 = std::min((ymax - 1) / tile, tilesY - 1);
+
+        for (PixVal ty = ty0; ty <= ty1; ty++)
+        {
+            for (PixVal tx = tx0; tx <= tx1; tx++)
+            {
+                triangles[static_cast<size_t>(ty * tilesX + tx)]++;
+            }
+        }
+    }
+
+    void addDepthTest(PixVal const x, PixVal const y)
+    {
+        depthTests[tileIndex(x, y)]++;
+    }
+
+    void addShade(PixVal const x, PixVal const y)
+    {
+        shaded[tileIndex(x, y)]++;
+    }
+};
+
+// false color ramp from black through blue, green,
+// yellow and red up to white for t in [0, 1]
+inline
+Rgb
+heatColor(
+    Real const t_)
+{
+    Real const t = std::clamp(t_, 0.0, 1.0);
+
+    constexpr int kStops = 6;
+
+    static Real const stops[kStops][3] = {
+        {0.0, 0.0, 0.0},
+        {0.0, 0.0, 1.0},
+        {0.0, 1.0, 0.0},
+        {1.0, 1.0, 0.0},
+        {1.0, 0.0, 0.0},
+        {1.0, 1.0, 1.0}
+    };
+
+    Real const pos = t * (kStops - 1);
+    auto const i = std::min(static_cast<int>(pos), kStops - 2);
+    Real const f = pos - i;
+
+    auto const mix = [&](int const c) {
+        return stops[i][c] + (stops[i + 1][c] - stops[i][c]) * f;
+    };
+
+    return Rgb{mix(0), mix(1), mix(2)};
+}
+
+inline
+uint32_t
+maxCount(
+    CostHeatmap::CountArray const & counts)
+{
+    uint32_t out = 0;
+
+    for (auto const c : counts) {
+        out = std::max(out, c);
+    }
+
+    return out;
+}
+
+// expand per tile counts to a full size false color
+// image, counts are log scaled against the largest one
+// so both hot spots and the background stay visible
+inline
+DataArray<Rgb>
+heatmapImage(
+    CostHeatmap const & map,
+    CostHeatmap::CountArray const & counts)
+{
+    DataArray<Rgb> img{map.w * map.h};
+
+    auto const top = maxCount(counts);
+
+    Real const scale = top > 0
+        ? 1.0 / std::log1p(static_cast<Real>(top))
+        : 0.0;
+
+    for (PixVal y = 0; y < map.h; y++)
+    {
+        for (PixVal x = 0; x < map.w; x++)
+        {
+            auto const c = counts[map.tileIndex(x, y)];
+
+            img.data[y * map.w + x] = heatColor(std::log1p(static_cast<Real>(c)) * scale);
+        }
+    }
+
+    return img;
+}
+
+} // namespace CxxRay
+
+#endif
@@ -22,8 +22,8 @@ struct DepthBufImage
     PixVal h = kImageDefaultHeight;
     PixVal size = kImageDefaultSize;
 
-    PixelArray pixelArray = PixelArray{kImageDefaultSize};
-    ZbufArray zbufArray = ZbufArray{kImageDefaultSize};
+    PixelArray pixelArray = PixelArray{kImageDefaultSize, MemTag::Framebuffer};
+    ZbufArray zbufArray = ZbufArray{kImageDefaultSize, MemTag::Framebuffer};
 
     Rgb * pixels;
     Real * zbuf;
@@ -42,8 +42,8 @@ struct DepthBufImage
         : w{w_}
         , h{h_}
         , size{w * h}
-        , pixelArray{w * h}
-        , zbufArray{w * h}
+        , pixelArray{w * h, MemTag::Framebuffer}
+        , zbufArray{w * h, MemTag::Framebuffer}
     {
         pixels = pixelArray.data;
         zbuf = zbufArray.data;
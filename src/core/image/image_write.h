@@ -0,0 +1,38 @@
+#ifndef CXXRAY_IMAGE_WRITE_H
+#define CXXRAY_IMAGE_WRITE_H
+
+#include <vector>
+#include <cstddef>
+
+namespace CxxRay {
+
+// how the image savers get bytes to disk
+//
+// - Buffered: pixels are converted a block at a time into
+//   a reused buffer which is written out in large pieces
+// - Mapped: the output file is sized up front, mapped and
+//   pixels converted straight into it, falling back to
+//   Buffered if the file can not be mapped
+enum class ImageWriteMode
+{
+    Buffered,
+    Mapped
+};
+
+// bytes converted per write in Buffered mode
+constexpr size_t kImageWriteBlock = 1 << 20;
+
+// per thread scratch for the savers, kept between calls
+// so saving every frame does not allocate
+inline
+std::vector<unsigned char> &
+imageWriteBuffer()
+{
+    thread_local std::vector<unsigned char> buffer(kImageWriteBlock);
+
+    return buffer;
+}
+
+} // namespace CxxRay
+
+#endif
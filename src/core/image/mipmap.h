@@ -0,0 +1,153 @@
+#ifndef CXXRAY_MIPMAP_H
+#define CXXRAY_MIPMAP_H
+
+#include "image/texture_image.h"
+#include "rgb/rgb_byte.h"
+#include "utils/data_array.h"
+
+#include <vector>
+#include <algorithm>
+
+namespace CxxRay {
+
+// sizes of levels 1 and up of a w by h texture's mip
+// chain, halving (rounding down) until both sides are 1
+inline
+std::vector<MipLevel>
+mipLevelSizes(
+    long const w,
+    long const h)
+{
+    std::vector<MipLevel> levels;
+
+    auto lw = w;
+    auto lh = h;
+
+    while (lw > 1 || lh > 1)
+    {
+        lw = std::max(lw / 2, 1l);
+        lh = std::max(lh / 2, 1l);
+
+        levels.push_back(MipLevel{lw, lh, nullptr});
+    }
+
+    return levels;
+}
+
+// texels in every level after the first
+inline
+long
+mipChainTexels(
+    std::vector<MipLevel> const & levels,
+    TexelLayout const layout = TexelLayout::RowMajor)
+{
+    long texels = 0;
+
+    for (auto const & level : levels) {
+        texels += layoutTexels(layout, level.w, level.h);
+    }
+
+    return texels;
+}
+
+// point each level at its texels, stored one after another
+// starting at data
+inline
+void
+placeMipLevels(
+    std::vector<MipLevel> & levels,
+    Rgb const * data,
+    TexelLayout const layout = TexelLayout::RowMajor)
+{
+    for (auto & level : levels)
+    {
+        level.pixels = data;
+        data += layoutTexels(layout, level.w, level.h);
+    }
+}
+
+// average 2x2 blocks of src into dst, on an odd side the
+// last row or column is folded into the block before it
+inline
+void
+downsampleLevel(
+    MipLevel const & src,
+    Rgb * dst,
+    long const dw,
+    long const dh)
+{
+    for (long y = 0; y < dh; y++)
+    {
+        auto const y0 = std::min(2 * y, src.h - 1);
+        auto const y1 = y == dh - 1 ? src.h - 1 : std::min(2 * y + 1, src.h - 1);
+
+        for (long x = 0; x < dw; x++)
+        {
+            auto const x0 = std::min(2 * x, src.w - 1);
+            auto const x1 = x == dw - 1 ? src.w - 1 : std::min(2 * x + 1, src.w - 1);
+
+            unsigned r = 0;
+            unsigned g = 0;
+            unsigned b = 0;
+            unsigned n = 0;
+
+            for (auto yy = y0; yy <= y1; yy++)
+            {
+                for (auto xx = x0; xx <= x1; xx++)
+                {
+                    auto const & p = src.pixels[yy * src.w + xx];
+
+                    r += p.r;
+                    g += p.g;
+                    b += p.b;
+                    n++;
+                }
+            }
+
+            auto & q = dst[y * dw + x];
+
+            // rounded to nearest
+            q.r = static_cast<ByteT>((r + n / 2) / n);
+            q.g = static_cast<ByteT>((g + n / 2) / n);
+            q.b = static_cast<ByteT>((b + n / 2) / n);
+        }
+    }
+}
+
+// build the mip chain of an in memory row major texture,
+// each level box filtered from the one before, tiled
+// textures only have level 0 since their texels are never
+// all in memory
+inline
+void
+generateMips(
+    TextureImage & img)
+{
+    if (img.tiled() || img.layout != TexelLayout::RowMajor || img.pixels == nullptr || img.w < 1 || img.h < 1) {
+        return;
+    }
+
+    auto levels = mipLevelSizes(img.w, img.h);
+
+    img.mipArray = DataArray<Rgb>{mipChainTexels(levels), MemTag::Texture};
+
+    MipLevel src{img.w, img.h, img.pixels};
+
+    Rgb * out = img.mipArray.data;
+
+    for (auto & level : levels)
+    {
+        downsampleLevel(src, out, level.w, level.h);
+
+        level.pixels = out;
+        out += level.w * level.h;
+
+        src = level;
+    }
+
+    img.mips = std::move(levels);
+}
+
+} // namespace CxxRay
+
+#endif
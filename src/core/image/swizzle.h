@@ -0,0 +1,183 @@
+#ifndef CXXRAY_SWIZZLE_H
+#define CXXRAY_SWIZZLE_H
+
+#include "rgb/rgb_byte.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// the shuffles are built for SSSE3 function by function and
+// picked at run time, so they need no -march flag
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CXXRAY_HAS_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+namespace CxxRay {
+
+static_assert(sizeof(Rgb) == 3, "Rgb must be 3 packed bytes");
+
+namespace swizzle {
+
+    // reverse the byte order of pixels [i, n), each of bpp
+    // bytes with the first three kept
+    inline
+    void
+    scalar(
+        unsigned char const * src,
+        unsigned char * out,
+        size_t const bpp,
+        size_t i,
+        size_t const n)
+    {
+        for (; i < n; i++)
+        {
+            out[3 * i + 0] = src[bpp * i + 2];
+            out[3 * i + 1] = src[bpp * i + 1];
+            out[3 * i + 2] = src[bpp * i + 0];
+        }
+    }
+
+#ifdef CXXRAY_HAS_SSSE3
+    inline
+    bool
+    hasSsse3()
+    {
+        static bool const has = []() {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("ssse3") != 0;
+        }();
+
+        return has;
+    }
+
+    // five pixels are swapped per 16 byte shuffle, returns
+    // the first pixel left for the scalar loop
+    __attribute__((target("ssse3")))
+    inline
+    size_t
+    bgrSsse3(
+        unsigned char const * src,
+        unsigned char * out,
+        size_t const n)
+    {
+        // byte 15 is carried over unchanged and rewritten
+        // by the next step, so stop while 16 bytes remain
+        auto const mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+
+        size_t i = 0;
+
+        for (; i + 6 <= n; i += 5)
+        {
+            auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + 3 * i));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 3 * i), _mm_shuffle_epi8(v, mask));
+        }
+
+        return i;
+    }
+
+    // four pixels in, twelve bytes out, the four bytes
+    // past them are rewritten by the next step
+    __attribute__((target("ssse3")))
+    inline
+    size_t
+    bgraSsse3(
+        unsigned char const * src,
+        unsigned char * out,
+        size_t const n)
+    {
+        auto const mask = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+        size_t i = 0;
+
+        for (; i + 6 <= n; i += 4)
+        {
+            auto const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + 4 * i));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 3 * i), _mm_shuffle_epi8(v, mask));
+        }
+
+        return i;
+    }
+#else
+    inline
+    bool
+    hasSsse3()
+    {
+        return false;
+    }
+#endif
+
+} // namespace swizzle
+
+// convert n pixels stored as B, G, R bytes (the TGA
+// order) to Rgb
+//
+// on x86 CPUs with SSSE3 most pixels go through 16 byte
+// shuffles, simd false forces the scalar loop
+inline
+void
+bgrToRgb(
+    unsigned char const * src,
+    Rgb * dst,
+    size_t const n,
+    bool const simd = true)
+{
+    auto * out = reinterpret_cast<unsigned char *>(dst);
+
+    size_t i = 0;
+
+#ifdef CXXRAY_HAS_SSSE3
+    if (simd && swizzle::hasSsse3()) {
+        i = swizzle::bgrSsse3(src, out, n);
+    }
+#else
+    (void)simd;
+#endif
+
+    swizzle::scalar(src, out, 3, i, n);
+}
+
+// convert n pixels stored as B, G, R, A bytes to Rgb,
+// alpha is dropped
+inline
+void
+bgraToRgb(
+    unsigned char const * src,
+    Rgb * dst,
+    size_t const n,
+    bool const simd = true)
+{
+    auto * out = reinterpret_cast<unsigned char *>(dst);
+
+    size_t i = 0;
+
+#ifdef CXXRAY_HAS_SSSE3
+    if (simd && swizzle::hasSsse3()) {
+        i = swizzle::bgraSsse3(src, out, n);
+    }
+#else
+    (void)simd;
+#endif
+
+    swizzle::scalar(src, out, 4, i, n);
+}
+
+// the reverse of bgrToRgb, for writing TGA files
+inline
+void
+rgbToBgr(
+    Rgb const * src,
+    unsigned char * dst,
+    size_t const n,
+    bool const simd = true)
+{
+    // the swap is its own inverse
+    bgrToRgb(reinterpret_cast<unsigned char const *>(src), reinterpret_cast<Rgb *>(dst), n, simd);
+}
+
+} // namespace CxxRay
+
+#endif
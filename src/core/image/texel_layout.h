@@ -0,0 +1,116 @@
+#ifndef CXXRAY_TEXEL_LAYOUT_H
+#define CXXRAY_TEXEL_LAYOUT_H
+
+#include "rgb/rgb_byte.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace CxxRay {
+
+// how a texture's texels are ordered in memory
+//
+// RowMajor: rows one after another, bottom row first
+// Blocked:  4x4 blocks of texels in row order, the texels
+//           of a block in Morton (Z curve) order, so texels
+//           near each other in 2D are near in memory
+//           whichever way the texture is walked
+//
+// a block is 48 bytes, most fall within one cache line
+enum class TexelLayout : uint32_t
+{
+    RowMajor,
+    Blocked,
+};
+
+constexpr long kTexelBlockShift = 2;
+constexpr long kTexelBlock = 1l << kTexelBlockShift;
+
+// spread the 3 low bits of v to the even bits, enough
+// for blocks up to 8x8
+inline
+long
+mortonSpread3(
+    long const v)
+{
+    return (v & 1) | ((v & 2) << 1) | ((v & 4) << 2);
+}
+
+inline
+long
+texelBlocks(
+    long const n)
+{
+    return (n + kTexelBlock - 1) >> kTexelBlockShift;
+}
+
+// texels a w by h image takes up, blocked images are
+// padded to whole blocks
+inline
+long
+layoutTexels(
+    TexelLayout const layout,
+    long const w,
+    long const h)
+{
+    if (layout == TexelLayout::Blocked) {
+        return texelBlocks(w) * texelBlocks(h) * kTexelBlock * kTexelBlock;
+    }
+
+    return w * h;
+}
+
+// where texel (x, y) of a w wide image is stored
+inline
+long
+texelIndex(
+    TexelLayout const layout,
+    long const w,
+    long const x,
+    long const y)
+{
+    if (layout == TexelLayout::Blocked)
+    {
+        auto const block = (y >> kTexelBlockShift) * texelBlocks(w) + (x >> kTexelBlockShift);
+
+        auto const inBlock = mortonSpread3(x & (kTexelBlock - 1))
+            | (mortonSpread3(y & (kTexelBlock - 1)) << 1);
+
+        return (block << (2 * kTexelBlockShift)) | inBlock;
+    }
+
+    return y * w + x;
+}
+
+// copy a row major image into dst in the given layout,
+// padding texels repeat the nearest edge texel
+inline
+void
+reorderTexels(
+    Rgb const * src,
+    long const w,
+    long const h,
+    TexelLayout const layout,
+    Rgb * dst)
+{
+    if (layout == TexelLayout::RowMajor) {
+        std::copy(src, src + w * h, dst);
+        return;
+    }
+
+    auto const pw = texelBlocks(w) * kTexelBlock;
+    auto const ph = texelBlocks(h) * kTexelBlock;
+
+    for (long y = 0; y < ph; y++)
+    {
+        auto const sy = std::min(y, h - 1);
+
+        for (long x = 0; x < pw; x++) {
+            dst[texelIndex(layout, w, x, y)] = src[sy * w + std::min(x, w - 1)];
+        }
+    }
+}
+
+} // namespace CxxRay
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef CXXRAY_TEXTURE_COMPRESS_H
+#define CXXRAY_TEXTURE_COMPRESS_H
+
+#include "image/texture_image.h"
+#include "image/bc1.h"
+#include "rgb/rgb_byte.h"
+#include "utils/data_array.h"
+#include "utils/mapped_file.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace CxxRay {
+
+// blocks of every level of a w by h texture's chain
+inline
+long
+bc1ChainBlocks(
+    long const w,
+    long const h,
+    std::vector<MipLevel> const & mips)
+{
+    auto blocks = bc1::blockCount(w, h);
+
+    for (auto const & mip : mips) {
+        blocks += bc1::blockCount(mip.w, mip.h);
+    }
+
+    return blocks;
+}
+
+// point level 0 and each mip at its blocks, stored one
+// after another starting at data
+inline
+void
+placeBc1Levels(
+    TextureImage & img,
+    Bc1Block const * data)
+{
+    img.blocks = data;
+    data += bc1::blockCount(img.w, img.h);
+
+    for (auto & mip : img.mips)
+    {
+        mip.pixels = nullptr;
+        mip.blocks = data;
+        data += bc1::blockCount(mip.w, mip.h);
+    }
+
+    img.pixels = nullptr;
+    img.format = TextureFormat::Bc1;
+}
+
+// compress a row major texture and its mip chain to BC1,
+// the uncompressed texels are freed
+inline
+void
+compressTexture(
+    TextureImage & img)
+{
+    if (img.format != TextureFormat::Rgb8 || img.layout != TexelLayout::RowMajor || img.tiled() || img.pixels == nullptr) {
+        return;
+    }
+
+    DataArray<Bc1Block> blockArray{bc1ChainBlocks(img.w, img.h, img.mips), MemTag::Texture};
+
+    auto * out = blockArray.data;
+
+    bc1::encodeImage(img.pixels, img.w, img.h, out);
+    out += bc1::blockCount(img.w, img.h);
+
+    for (auto const & mip : img.mips)
+    {
+        bc1::encodeImage(mip.pixels, mip.w, mip.h, out);
+        out += bc1::blockCount(mip.w, mip.h);
+    }
+
+    img.blockArray = std::move(blockArray);
+
+    placeBc1Levels(img, img.blockArray.data);
+
+    img.pixelArray = DataArray<Rgb>{nullptr, 0};
+    img.mipArray = DataArray<Rgb>{nullptr, 0};
+    img.mapping = MappedFile{};
+}
+
+// peak signal to noise ratio in dB from the summed squared
+// error of n texels over all three channels, no error
+// gives 100
+inline
+double
+psnrFromError(
+    double const sum,
+    long const n)
+{
+    auto const mse = sum / (3.0 * static_cast<double>(n));
+
+    return mse > 0 ? std::min(10.0 * std::log10(255.0 * 255.0 / mse), 100.0) : 100.0;
+}
+
+// psnr of b against a
+inline
+double
+imagePsnr(
+    Rgb const * a,
+    Rgb const * b,
+    long const n)
+{
+    double sum = 0;
+
+    for (long i = 0; i < n; i++)
+    {
+        double const dr = a[i].r - b[i].r;
+        double const dg = a[i].g - b[i].g;
+        double const db = a[i].b - b[i].b;
+
+        sum += dr * dr + dg * dg + db * db;
+    }
+
+    return psnrFromError(sum, n);
+}
+
+// psnr of the full size level of b against a, read texel
+// by texel so any format and layout can be compared
+inline
+double
+texturePsnr(
+    TextureImage const & a,
+    TextureImage const & b)
+{
+    double sum = 0;
+
+    for (long y = 0; y < a.h; y++)
+    {
+        for (long x = 0; x < a.w; x++)
+        {
+            auto const p = a.texel(x, y);
+            auto const q = b.texel(x, y);
+
+            double const dr = p.r - q.r;
+            double const dg = p.g - q.g;
+            double const db = p.b - q.b;
+
+            sum += dr * dr + dg * dg + db * db;
+        }
+    }
+
+    return psnrFromError(sum, a.w * a.h);
+}
+
+} // namespace CxxRay
+
+#endif
@@ -2,37 +2,92 @@
 #define CXXRAY_TEXTURE_IMAGE_H
 
 #include "rgb/rgb_byte.h"
+#include "utils/data_array.h"
+#include "utils/mapped_file.h"
+#include "image/tiled_texture.h"
+#include "image/texel_layout.h"
+#include "image/bc1.h"
 
-#include <iostream>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace CxxRay {
 
+// how a texture's texels are encoded
+//
+// Rgb8: 3 bytes a texel, in pixels
+// Bc1:  BC1 blocks of 4x4 texels, half a byte a texel, in
+//       blocks (see image/bc1.h)
+enum class TextureFormat : uint32_t
+{
+    Rgb8,
+    Bc1,
+};
+
+// one level of a texture's mip chain, read only, pixels or
+// blocks is set depending on the texture's format
+struct MipLevel
+{
+    long w = 0;
+    long h = 0;
+
+    Rgb const * pixels = nullptr;
+    Bc1Block const * blocks = nullptr;
+};
+
 struct TextureImage
 {
     long w = 10;
     long h = 10;
 
-    std::unique_ptr<Rgb> pixelsGuard = nullptr;
+    DataArray<Rgb> pixelArray = DataArray<Rgb>{nullptr, 0};
     Rgb * pixels = nullptr;
 
+    // holds the pixels of a texture read in place from a
+    // texture cache file (see loaders/texture_cache.h),
+    // pages are only read in as texels are touched
+    MappedFile mapping = {};
+
+    // set for a texture streamed in tiles, pixels is then
+    // null and texels can only be read through texel()
+    std::shared_ptr<TiledTexture const> tiles = {};
+
+    // order of the texels of every level (see texel_layout.h)
+    TexelLayout layout = TexelLayout::RowMajor;
+
+    // a compressed texture has no pixels, its blocks live
+    // in blockArray or in the mapping
+    TextureFormat format = TextureFormat::Rgb8;
+    Bc1Block const * blocks = nullptr;
+    DataArray<Bc1Block> blockArray = DataArray<Bc1Block>{nullptr, 0};
+
+    // levels 1 and up of the mip chain (see image/mipmap.h),
+    // each half the size of the one before down to 1x1,
+    // their pixels live in mipArray or in the mapping
+    std::vector<MipLevel> mips = {};
+    DataArray<Rgb> mipArray = DataArray<Rgb>{nullptr, 0};
+
     TextureImage(
         long const w_,
         long const h_)
         : w{w_}
         , h{h_}
-        , pixelsGuard{(Rgb*)std::malloc(w_ * h_ * sizeof(Rgb))}
-        , pixels{pixelsGuard.get()}
+        , pixelArray{w_ * h_, MemTag::Texture}
+        , pixels{pixelArray.data}
     {
     }
 
+    // adopts a malloc'd array
     TextureImage(
         Rgb * dat_,
         long const w_,
         long const h_)
         : w{w_}
         , h{h_}
-        , pixelsGuard{dat_}
+        , pixelArray{dat_, w_ * h_}
         , pixels{dat_}
     {
     }
@@ -42,49 +97,159 @@ struct TextureImage
     {
     }
 
-    TextureImage(TextureImage const & img_)
-        : w{img_.w}
-        , h{img_.h}
-        , pixelsGuard{(Rgb*)std::malloc(img_.w * img_.h * sizeof(Rgb))}
-        , pixels{pixelsGuard.get()}
+    // pixels start offset_ bytes into the mapping, which is
+    // read only so they must never be written
+    TextureImage(
+        MappedFile && mapping_,
+        size_t const offset_,
+        long const w_,
+        long const h_)
+        : w{w_}
+        , h{h_}
+        , mapping{std::move(mapping_)}
     {
-        std::cout << "TextureImage#COPY_CONSTRUCTOR" << std::endl;
+        pixels = const_cast<Rgb *>(reinterpret_cast<Rgb const *>(mapping.data() + offset_));
+    }
 
-        long const len = img_.w * img_.h;
+    explicit TextureImage(
+        std::shared_ptr<TiledTexture const> tiles_)
+        : w{tiles_->w}
+        , h{tiles_->h}
+        , tiles{std::move(tiles_)}
+    {
+    }
 
-        for (long i = 0; i < len; i++)
-        {
-            pixels[i] = img_.pixels[i];
-        }
+    // textures are large and shared through handles,
+    // a copy is never wanted so it can not happen by accident
+    TextureImage(TextureImage const &) = delete;
+    TextureImage& operator=(TextureImage const &) = delete;
+
+    TextureImage(TextureImage &&) = default;
+    TextureImage& operator=(TextureImage &&) = default;
+
+    ~TextureImage() = default;
+
+    bool mapped() const
+    {
+        return mapping.isOpen();
     }
 
-    TextureImage& operator=(TextureImage const & img_)
+    bool tiled() const
     {
-        std::cout << "TextureImage#COPY_ASSIGNMENT" << std::endl;
+        return tiles != nullptr;
+    }
 
-        if (w != img_.w || h != img_.h) {
-            pixelsGuard.reset((Rgb*)std::malloc(img_.w * img_.h * sizeof(Rgb)));
+    // texel at column x of row y, rows bottom first
+    Rgb texel(
+        long const x,
+        long const y) const
+    {
+        if (tiles) {
+            return tiles->texel(x, y);
         }
 
-        w = img_.w;
-        h = img_.h;
+        if (format == TextureFormat::Bc1) {
+            return bc1Texel(blocks, w, x, y);
+        }
 
-        long const len = img_.w * img_.h;
+        return pixels[texelIndex(layout, w, x, y)];
+    }
 
-        for (long i = 0; i < len; i++)
-        {
-            pixels[i] = img_.pixels[i];
-        }
+    // level 0 is the texture itself
+    long levels() const
+    {
+        return 1 + static_cast<long>(mips.size());
+    }
 
-        return (*this);
+    long levelW(
+        long const level) const
+    {
+        return level == 0 ? w : mips[static_cast<size_t>(level - 1)].w;
     }
 
-    TextureImage(TextureImage &&) = default;
-    TextureImage& operator=(TextureImage &&) = default;
+    long levelH(
+        long const level) const
+    {
+        return level == 0 ? h : mips[static_cast<size_t>(level - 1)].h;
+    }
 
-    ~TextureImage() = default;
+    Rgb levelTexel(
+        long const level,
+        long const x,
+        long const y) const
+    {
+        if (level == 0) {
+            return texel(x, y);
+        }
+
+        auto const & mip = mips[static_cast<size_t>(level - 1)];
+
+        if (format == TextureFormat::Bc1) {
+            return bc1Texel(mip.blocks, mip.w, x, y);
+        }
+
+        return mip.pixels[texelIndex(layout, mip.w, x, y)];
+    }
 };
 
+// immutable texture shared by every mesh, material and
+// thread that uses it, the pixels are freed with the last
+// handle
+using TextureHandle = std::shared_ptr<TextureImage const>;
+
+// loaded textures by file path or generated name
+using TextureMap = std::unordered_map<std::string,TextureHandle>;
+
+inline
+TextureHandle
+makeTextureHandle(
+    TextureImage && img)
+{
+    return std::make_shared<TextureImage const>(std::move(img));
+}
+
+// reorder a row major texture and its mip chain into
+// another layout, the texels are copied into memory so a
+// mapped texture no longer needs its mapping
+inline
+void
+relayoutTexture(
+    TextureImage & img,
+    TexelLayout const layout)
+{
+    if (img.layout == layout || img.layout != TexelLayout::RowMajor || img.tiled() || img.pixels == nullptr) {
+        return;
+    }
+
+    DataArray<Rgb> pixelArray{layoutTexels(layout, img.w, img.h), MemTag::Texture};
+
+    reorderTexels(img.pixels, img.w, img.h, layout, pixelArray.data);
+
+    long mipTexels = 0;
+
+    for (auto const & mip : img.mips) {
+        mipTexels += layoutTexels(layout, mip.w, mip.h);
+    }
+
+    DataArray<Rgb> mipArray{mipTexels, MemTag::Texture};
+
+    Rgb * out = mipArray.data;
+
+    for (auto & mip : img.mips)
+    {
+        reorderTexels(mip.pixels, mip.w, mip.h, layout, out);
+
+        mip.pixels = out;
+        out += layoutTexels(layout, mip.w, mip.h);
+    }
+
+    img.pixelArray = std::move(pixelArray);
+    img.pixels = img.pixelArray.data;
+    img.mipArray = std::move(mipArray);
+    img.mapping = MappedFile{};
+    img.layout = layout;
+}
+
 } // namespace CxxRay
 
 #endif
@@ -0,0 +1,363 @@
+#ifndef CXXRAY_TILED_TEXTURE_H
+#define CXXRAY_TILED_TEXTURE_H
+
+#include "rgb/rgb_byte.h"
+#include "utils/data_array.h"
+
+#include <string>
+#include <list>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+
+namespace CxxRay {
+
+// square block of texels read from a tiled texture file
+struct TextureTile
+{
+    DataArray<Rgb> pixels = DataArray<Rgb>{nullptr, 0};
+
+    explicit TextureTile(
+        long const texels)
+        : pixels{texels, MemTag::Texture}
+    {
+    }
+};
+
+using TileHandle = std::shared_ptr<TextureTile const>;
+
+// least recently used tiles of every tiled texture, kept
+// within a byte budget
+//
+// a tile evicted while a thread still samples from it
+// stays alive until that thread moves on
+//
+// hits counts the lookups fetch() served from memory,
+// hitCount() adds the texel reads threads served from the
+// tile they fetched last
+struct TileCache
+{
+    size_t budget = 64u << 20;
+    size_t used = 0;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+
+    // tiles the file came up short for, filled with
+    // kMissingTexel instead
+    std::atomic<uint64_t> readErrors{0};
+
+    struct Entry
+    {
+        TileHandle tile;
+        size_t bytes = 0;
+        std::list<uint64_t>::iterator at;
+    };
+
+    // most recently used at the front
+    std::list<uint64_t> lru = {};
+    std::unordered_map<uint64_t,Entry> entries = {};
+
+    // each thread counts its own hits on a line of its own,
+    // so sampling never writes memory other threads do
+    struct alignas(64) ThreadHits
+    {
+        std::atomic<uint64_t> count{0};
+
+        // only the owning thread writes, a plain add is enough
+        void add()
+        {
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    };
+
+    std::list<ThreadHits> threadHits = {};
+
+    // tells caches apart in each thread's list of counters
+    uint64_t id = 0;
+
+    mutable std::mutex mutex = {};
+
+    explicit TileCache(
+        size_t const budget_ = 64u << 20)
+        : budget{budget_}
+        , id{nextId()}
+    {
+    }
+
+    static uint64_t nextId()
+    {
+        static std::atomic<uint64_t> counter{0};
+
+        return ++counter;
+    }
+
+    TileCache(TileCache const &) = delete;
+    TileCache & operator=(TileCache const &) = delete;
+
+    // the tile under key, read with load() on a miss
+    template<typename Load>
+    TileHandle fetch(
+        uint64_t const key,
+        size_t const bytes,
+        Load const & load)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+
+            auto const found = entries.find(key);
+
+            if (found != entries.end())
+            {
+                lru.splice(lru.begin(), lru, found->second.at);
+                hits.fetch_add(1, std::memory_order_relaxed);
+
+                return found->second.tile;
+            }
+        }
+
+        // read outside the lock so other tiles can be served,
+        // two threads missing the same tile both read it
+        TileHandle tile = load();
+
+        std::lock_guard<std::mutex> lock{mutex};
+
+        misses.fetch_add(1, std::memory_order_relaxed);
+
+        auto const found = entries.find(key);
+
+        if (found != entries.end()) {
+            return found->second.tile;
+        }
+
+        while (!lru.empty() && used + bytes > budget)
+        {
+            auto const old = entries.find(lru.back());
+
+            used -= old->second.bytes;
+            entries.erase(old);
+            lru.pop_back();
+
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        lru.push_front(key);
+        entries[key] = Entry{tile, bytes, lru.begin()};
+        used += bytes;
+
+        return tile;
+    }
+
+    // the calling thread's hit counter
+    ThreadHits & threadHitsOf()
+    {
+        // counters of every cache this thread has sampled
+        // through, caches are never given an id twice
+        thread_local std::vector<std::pair<uint64_t,ThreadHits *>> mine;
+
+        for (auto const & [ cacheId, counter ] : mine)
+        {
+            if (cacheId == id) {
+                return *counter;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+
+        auto & counter = threadHits.emplace_back();
+
+        mine.emplace_back(id, &counter);
+
+        return counter;
+    }
+
+    uint64_t hitCount() const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        uint64_t total = hits.load();
+
+        for (auto const & counter : threadHits) {
+            total += counter.count.load(std::memory_order_relaxed);
+        }
+
+        return total;
+    }
+
+    double hitRate() const
+    {
+        auto const h = hitCount();
+        auto const total = h + misses.load();
+
+        return total > 0 ? static_cast<double>(h) / static_cast<double>(total) : 0.0;
+    }
+
+    // between draws, a thread still sampling may lose a count
+    void resetCounters()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        hits = 0;
+        misses = 0;
+        evictions = 0;
+        readErrors = 0;
+
+        for (auto & counter : threadHits) {
+            counter.count = 0;
+        }
+    }
+};
+
+// stands in for texels that could not be read
+inline Rgb const kMissingTexel = Rgb{255, 0, 255};
+
+// texture whose pixels stay on disk as fixed size tiles
+// (see loaders/texture_cache.h), tiles are read through
+// a TileCache as texels in them are fetched
+struct TiledTexture
+{
+    long w = 0;
+    long h = 0;
+    long tileSize = 64;
+    long tilesX = 0;
+    long tilesY = 0;
+
+    // where tile 0 starts in the file, tiles follow in
+    // row order, bottom row of tiles first
+    size_t dataOffset = 0;
+
+    // tells this texture's tiles apart in the cache
+    uint64_t id = 0;
+
+    TileCache * cache = nullptr;
+
+    std::string filePath = "";
+
+    mutable std::ifstream file;
+    mutable std::mutex fileMutex;
+
+    TiledTexture(
+        std::string const & filePath_,
+        size_t const dataOffset_,
+        long const w_,
+        long const h_,
+        long const tileSize_,
+        TileCache & cache_)
+        : w{w_}
+        , h{h_}
+        , tileSize{tileSize_}
+        , tilesX{(w_ + tileSize_ - 1) / tileSize_}
+        , tilesY{(h_ + tileSize_ - 1) / tileSize_}
+        , dataOffset{dataOffset_}
+        , id{nextId()}
+        , cache{&cache_}
+        , filePath{filePath_}
+        , file{filePath_, std::ios::binary}
+    {
+    }
+
+    static uint64_t nextId()
+    {
+        static std::atomic<uint64_t> counter{0};
+
+        return ++counter;
+    }
+
+    bool isOpen() const
+    {
+        return file.is_open();
+    }
+
+    long tileTexels() const
+    {
+        return tileSize * tileSize;
+    }
+
+    TileHandle readTile(
+        long const t) const
+    {
+        auto tile = std::make_shared<TextureTile>(tileTexels());
+
+        auto const bytes = static_cast<size_t>(tileTexels()) * sizeof(Rgb);
+
+        std::lock_guard<std::mutex> lock{fileMutex};
+
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(dataOffset + static_cast<size_t>(t) * bytes));
+        file.read(reinterpret_cast<char *>(tile->pixels.data), static_cast<std::streamsize>(bytes));
+
+        // a file cut short or failing to read never leaves
+        // texels uninitialized
+        auto const got = file ? bytes : static_cast<size_t>(std::max<std::streamsize>(file.gcount(), 0));
+
+        if (got < bytes)
+        {
+            std::fill(tile->pixels.data + got / sizeof(Rgb), tile->pixels.data + tileTexels(), kMissingTexel);
+
+            cache->readErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return tile;
+    }
+
+    // texel at column x of row y, rows bottom first
+    //
+    // each thread remembers the tile it fetched last from
+    // a few textures, runs of texels from the same tile
+    // skip the cache lock and count as hits on the
+    // thread's own counter
+    Rgb texel(
+        long const x,
+        long const y) const
+    {
+        struct LastTile
+        {
+            uint64_t texture = 0;
+            long tile = -1;
+            TileHandle data = {};
+            TileCache::ThreadHits * hits = nullptr;
+        };
+
+        // faces switching between a few textures keep
+        // their own slots
+        constexpr uint64_t kSlots = 4;
+
+        thread_local LastTile slots[kSlots];
+
+        auto & last = slots[id % kSlots];
+
+        // tiles past the edge were never written
+        auto const cx = std::clamp(x, 0l, w - 1);
+        auto const cy = std::clamp(y, 0l, h - 1);
+
+        auto const t = (cy / tileSize) * tilesX + cx / tileSize;
+
+        if (last.texture != id || last.tile != t)
+        {
+            auto const key = (id << 32) | static_cast<uint64_t>(t);
+            auto const bytes = static_cast<size_t>(tileTexels()) * sizeof(Rgb);
+
+            last.data = cache->fetch(key, bytes, [this, t]() { return readTile(t); });
+            last.hits = &cache->threadHitsOf();
+            last.texture = id;
+            last.tile = t;
+        }
+        else
+        {
+            last.hits->add();
+        }
+
+        return last.data->pixels.data[(cy % tileSize) * tileSize + cx % tileSize];
+    }
+};
+
+} // namespace CxxRay
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef CXXRAY_IMAGE_FILE_H
+#define CXXRAY_IMAGE_FILE_H
+
+#include "loaders/tga.h"
+#include "loaders/ppm.h"
+#include "loaders/qoi.h"
+#include "image/image_write.h"
+#include "rgb/rgb.h"
+
+#include <string>
+#include <filesystem>
+#include <cctype>
+
+namespace CxxRay {
+
+// lower case extension including the dot, e.g. ".tga"
+inline
+std::string
+imageExtension(
+    std::string const & filePath)
+{
+    auto ext = std::filesystem::path{filePath}.extension().string();
+
+    for (auto & c : ext) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    return ext;
+}
+
+// load a texture in the format named by the extension,
+// QOI for .qoi, PPM for .ppm and TGA for anything else
+inline
+TextureImage
+loadTextureFile(
+    std::string const & filePath)
+{
+    auto const ext = imageExtension(filePath);
+
+    if (ext == ".qoi") {
+        return loadQoiFile(filePath);
+    }
+
+    if (ext == ".ppm") {
+        return loadPnmFile(filePath);
+    }
+
+    return loadTargaFile(filePath);
+}
+
+// save in the format named by the extension, QOI for
+// .qoi, PPM for .ppm and TGA for anything else
+//
+// QOI output is only known once encoded so the write
+// mode does not apply to it
+inline
+void
+saveImageFile(
+    std::string const & filePath,
+    Rgb const * pixels,
+    long const w,
+    long const h,
+    ImageWriteMode const mode = ImageWriteMode::Buffered)
+{
+    auto const ext = imageExtension(filePath);
+
+    if (ext == ".qoi") {
+        saveQoiFile(filePath, pixels, w, h);
+    } else if (ext == ".ppm") {
+        savePnmFile(filePath, pixels, static_cast<int>(w), static_cast<int>(h), 255, "P6", mode);
+    } else {
+        saveTargaFile(filePath, pixels, w, h, mode);
+    }
+}
+
+} // namespace CxxRay
+
+#endif
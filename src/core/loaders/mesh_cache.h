@@ -0,0 +1,712 @@
+#ifndef CXXRAY_MESH_CACHE_H
+#define CXXRAY_MESH_CACHE_H
+
+#include "loaders/wavefront_obj.h"
+#include "loaders/image_file.h"
+
+#include "world/mesh.h"
+#include "world/mesh_view.h"
+#include "utils/mapped_file.h"
+#include "utils/hash.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+
+namespace CxxRay {
+
+// binary mesh cache file
+//
+// - a fixed header with the format version, the build's
+//   number layout and a hash of every source file
+// - sections for vertexes, normals, uvs, face indexes,
+//   face material numbers, the material table, a string
+//   table, the list of source files and the mesh parts,
+//   each starting on a 64 byte boundary so they can be
+//   used in place
+//
+// numbers are stored in the machine's own layout, a file
+// written by a different build is simply rebuilt
+namespace meshCache {
+
+    constexpr char kMagic[8] = {'C', 'X', 'R', 'M', 'E', 'S', 'H', '\0'};
+    constexpr uint32_t kVersion = 2;
+    constexpr uint32_t kByteOrder = 0x01020304;
+    constexpr uint64_t kAlign = 64;
+
+    static_assert(sizeof(Vec3) == 3 * sizeof(Real), "Vec3 must be packed");
+    static_assert(sizeof(MeshFaceIndex) == 9 * sizeof(long long), "MeshFaceIndex must be packed");
+    static_assert(std::is_trivially_copyable_v<MeshFaceIndex>, "MeshFaceIndex must be trivially copyable");
+
+    struct Section
+    {
+        uint64_t offset = 0;
+        uint64_t count = 0;
+    };
+
+    struct Header
+    {
+        char magic[8] = {};
+        uint32_t version = 0;
+        uint32_t byteOrder = 0;
+        uint32_t realSize = 0;
+        uint32_t indexSize = 0;
+        uint64_t sourceHash = 0;
+
+        Section verts = {};
+        Section norms = {};
+        Section uvs = {};
+        Section faces = {};
+        Section faceMtls = {};
+        Section mtls = {};
+        Section strings = {};
+        Section deps = {};
+        Section parts = {};
+    };
+
+    // a string in the string table
+    struct StringRef
+    {
+        uint64_t offset = 0;
+        uint64_t len = 0;
+    };
+
+    struct MtlRecord
+    {
+        Real ambient[3] = {};
+        Real diffuse[3] = {};
+        Real specular[3] = {};
+        Real specExp = 0.0;
+        StringRef name = {};
+        StringRef texName = {};
+    };
+
+    struct PartRecord
+    {
+        uint64_t firstFace = 0;
+        uint64_t faceCount = 0;
+        Real lo[3] = {};
+        Real hi[3] = {};
+        Real center[3] = {};
+        Real radius = -1.0;
+        StringRef name = {};
+    };
+
+    inline
+    uint64_t
+    alignUp(
+        uint64_t const n)
+    {
+        return (n + kAlign - 1) / kAlign * kAlign;
+    }
+
+    inline
+    StringRef
+    addString(
+        std::string & table,
+        std::string const & s)
+    {
+        StringRef ref{table.size(), s.size()};
+
+        table += s;
+
+        return ref;
+    }
+
+    inline
+    std::string
+    getString(
+        char const * table,
+        uint64_t const tableLen,
+        StringRef const & ref)
+    {
+        if (ref.offset > tableLen || ref.len > tableLen - ref.offset) {
+            return "";
+        }
+
+        return std::string{table + ref.offset, static_cast<size_t>(ref.len)};
+    }
+
+    // true when count elements of elemSize fit
+    // in the file at an aligned offset
+    inline
+    bool
+    sectionFits(
+        Section const & s,
+        size_t const elemSize,
+        size_t const fileSize)
+    {
+        if (s.offset % kAlign != 0 || s.offset > fileSize) {
+            return false;
+        }
+
+        return s.count <= (fileSize - s.offset) / elemSize;
+    }
+
+    // true when every corner refers to an existing vertex
+    // and to an existing uv and normal or none (0), so
+    // drawing can index the arrays directly
+    inline
+    bool
+    faceIndexesFit(
+        MeshFaceIndex const * faces,
+        size_t const faceCount,
+        size_t const verts,
+        size_t const uvs,
+        size_t const norms)
+    {
+        auto const fits = [](long long const id, long long const lo, size_t const count) {
+            return id >= lo && static_cast<unsigned long long>(id) <= count;
+        };
+
+        for (size_t i = 0; i < faceCount; i++)
+        {
+            for (auto const & I : faces[i])
+            {
+                if (!fits(I.id, 1, verts) || !fits(I.uvId, 0, uvs) || !fits(I.normId, 0, norms)) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+} // namespace meshCache
+
+// lay a mesh out in the cache format, faces refer to
+// entries of the material table by index
+inline
+MeshVector<char>
+buildMeshCache(
+    Mesh const & mesh,
+    std::vector<std::string> const & deps,
+    uint64_t const sourceHash)
+{
+    using namespace meshCache;
+
+    using std::string;
+    using std::vector;
+
+    // the faces' material table as it is, then every named
+    // material sorted by name so materials no face uses are
+    // kept too, toMesh takes the last entry of a name so
+    // these win over a face material redefined later on
+    vector<MeshMtl> table = mesh.mtlTable;
+    vector<string> names = mesh.mtlNames;
+
+    names.resize(table.size());
+
+    vector<string> defined;
+
+    for (auto const & [ name, mtl ] : mesh.mtls) {
+        defined.push_back(name);
+    }
+
+    std::sort(defined.begin(), defined.end());
+
+    for (auto const & name : defined)
+    {
+        table.push_back(mesh.mtls.at(name));
+        names.push_back(name);
+    }
+
+    vector<uint32_t> faceMtls;
+    faceMtls.reserve(mesh.faces.size());
+
+    for (auto const & face : mesh.faces) {
+        faceMtls.push_back(face.mtlId);
+    }
+
+    string strings = "";
+
+    vector<MtlRecord> mtlRecords;
+
+    for (size_t i = 0; i < table.size(); i++)
+    {
+        auto const & mtl = table[i];
+
+        MtlRecord rec{};
+
+        rec.ambient[0] = mtl.ambient.r; rec.ambient[1] = mtl.ambient.g; rec.ambient[2] = mtl.ambient.b;
+        rec.diffuse[0] = mtl.diffuse.r; rec.diffuse[1] = mtl.diffuse.g; rec.diffuse[2] = mtl.diffuse.b;
+        rec.specular[0] = mtl.specular.r; rec.specular[1] = mtl.specular.g; rec.specular[2] = mtl.specular.b;
+        rec.specExp = mtl.specExp;
+        rec.name = addString(strings, names[i]);
+        rec.texName = addString(strings, mtl.texName);
+
+        mtlRecords.push_back(rec);
+    }
+
+    vector<StringRef> depRecords;
+
+    for (auto const & dep : deps) {
+        depRecords.push_back(addString(strings, dep));
+    }
+
+    vector<PartRecord> partRecords;
+
+    for (auto const & part : mesh.parts)
+    {
+        auto const & b = part.bounds;
+
+        PartRecord rec{};
+
+        rec.firstFace = part.firstFace;
+        rec.faceCount = part.faceCount;
+        rec.lo[0] = b.lo.x; rec.lo[1] = b.lo.y; rec.lo[2] = b.lo.z;
+        rec.hi[0] = b.hi.x; rec.hi[1] = b.hi.y; rec.hi[2] = b.hi.z;
+        rec.center[0] = b.center.x; rec.center[1] = b.center.y; rec.center[2] = b.center.z;
+        rec.radius = b.radius;
+        rec.name = addString(strings, part.name);
+
+        partRecords.push_back(rec);
+    }
+
+    Header header{};
+
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byteOrder = kByteOrder;
+    header.realSize = sizeof(Real);
+    header.indexSize = sizeof(long long);
+    header.sourceHash = sourceHash;
+
+    uint64_t at = alignUp(sizeof(Header));
+
+    auto const place = [&at](Section & s, uint64_t const count, size_t const elemSize) {
+        s.offset = at;
+        s.count = count;
+        at = alignUp(at + count * elemSize);
+    };
+
+    place(header.verts, mesh.verts.size(), sizeof(Vec3));
+    place(header.norms, mesh.norms.size(), sizeof(Vec3));
+    place(header.uvs, mesh.uvs.size(), 2 * sizeof(Real));
+    place(header.faces, mesh.faces.size(), sizeof(MeshFaceIndex));
+    place(header.faceMtls, faceMtls.size(), sizeof(uint32_t));
+    place(header.mtls, mtlRecords.size(), sizeof(MtlRecord));
+    place(header.strings, strings.size(), 1);
+    place(header.deps, depRecords.size(), sizeof(StringRef));
+    place(header.parts, partRecords.size(), sizeof(PartRecord));
+
+    MeshVector<char> out(at, '\0');
+
+    std::memcpy(out.data(), &header, sizeof(Header));
+
+    auto * const verts = reinterpret_cast<Vec3 *>(out.data() + header.verts.offset);
+    auto * const norms = reinterpret_cast<Vec3 *>(out.data() + header.norms.offset);
+    auto * const uvs = reinterpret_cast<Real *>(out.data() + header.uvs.offset);
+    auto * const faces = reinterpret_cast<MeshFaceIndex *>(out.data() + header.faces.offset);
+
+    std::copy(mesh.verts.begin(), mesh.verts.end(), verts);
+    std::copy(mesh.norms.begin(), mesh.norms.end(), norms);
+
+    for (size_t i = 0; i < mesh.uvs.size(); i++)
+    {
+        auto const [ u, v ] = mesh.uvs[i];
+
+        uvs[2 * i] = u;
+        uvs[2 * i + 1] = v;
+    }
+
+    for (size_t i = 0; i < mesh.faces.size(); i++) {
+        faces[i] = mesh.faces[i].vertexIndexes;
+    }
+
+    auto const copyBytes = [&out](Section const & s, void const * src, size_t const bytes) {
+        if (bytes > 0) {
+            std::memcpy(out.data() + s.offset, src, bytes);
+        }
+    };
+
+    copyBytes(header.faceMtls, faceMtls.data(), faceMtls.size() * sizeof(uint32_t));
+    copyBytes(header.mtls, mtlRecords.data(), mtlRecords.size() * sizeof(MtlRecord));
+    copyBytes(header.strings, strings.data(), strings.size());
+    copyBytes(header.deps, depRecords.data(), depRecords.size() * sizeof(StringRef));
+    copyBytes(header.parts, partRecords.data(), partRecords.size() * sizeof(PartRecord));
+
+    return out;
+}
+
+// point a view at cache bytes already in memory, the
+// view is left invalid if the bytes are not a cache
+// this build can read
+inline
+void
+bindMeshView(
+    MeshView & view,
+    char const * data,
+    size_t const len)
+{
+    using namespace meshCache;
+
+    view.ok = false;
+
+    if (data == nullptr || len < sizeof(Header)) {
+        return;
+    }
+
+    Header header{};
+    std::memcpy(&header, data, sizeof(Header));
+
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion ||
+        header.byteOrder != kByteOrder ||
+        header.realSize != sizeof(Real) ||
+        header.indexSize != sizeof(long long)) {
+        return;
+    }
+
+    if (!sectionFits(header.verts, sizeof(Vec3), len) ||
+        !sectionFits(header.norms, sizeof(Vec3), len) ||
+        !sectionFits(header.uvs, 2 * sizeof(Real), len) ||
+        !sectionFits(header.faces, sizeof(MeshFaceIndex), len) ||
+        !sectionFits(header.faceMtls, sizeof(uint32_t), len) ||
+        !sectionFits(header.mtls, sizeof(MtlRecord), len) ||
+        !sectionFits(header.strings, 1, len) ||
+        !sectionFits(header.deps, sizeof(StringRef), len) ||
+        !sectionFits(header.parts, sizeof(PartRecord), len) ||
+        header.faceMtls.count != header.faces.count) {
+        return;
+    }
+
+    auto const * const strings = data + header.strings.offset;
+    auto const stringsLen = header.strings.count;
+
+    view.mtls.clear();
+    view.mtlNames.clear();
+
+    for (uint64_t i = 0; i < header.mtls.count; i++)
+    {
+        MtlRecord rec{};
+        std::memcpy(&rec, data + header.mtls.offset + i * sizeof(MtlRecord), sizeof(MtlRecord));
+
+        MeshMtl mtl{};
+
+        mtl.ambient = RgbReal{rec.ambient[0], rec.ambient[1], rec.ambient[2]};
+        mtl.diffuse = RgbReal{rec.diffuse[0], rec.diffuse[1], rec.diffuse[2]};
+        mtl.specular = RgbReal{rec.specular[0], rec.specular[1], rec.specular[2]};
+        mtl.specExp = rec.specExp;
+        mtl.texName = getString(strings, stringsLen, rec.texName);
+
+        view.mtls.push_back(mtl);
+        view.mtlNames.push_back(getString(strings, stringsLen, rec.name));
+    }
+
+    view.deps.clear();
+
+    for (uint64_t i = 0; i < header.deps.count; i++)
+    {
+        StringRef ref{};
+        std::memcpy(&ref, data + header.deps.offset + i * sizeof(StringRef), sizeof(StringRef));
+
+        view.deps.push_back(getString(strings, stringsLen, ref));
+    }
+
+    view.parts.clear();
+
+    for (uint64_t i = 0; i < header.parts.count; i++)
+    {
+        PartRecord rec{};
+        std::memcpy(&rec, data + header.parts.offset + i * sizeof(PartRecord), sizeof(PartRecord));
+
+        if (rec.firstFace > header.faces.count || rec.faceCount > header.faces.count - rec.firstFace) {
+            return;
+        }
+
+        MeshPart part{};
+
+        part.name = getString(strings, stringsLen, rec.name);
+        part.firstFace = static_cast<size_t>(rec.firstFace);
+        part.faceCount = static_cast<size_t>(rec.faceCount);
+        part.bounds.lo = Vec3{rec.lo[0], rec.lo[1], rec.lo[2]};
+        part.bounds.hi = Vec3{rec.hi[0], rec.hi[1], rec.hi[2]};
+        part.bounds.center = Vec3{rec.center[0], rec.center[1], rec.center[2]};
+        part.bounds.radius = rec.radius;
+
+        view.parts.push_back(std::move(part));
+    }
+
+    view.verts = reinterpret_cast<Vec3 const *>(data + header.verts.offset);
+    view.norms = reinterpret_cast<Vec3 const *>(data + header.norms.offset);
+    view.uvs = reinterpret_cast<Real const *>(data + header.uvs.offset);
+    view.faces = reinterpret_cast<MeshFaceIndex const *>(data + header.faces.offset);
+    view.faceMtls = reinterpret_cast<uint32_t const *>(data + header.faceMtls.offset);
+
+    view.vertCount = static_cast<size_t>(header.verts.count);
+    view.normCount = static_cast<size_t>(header.norms.count);
+    view.uvCount = static_cast<size_t>(header.uvs.count);
+    view.faceCount = static_cast<size_t>(header.faces.count);
+
+    view.sourceHash = header.sourceHash;
+
+    // material numbers and face indexes index the arrays
+    // directly when drawing
+    for (size_t i = 0; i < view.faceCount; i++)
+    {
+        if (view.faceMtls[i] >= view.mtls.size()) {
+            return;
+        }
+    }
+
+    if (!faceIndexesFit(view.faces, view.faceCount, view.vertCount, view.uvCount, view.normCount)) {
+        return;
+    }
+
+    view.ok = true;
+}
+
+// view of a mesh held in memory in the cache layout
+inline
+MeshView
+makeMeshView(
+    Mesh const & mesh,
+    std::vector<std::string> const & deps = {},
+    uint64_t const sourceHash = 0)
+{
+    MeshView view;
+
+    view.bytes = buildMeshCache(mesh, deps, sourceHash);
+
+    bindMeshView(view, view.bytes.data(), view.bytes.size());
+
+    return view;
+}
+
+// map a cache file, invalid when missing or unreadable
+inline
+MeshView
+openMeshCache(
+    std::string const & filePath)
+{
+    MeshView view;
+
+    view.file = MappedFile{filePath};
+
+    if (view.file.isOpen()) {
+        bindMeshView(view, view.file.data(), view.file.size());
+    }
+
+    return view;
+}
+
+inline
+bool
+saveMeshCache(
+    std::string const & filePath,
+    MeshVector<char> const & bytes)
+{
+    namespace fs = std::filesystem;
+
+    // write next to the target and rename so a reader
+    // never maps a half written file
+    auto const tmpPath = filePath + ".tmp";
+
+    {
+        std::ofstream fh{tmpPath, std::ios::binary};
+
+        if (!fh.is_open()) {
+            return false;
+        }
+
+        fh.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+
+        if (!fh) {
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmpPath, filePath, ec);
+
+    return !ec;
+}
+
+// hash the OBJ and every file it pulled in, a missing
+// file still changes the hash through its name
+inline
+uint64_t
+hashMeshSources(
+    std::string const & objPath,
+    std::vector<std::string> const & deps)
+{
+    auto h = kHashSeed;
+
+    auto const hashFile = [&h](std::string const & path) {
+        h = hashString(path, h);
+
+        MappedFile file{path};
+
+        if (file.isOpen()) {
+            file.adviseSequential();
+            h = hashBytes(file.data(), file.size(), h);
+        }
+    };
+
+    hashFile(objPath);
+
+    for (auto const & dep : deps) {
+        hashFile(dep);
+    }
+
+    return h;
+}
+
+// the MTL files named by an OBJ and the textures
+// named by its materials, as paths the loaders use
+inline
+std::vector<std::string>
+meshSourceDeps(
+    std::string const & objPath,
+    Mesh const & mesh)
+{
+    using namespace objParse;
+
+    namespace fs = std::filesystem;
+
+    std::vector<std::string> deps;
+
+    MappedFile file{objPath};
+
+    char const * p = file.data();
+    char const * const end = p + file.size();
+
+    auto const fileDir = fs::path{objPath}.parent_path();
+
+    while (p < end)
+    {
+        char const * next = end;
+        char const * const eol = lineEnd(p, end, &next);
+
+        p = skipSpace(p, eol);
+
+        if (p < eol && *p == 'm' && readRecord(p, eol) == Record::MtlLib)
+        {
+            auto const name = restOfLine(p, eol);
+
+            if (name.size() > 0) {
+                deps.push_back((fs::path{fileDir} /= name).string());
+            }
+        }
+
+        p = next;
+    }
+
+    std::vector<std::string> texNames;
+
+    for (auto const & [ name, mtl ] : mesh.mtls)
+    {
+        if (mtl.texName != "") {
+            texNames.push_back(mtl.texName);
+        }
+    }
+
+    std::sort(texNames.begin(), texNames.end());
+
+    deps.insert(deps.end(), texNames.begin(), texNames.end());
+
+    return deps;
+}
+
+// cache file for an OBJ, named after the file and a
+// hash of its full path so equally named models in
+// different folders do not collide
+inline
+std::string
+meshCachePath(
+    std::string const & cacheDir,
+    std::string const & objPath)
+{
+    namespace fs = std::filesystem;
+
+    auto const fullPath = fs::absolute(fs::path{objPath}).lexically_normal().string();
+
+    auto const name = fs::path{objPath}.stem().string() + "-" + hashHex(hashString(fullPath)) + ".cxmesh";
+
+    return (fs::path{cacheDir} /= name).string();
+}
+
+inline
+void
+loadMeshTextures(
+    MeshView const & view,
+    TextureMap & textures,
+    TextureLoadOptions const & textureOpts = {})
+{
+    TextureLoads loads;
+
+    for (auto const & mtl : view.mtls)
+    {
+        if (mtl.texName != "") {
+            requestTexture(mtl.texName, textures, loads, textureOpts);
+        }
+    }
+
+    resolveTextures(textures, loads);
+}
+
+// load an OBJ through the cache directory
+//
+// when the cache file exists and the hash of the OBJ, its
+// MTL files and textures still matches it is mapped and
+// used as is, otherwise the OBJ is parsed and the cache
+// written for next time
+inline
+MeshView
+loadCachedWavefrontObj(
+    std::string const & objPath,
+    TextureMap & textures,
+    std::string const & cacheDir,
+    ObjLoadOptions const & opts = {})
+{
+    using std::cout;
+    using std::endl;
+
+    namespace fs = std::filesystem;
+
+    auto const cachePath = meshCachePath(cacheDir, objPath);
+
+    {
+        auto view = openMeshCache(cachePath);
+
+        if (view.valid() && view.sourceHash == hashMeshSources(objPath, view.deps))
+        {
+            cout << "Mesh cache hit: " << cachePath << endl;
+
+            loadMeshTextures(view, textures, opts.textures);
+
+            view.cached = true;
+
+            return view;
+        }
+    }
+
+    cout << "Mesh cache miss: " << cachePath << endl;
+
+    auto const mesh = loadWavefrontObjFile(objPath, textures, opts);
+
+    auto const deps = meshSourceDeps(objPath, mesh);
+
+    auto view = makeMeshView(mesh, deps, hashMeshSources(objPath, deps));
+
+    std::error_code ec;
+    fs::create_directories(cacheDir, ec);
+
+    if (!saveMeshCache(cachePath, view.bytes)) {
+        cout << "Could not write mesh cache: " << cachePath << endl;
+    }
+
+    return view;
+}
+
+} // namespace CxxRay
+
+#endif
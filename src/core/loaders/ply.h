@@ -0,0 +1,757 @@
+#ifndef CXXRAY_PLY_H
+#define CXXRAY_PLY_H
+
+#include "world/mesh.h"
+#include "world/indexed_mesh.h"
+#include "linalg/linalg.h"
+#include "utils/mapped_file.h"
+#include "utils/mem_stats.h"
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+
+namespace CxxRay {
+
+namespace plyParse
+{
+    enum class PlyType
+    {
+        None,
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Float32,
+        Float64
+    };
+
+    inline
+    PlyType
+    typeFromName(
+        std::string const & name)
+    {
+        if (name == "char" || name == "int8") { return PlyType::Int8; }
+        if (name == "uchar" || name == "uint8") { return PlyType::UInt8; }
+        if (name == "short" || name == "int16") { return PlyType::Int16; }
+        if (name == "ushort" || name == "uint16") { return PlyType::UInt16; }
+        if (name == "int" || name == "int32") { return PlyType::Int32; }
+        if (name == "uint" || name == "uint32") { return PlyType::UInt32; }
+        if (name == "float" || name == "float32") { return PlyType::Float32; }
+        if (name == "double" || name == "float64") { return PlyType::Float64; }
+
+        return PlyType::None;
+    }
+
+    inline
+    size_t
+    typeSize(
+        PlyType const type)
+    {
+        switch (type)
+        {
+            case PlyType::Int8:
+            case PlyType::UInt8: return 1;
+            case PlyType::Int16:
+            case PlyType::UInt16: return 2;
+            case PlyType::Int32:
+            case PlyType::UInt32:
+            case PlyType::Float32: return 4;
+            case PlyType::Float64: return 8;
+            default: return 0;
+        }
+    }
+
+    template<typename T>
+    T
+    readRaw(
+        char const * p)
+    {
+        T val;
+        std::memcpy(&val, p, sizeof(T));
+
+        return val;
+    }
+
+    // values are little endian in the file, as they are on
+    // every platform this is built for
+    inline
+    Real
+    readReal(
+        char const * p,
+        PlyType const type)
+    {
+        switch (type)
+        {
+            case PlyType::Int8: return readRaw<int8_t>(p);
+            case PlyType::UInt8: return readRaw<uint8_t>(p);
+            case PlyType::Int16: return readRaw<int16_t>(p);
+            case PlyType::UInt16: return readRaw<uint16_t>(p);
+            case PlyType::Int32: return readRaw<int32_t>(p);
+            case PlyType::UInt32: return readRaw<uint32_t>(p);
+            case PlyType::Float32: return static_cast<Real>(readRaw<float>(p));
+            case PlyType::Float64: return readRaw<double>(p);
+            default: return 0.0;
+        }
+    }
+
+    inline
+    long long
+    readInt(
+        char const * p,
+        PlyType const type)
+    {
+        switch (type)
+        {
+            case PlyType::Int8: return readRaw<int8_t>(p);
+            case PlyType::UInt8: return readRaw<uint8_t>(p);
+            case PlyType::Int16: return readRaw<int16_t>(p);
+            case PlyType::UInt16: return readRaw<uint16_t>(p);
+            case PlyType::Int32: return readRaw<int32_t>(p);
+            case PlyType::UInt32: return readRaw<uint32_t>(p);
+            case PlyType::Float32: return static_cast<long long>(readRaw<float>(p));
+            case PlyType::Float64: return static_cast<long long>(readRaw<double>(p));
+            default: return 0;
+        }
+    }
+
+    struct PlyProperty
+    {
+        std::string name = "";
+        PlyType type = PlyType::None;
+
+        // lists are a count of countType then that many type
+        bool list = false;
+        PlyType countType = PlyType::None;
+    };
+
+    struct PlyElement
+    {
+        std::string name = "";
+        size_t count = 0;
+        std::vector<PlyProperty> props = {};
+
+        // bytes per item, 0 when the item holds a list
+        size_t stride = 0;
+
+        // offset of a fixed size property, npos when absent
+        size_t offset(
+            std::string const & propName) const
+        {
+            size_t at = 0;
+
+            for (auto const & prop : props)
+            {
+                if (prop.list) {
+                    return std::string::npos;
+                }
+
+                if (prop.name == propName) {
+                    return at;
+                }
+
+                at += typeSize(prop.type);
+            }
+
+            return std::string::npos;
+        }
+
+        PlyProperty const * find(
+            std::string const & propName) const
+        {
+            for (auto const & prop : props)
+            {
+                if (prop.name == propName) {
+                    return &prop;
+                }
+            }
+
+            return nullptr;
+        }
+    };
+
+    struct PlyHeader
+    {
+        std::string format = "";
+        std::vector<PlyElement> elements = {};
+
+        // bytes before the first element
+        size_t size = 0;
+    };
+
+    // parse the text header up to and including end_header,
+    // leaves size 0 when the header is not complete
+    inline
+    void
+    readHeader(
+        char const * data,
+        size_t const len,
+        PlyHeader & header)
+    {
+        using std::string;
+        using std::runtime_error;
+
+        if (len < 4 || std::memcmp(data, "ply", 3) != 0) {
+            throw runtime_error{"Not a PLY file"};
+        }
+
+        size_t at = 0;
+
+        while (at < len)
+        {
+            auto const * const eol = static_cast<char const *>(std::memchr(data + at, '\n', len - at));
+
+            if (eol == nullptr) {
+                return;
+            }
+
+            std::istringstream line{string{data + at, eol}};
+            at = static_cast<size_t>(eol - data) + 1;
+
+            string tok;
+            line >> tok;
+
+            if (tok == "format")
+            {
+                line >> header.format;
+            }
+            else if (tok == "element")
+            {
+                PlyElement elem;
+                line >> elem.name >> elem.count;
+
+                header.elements.push_back(elem);
+            }
+            else if (tok == "property")
+            {
+                if (header.elements.empty()) {
+                    throw runtime_error{"PLY property before any element"};
+                }
+
+                PlyProperty prop;
+
+                string typeName;
+                line >> typeName;
+
+                if (typeName == "list")
+                {
+                    string countName;
+                    line >> countName >> typeName;
+
+                    prop.list = true;
+                    prop.countType = typeFromName(countName);
+                }
+
+                prop.type = typeFromName(typeName);
+                line >> prop.name;
+
+                if (prop.type == PlyType::None || (prop.list && prop.countType == PlyType::None)) {
+                    throw runtime_error{"Unknown PLY property type: " + typeName};
+                }
+
+                header.elements.back().props.push_back(prop);
+            }
+            else if (tok == "end_header")
+            {
+                header.size = at;
+                break;
+            }
+        }
+
+        for (auto & elem : header.elements)
+        {
+            elem.stride = 0;
+
+            for (auto const & prop : elem.props)
+            {
+                if (prop.list) {
+                    elem.stride = 0;
+                    break;
+                }
+
+                elem.stride += typeSize(prop.type);
+            }
+        }
+    }
+
+    // walk one item of an element holding lists, calling
+    // onList(prop, count, first) for every list, returns the
+    // byte after the item or nullptr past the end
+    template<typename OnList>
+    char const *
+    walkItem(
+        PlyElement const & elem,
+        char const * p,
+        char const * const end,
+        OnList const & onList)
+    {
+        for (auto const & prop : elem.props)
+        {
+            if (!prop.list)
+            {
+                if (static_cast<size_t>(end - p) < typeSize(prop.type)) {
+                    return nullptr;
+                }
+
+                p += typeSize(prop.type);
+                continue;
+            }
+
+            auto const countSize = typeSize(prop.countType);
+
+            if (static_cast<size_t>(end - p) < countSize) {
+                return nullptr;
+            }
+
+            auto const count = readInt(p, prop.countType);
+            p += countSize;
+
+            auto const bytes = static_cast<size_t>(std::max(count, 0ll)) * typeSize(prop.type);
+
+            if (static_cast<size_t>(end - p) < bytes) {
+                return nullptr;
+            }
+
+            onList(prop, count, p);
+            p += bytes;
+        }
+
+        return p;
+    }
+
+    inline
+    bool
+    isIndexList(
+        std::string const & name)
+    {
+        return name == "vertex_indices" || name == "vertex_index";
+    }
+}
+
+// read only view of a binary little endian PLY file
+//
+// the file is mapped and vertexes are read in place from
+// it through strided accessors, nothing is copied until
+// the view is turned into a Mesh or IndexedMesh
+//
+// polygons are split into triangle fans
+struct PlyView
+{
+    MappedFile file = {};
+
+    char const * vertexData = nullptr;
+    size_t vertexCount = 0;
+    size_t vertexStride = 0;
+
+    char const * faceData = nullptr;
+    size_t faceCount = 0;
+
+    plyParse::PlyElement faceElem = {};
+
+    // x y z, nx ny nz and u v property offsets and types
+    size_t posAt[3] = {0, 0, 0};
+    size_t normAt[3] = {0, 0, 0};
+    size_t uvAt[2] = {0, 0};
+
+    plyParse::PlyType posType[3] = {};
+    plyParse::PlyType normType[3] = {};
+    plyParse::PlyType uvType[2] = {};
+
+    bool hasNormals = false;
+    bool hasUvs = false;
+
+    Vec3 position(
+        size_t const i) const
+    {
+        using plyParse::readReal;
+
+        auto const * const p = vertexData + i * vertexStride;
+
+        return {
+            readReal(p + posAt[0], posType[0]),
+            readReal(p + posAt[1], posType[1]),
+            readReal(p + posAt[2], posType[2])
+        };
+    }
+
+    Vec3 normal(
+        size_t const i) const
+    {
+        using plyParse::readReal;
+
+        auto const * const p = vertexData + i * vertexStride;
+
+        return {
+            readReal(p + normAt[0], normType[0]),
+            readReal(p + normAt[1], normType[1]),
+            readReal(p + normAt[2], normType[2])
+        };
+    }
+
+    std::tuple<Real,Real> uv(
+        size_t const i) const
+    {
+        using plyParse::readReal;
+
+        auto const * const p = vertexData + i * vertexStride;
+
+        return {
+            readReal(p + uvAt[0], uvType[0]),
+            readReal(p + uvAt[1], uvType[1])
+        };
+    }
+
+    // calls onTriangle(a, b, c) with zero based vertex
+    // indexes, returns false if the faces run past the end
+    // of the file
+    template<typename OnTriangle>
+    bool forEachTriangle(
+        OnTriangle const & onTriangle) const
+    {
+        using namespace plyParse;
+
+        auto const * p = faceData;
+        auto const * const end = file.data() + file.size();
+
+        for (size_t f = 0; f < faceCount; f++)
+        {
+            p = walkItem(faceElem, p, end, [&onTriangle](PlyProperty const & prop, long long const count, char const * first) {
+                if (!isIndexList(prop.name)) {
+                    return;
+                }
+
+                auto const size = typeSize(prop.type);
+                auto const a = readInt(first, prop.type);
+
+                for (long long k = 2; k < count; k++)
+                {
+                    onTriangle(
+                        a,
+                        readInt(first + static_cast<size_t>(k - 1) * size, prop.type),
+                        readInt(first + static_cast<size_t>(k) * size, prop.type));
+                }
+            });
+
+            if (p == nullptr) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+namespace plyParse
+{
+    inline
+    bool
+    findProps(
+        PlyElement const & elem,
+        std::vector<std::string> const & names,
+        size_t * at,
+        PlyType * type)
+    {
+        for (size_t k = 0; k < names.size(); k++)
+        {
+            at[k] = elem.offset(names[k]);
+
+            if (at[k] == std::string::npos) {
+                return false;
+            }
+
+            type[k] = elem.find(names[k])->type;
+        }
+
+        return true;
+    }
+
+    // area weighted vertex normals, used when the file has none
+    template<typename Positions>
+    MeshVector<Vec3>
+    computeNormals(
+        size_t const count,
+        Positions const & positions,
+        MeshVector<uint32_t> const & indices)
+    {
+        MeshVector<Vec3> norms(count, Vec3{0.0, 0.0, 0.0});
+
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            auto const a = indices[t];
+            auto const b = indices[t + 1];
+            auto const c = indices[t + 2];
+
+            // the unnormalized cross product weighs by area
+            auto const n = cross(positions(b) - positions(a), positions(c) - positions(a));
+
+            norms[a] = norms[a] + n;
+            norms[b] = norms[b] + n;
+            norms[c] = norms[c] + n;
+        }
+
+        for (auto & n : norms)
+        {
+            auto const len = length(n);
+
+            n = len > 0.0 ? n / len : Vec3{0.0, 0.0, 1.0};
+        }
+
+        return norms;
+    }
+
+    // triangle indexes of the view, throws on one outside
+    // the vertexes
+    inline
+    MeshVector<uint32_t>
+    triangleIndices(
+        PlyView const & view)
+    {
+        MeshVector<uint32_t> indices;
+        indices.reserve(view.faceCount * 3);
+
+        auto const check = [&view](long long const i) {
+            if (i < 0 || static_cast<size_t>(i) >= view.vertexCount) {
+                throw std::runtime_error{"PLY face index out of range: " + std::to_string(i)};
+            }
+
+            return static_cast<uint32_t>(i);
+        };
+
+        bool const complete = view.forEachTriangle([&indices, &check](long long const a, long long const b, long long const c) {
+            indices.push_back(check(a));
+            indices.push_back(check(b));
+            indices.push_back(check(c));
+        });
+
+        if (!complete) {
+            throw std::runtime_error{"PLY faces run past the end of the file"};
+        }
+
+        return indices;
+    }
+}
+
+// map a binary little endian PLY and locate its vertex
+// and face elements, other elements are skipped
+inline
+PlyView
+openPlyFile(
+    std::string const & filePath)
+{
+    using namespace plyParse;
+
+    using std::runtime_error;
+
+    PlyView view;
+
+    view.file = MappedFile{filePath};
+
+    if (!view.file.isOpen()) {
+        throw runtime_error{"ERROR OPENING: " + filePath};
+    }
+
+    auto const * const data = view.file.data();
+    auto const * const end = data + view.file.size();
+
+    PlyHeader header;
+    readHeader(data, view.file.size(), header);
+
+    if (header.size == 0) {
+        throw runtime_error{"PLY header not terminated: " + filePath};
+    }
+
+    if (header.format != "binary_little_endian") {
+        throw runtime_error{"PLY Loader only supports binary_little_endian format."};
+    }
+
+    auto const * p = data + header.size;
+
+    for (auto const & elem : header.elements)
+    {
+        if (elem.name == "vertex")
+        {
+            if (elem.stride == 0) {
+                throw runtime_error{"PLY vertexes can not hold lists: " + filePath};
+            }
+
+            if (!findProps(elem, {"x", "y", "z"}, view.posAt, view.posType)) {
+                throw runtime_error{"PLY vertexes have no x y z: " + filePath};
+            }
+
+            view.hasNormals = findProps(elem, {"nx", "ny", "nz"}, view.normAt, view.normType);
+
+            view.hasUvs = findProps(elem, {"u", "v"}, view.uvAt, view.uvType)
+                || findProps(elem, {"s", "t"}, view.uvAt, view.uvType)
+                || findProps(elem, {"texture_u", "texture_v"}, view.uvAt, view.uvType);
+
+            // welded indexes are 32 bit
+            if (elem.count > std::numeric_limits<uint32_t>::max()) {
+                throw runtime_error{"PLY has too many vertexes: " + filePath};
+            }
+
+            view.vertexData = p;
+            view.vertexCount = elem.count;
+            view.vertexStride = elem.stride;
+        }
+        else if (elem.name == "face")
+        {
+            view.faceData = p;
+            view.faceCount = elem.count;
+            view.faceElem = elem;
+        }
+
+        // find where the next element starts
+        if (elem.stride > 0)
+        {
+            if (static_cast<size_t>(end - p) / elem.stride < elem.count) {
+                throw runtime_error{"PLY file too short: " + filePath};
+            }
+
+            p += elem.count * elem.stride;
+        }
+        else
+        {
+            for (size_t i = 0; i < elem.count && p != nullptr; i++) {
+                p = walkItem(elem, p, end, [](PlyProperty const &, long long, char const *) {});
+            }
+
+            if (p == nullptr) {
+                throw runtime_error{"PLY file too short: " + filePath};
+            }
+        }
+    }
+
+    return view;
+}
+
+// weld a PLY view, its vertexes are already shared so
+// they are converted one for one
+inline
+IndexedMesh
+weldMesh(
+    PlyView const & view)
+{
+    using namespace plyParse;
+
+    IndexedMesh out;
+
+    out.mtls.push_back(MeshMtl{});
+
+    out.indices = triangleIndices(view);
+    out.faceMtls.assign(out.indices.size() / 3, 0);
+
+    out.vertices.resize(view.vertexCount);
+
+    for (size_t i = 0; i < view.vertexCount; i++)
+    {
+        auto & vtx = out.vertices[i];
+
+        vtx.pos = view.position(i);
+
+        if (view.hasNormals) {
+            vtx.norm = view.normal(i);
+        }
+
+        if (view.hasUvs) {
+            std::tie(vtx.u, vtx.v) = view.uv(i);
+        }
+    }
+
+    if (!view.hasNormals)
+    {
+        auto const norms = computeNormals(view.vertexCount, [&out](uint32_t const i) { return out.vertices[i].pos; }, out.indices);
+
+        for (size_t i = 0; i < view.vertexCount; i++) {
+            out.vertices[i].norm = norms[i];
+        }
+    }
+
+    return out;
+}
+
+// copy a PLY view into an ordinary mesh, one position,
+// normal and uv per vertex all sharing its number
+inline
+Mesh
+toMesh(
+    PlyView const & view)
+{
+    using namespace plyParse;
+
+    Mesh mesh;
+
+    mesh.mtls["no_mtl"] = MeshMtl{};
+
+    auto const mtlId = addFaceMtl(mesh, MeshMtl{}, "no_mtl");
+
+    auto const indices = triangleIndices(view);
+
+    mesh.verts.resize(view.vertexCount);
+
+    for (size_t i = 0; i < view.vertexCount; i++) {
+        mesh.verts[i] = view.position(i);
+    }
+
+    if (view.hasNormals)
+    {
+        mesh.norms.resize(view.vertexCount);
+
+        for (size_t i = 0; i < view.vertexCount; i++) {
+            mesh.norms[i] = view.normal(i);
+        }
+    }
+    else
+    {
+        mesh.norms = computeNormals(view.vertexCount, [&mesh](uint32_t const i) { return mesh.verts[i]; }, indices);
+    }
+
+    // every corner refers to a uv so code indexing the mesh
+    // directly never meets a missing one, (0, 0) when the
+    // file has none
+    mesh.uvs.assign(view.vertexCount, std::tuple<Real,Real>{0.0, 0.0});
+
+    if (view.hasUvs)
+    {
+        for (size_t i = 0; i < view.vertexCount; i++) {
+            mesh.uvs[i] = view.uv(i);
+        }
+    }
+
+    mesh.faces.reserve(indices.size() / 3);
+
+    for (size_t t = 0; t < indices.size(); t += 3)
+    {
+        MeshFaceIndex face;
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            auto const id = static_cast<long long>(indices[t + k]) + 1;
+
+            face[k] = MeshIndex{id, id, id};
+        }
+
+        mesh.faces.push_back(MeshFace{mtlId, face});
+    }
+
+    return mesh;
+}
+
+inline
+Mesh
+loadPlyFile(
+    std::string const & filePath)
+{
+    return toMesh(openPlyFile(filePath));
+}
+
+} // namespace CxxRay
+
+#endif
@@ -4,12 +4,16 @@
 #include "image/texture_image.h"
 #include "image/pixel.h"
 #include "rgb/rgb.h"
+#include "image/image_write.h"
 #include "utils/data_array.h"
+#include "utils/mapped_file.h"
 
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <stdexcept>
+#include <cstring>
 
 namespace CxxRay {
 
@@ -184,6 +188,8 @@ loadPnmFile(
     return img;
 }
 
+// save as a binary PPM, the top row comes first in the
+// file so rows are copied out from the last one back
 inline
 void
 savePnmFile(
@@ -192,7 +198,8 @@ savePnmFile(
     int const w,
     int const h,
     int const max_val = 255,
-    std::string const format = "P6")
+    std::string const format = "P6",
+    ImageWriteMode const mode = ImageWriteMode::Buffered)
 {
     using std::ofstream;
     using std::ios;
@@ -208,32 +215,76 @@ savePnmFile(
 
     auto const header = ss.str();
 
+    auto const rowBytes = 3 * static_cast<size_t>(w);
+
+    auto const row = [pixels, w](long const j) {
+        return reinterpret_cast<unsigned char const *>(pixels + j * w);
+    };
+
+    if (mode == ImageWriteMode::Mapped)
+    {
+        MappedOutputFile out{pnmPath, header.size() + rowBytes * static_cast<size_t>(h)};
+
+        if (out.isOpen())
+        {
+            std::memcpy(out.data(), header.data(), header.size());
+
+            auto * dst = out.data() + header.size();
+
+            for (long j = h - 1; j >= 0; j--, dst += rowBytes) {
+                std::memcpy(dst, row(j), rowBytes);
+            }
+
+            if (!out.close()) {
+                throw std::runtime_error{"ERROR WRITING: " + pnmPath};
+            }
+
+            return;
+        }
+    }
+
     // Open File
     ofstream fh{pnmPath, ios::binary};
 
     // Write Header
-    fh.write(header.c_str(), header.size());
+    fh.write(header.c_str(), static_cast<std::streamsize>(header.size()));
 
-    // Write Data
+    // Write Data, whole rows gathered into large writes
     //----------------------------------------------------------
+    auto & buf = imageWriteBuffer();
+
+    size_t used = 0;
+
+    auto const flush = [&fh, &buf, &used]() {
+        fh.write(reinterpret_cast<char const *>(buf.data()), static_cast<std::streamsize>(used));
+        used = 0;
+    };
+
     for (long j = h - 1; j >= 0; j--)
     {
-        for (long i = 0; i < w; i++)
-        {
-            auto const p = pixels[j * w + i];
-
-            char const c[3] = {
-                static_cast<char>(p.r),
-                static_cast<char>(p.g),
-                static_cast<char>(p.b)
-            };
+        // rows wider than the buffer go straight out
+        if (rowBytes > buf.size()) {
+            flush();
+            fh.write(reinterpret_cast<char const *>(row(j)), static_cast<std::streamsize>(rowBytes));
+            continue;
+        }
 
-            fh.write(c, 3);
+        if (used + rowBytes > buf.size()) {
+            flush();
         }
+
+        std::memcpy(buf.data() + used, row(j), rowBytes);
+        used += rowBytes;
     }
 
+    flush();
+
     fh.flush();
     fh.close();
+
+    if (!fh) {
+        throw std::runtime_error{"ERROR WRITING: " + pnmPath};
+    }
 }
 
 } // namespace CxxRay
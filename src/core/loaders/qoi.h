@@ -0,0 +1,391 @@
+#ifndef CXXRAY_QOI_H
+#define CXXRAY_QOI_H
+
+#include "image/texture_image.h"
+#include "rgb/rgb.h"
+#include "utils/mapped_file.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+
+namespace CxxRay {
+
+// "Quite OK Image" format, lossless and byte oriented:
+// each pixel is a run of the previous one, a slot in a
+// 64 entry table of recently seen colors, a small delta
+// from the previous pixel or a literal
+//
+// see https://qoiformat.org/qoi-specification.pdf
+namespace qoiParse
+{
+    constexpr size_t kHeaderSize = 14;
+    constexpr size_t kEndSize = 8;
+
+    constexpr unsigned char kEndMarker[kEndSize] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+    constexpr unsigned char kOpIndex = 0x00;
+    constexpr unsigned char kOpDiff = 0x40;
+    constexpr unsigned char kOpLuma = 0x80;
+    constexpr unsigned char kOpRun = 0xc0;
+    constexpr unsigned char kOpRgb = 0xfe;
+    constexpr unsigned char kOpRgba = 0xff;
+    constexpr unsigned char kMask2 = 0xc0;
+
+    constexpr int kMaxRun = 62;
+
+    // the spec's limit, keeps w * h * 4 well inside 32 bits
+    constexpr long long kMaxPixels = 400000000;
+
+    struct QoiPixel
+    {
+        unsigned char r = 0;
+        unsigned char g = 0;
+        unsigned char b = 0;
+        unsigned char a = 0;
+    };
+
+    inline
+    bool
+    operator==(
+        QoiPixel const & x,
+        QoiPixel const & y)
+    {
+        return x.r == y.r && x.g == y.g && x.b == y.b && x.a == y.a;
+    }
+
+    inline
+    size_t
+    hashIndex(
+        QoiPixel const & p)
+    {
+        return (p.r * 3u + p.g * 5u + p.b * 7u + p.a * 11u) % 64u;
+    }
+
+    inline
+    uint32_t
+    readBig32(
+        unsigned char const * p)
+    {
+        return (static_cast<uint32_t>(p[0]) << 24)
+            | (static_cast<uint32_t>(p[1]) << 16)
+            | (static_cast<uint32_t>(p[2]) << 8)
+            | static_cast<uint32_t>(p[3]);
+    }
+
+    inline
+    void
+    writeBig32(
+        unsigned char * p,
+        uint32_t const v)
+    {
+        p[0] = static_cast<unsigned char>(v >> 24);
+        p[1] = static_cast<unsigned char>(v >> 16);
+        p[2] = static_cast<unsigned char>(v >> 8);
+        p[3] = static_cast<unsigned char>(v);
+    }
+
+    // per thread encoder output, kept between calls so
+    // saving every frame does not allocate
+    inline
+    std::vector<unsigned char> &
+    encodeBuffer()
+    {
+        thread_local std::vector<unsigned char> buffer;
+
+        return buffer;
+    }
+
+    // encode as a 3 channel sRGB QOI into out, rows are
+    // stored top first so they are read from the last
+    // one back, returns the encoded size
+    inline
+    size_t
+    encode(
+        Rgb const * pixels,
+        long const w,
+        long const h,
+        std::vector<unsigned char> & out)
+    {
+        auto const count = static_cast<size_t>(w * h);
+
+        // a literal is the largest any pixel gets
+        auto const maxSize = kHeaderSize + 4 * count + kEndSize;
+
+        if (out.size() < maxSize) {
+            out.resize(maxSize);
+        }
+
+        unsigned char * p = out.data();
+
+        std::memcpy(p, "qoif", 4);
+        writeBig32(p + 4, static_cast<uint32_t>(w));
+        writeBig32(p + 8, static_cast<uint32_t>(h));
+        p[12] = 3;
+        p[13] = 0;
+        p += kHeaderSize;
+
+        QoiPixel index[64] = {};
+        QoiPixel prev{0, 0, 0, 255};
+
+        int run = 0;
+
+        for (long j = h - 1; j >= 0; j--)
+        {
+            Rgb const * row = pixels + j * w;
+
+            for (long i = 0; i < w; i++)
+            {
+                QoiPixel const px{row[i].r, row[i].g, row[i].b, 255};
+
+                if (px == prev)
+                {
+                    if (++run == kMaxRun) {
+                        *p++ = static_cast<unsigned char>(kOpRun | (run - 1));
+                        run = 0;
+                    }
+
+                    continue;
+                }
+
+                if (run > 0) {
+                    *p++ = static_cast<unsigned char>(kOpRun | (run - 1));
+                    run = 0;
+                }
+
+                auto const slot = hashIndex(px);
+
+                if (index[slot] == px)
+                {
+                    *p++ = static_cast<unsigned char>(kOpIndex | slot);
+                }
+                else
+                {
+                    index[slot] = px;
+
+                    // wrapping byte differences
+                    auto const dr = static_cast<signed char>(px.r - prev.r);
+                    auto const dg = static_cast<signed char>(px.g - prev.g);
+                    auto const db = static_cast<signed char>(px.b - prev.b);
+
+                    auto const drg = dr - dg;
+                    auto const dbg = db - dg;
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    {
+                        *p++ = static_cast<unsigned char>(kOpDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    }
+                    else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7)
+                    {
+                        *p++ = static_cast<unsigned char>(kOpLuma | (dg + 32));
+                        *p++ = static_cast<unsigned char>((drg + 8) << 4 | (dbg + 8));
+                    }
+                    else
+                    {
+                        *p++ = kOpRgb;
+                        *p++ = px.r;
+                        *p++ = px.g;
+                        *p++ = px.b;
+                    }
+                }
+
+                prev = px;
+            }
+        }
+
+        if (run > 0) {
+            *p++ = static_cast<unsigned char>(kOpRun | (run - 1));
+        }
+
+        std::memcpy(p, kEndMarker, kEndSize);
+        p += kEndSize;
+
+        return static_cast<size_t>(p - out.data());
+    }
+
+    // decode the chunks after the header into pixels,
+    // flipping to bottom row first, returns the number
+    // of pixels decoded before the data ran out
+    inline
+    size_t
+    decode(
+        unsigned char const * p,
+        unsigned char const * const end,
+        Rgb * pixels,
+        long const w,
+        long const h)
+    {
+        QoiPixel index[64] = {};
+        QoiPixel px{0, 0, 0, 255};
+
+        int run = 0;
+
+        for (long j = h - 1; j >= 0; j--)
+        {
+            Rgb * row = pixels + j * w;
+
+            for (long i = 0; i < w; i++)
+            {
+                if (run > 0)
+                {
+                    run--;
+                }
+                else
+                {
+                    if (p >= end) {
+                        return static_cast<size_t>((h - 1 - j) * w + i);
+                    }
+
+                    auto const op = *p++;
+
+                    if (op == kOpRgb || op == kOpRgba)
+                    {
+                        auto const n = op == kOpRgb ? 3 : 4;
+
+                        if (end - p < n) {
+                            return static_cast<size_t>((h - 1 - j) * w + i);
+                        }
+
+                        px.r = p[0];
+                        px.g = p[1];
+                        px.b = p[2];
+
+                        if (n == 4) {
+                            px.a = p[3];
+                        }
+
+                        p += n;
+                    }
+                    else if ((op & kMask2) == kOpIndex)
+                    {
+                        px = index[op];
+                    }
+                    else if ((op & kMask2) == kOpDiff)
+                    {
+                        px.r = static_cast<unsigned char>(px.r + ((op >> 4) & 0x03) - 2);
+                        px.g = static_cast<unsigned char>(px.g + ((op >> 2) & 0x03) - 2);
+                        px.b = static_cast<unsigned char>(px.b + (op & 0x03) - 2);
+                    }
+                    else if ((op & kMask2) == kOpLuma)
+                    {
+                        if (p >= end) {
+                            return static_cast<size_t>((h - 1 - j) * w + i);
+                        }
+
+                        auto const b2 = *p++;
+                        auto const dg = (op & 0x3f) - 32;
+
+                        px.r = static_cast<unsigned char>(px.r + dg - 8 + ((b2 >> 4) & 0x0f));
+                        px.g = static_cast<unsigned char>(px.g + dg);
+                        px.b = static_cast<unsigned char>(px.b + dg - 8 + (b2 & 0x0f));
+                    }
+                    else
+                    {
+                        // this pixel plus run more
+                        run = op & 0x3f;
+                    }
+
+                    index[hashIndex(px)] = px;
+                }
+
+                row[i] = Rgb{px.r, px.g, px.b};
+            }
+        }
+
+        return static_cast<size_t>(w * h);
+    }
+}
+
+// load a 3 or 4 channel QOI, alpha is dropped
+inline
+TextureImage
+loadQoiFile(
+    std::string const & filePath)
+{
+    using namespace qoiParse;
+
+    using std::runtime_error;
+
+    MappedFile file{filePath};
+
+    if (!file.isOpen()) {
+        throw runtime_error{"ERROR OPENING: " + filePath};
+    }
+
+    auto const * const data = reinterpret_cast<unsigned char const *>(file.data());
+
+    if (file.size() < kHeaderSize || std::memcmp(data, "qoif", 4) != 0) {
+        throw runtime_error{"Not a QOI file: " + filePath};
+    }
+
+    long const w = readBig32(data + 4);
+    long const h = readBig32(data + 8);
+
+    auto const channels = data[12];
+
+    if (channels != 3 && channels != 4) {
+        throw runtime_error{"QOI Loader only supports 3 or 4 channels."};
+    }
+
+    if (static_cast<long long>(w) * h > kMaxPixels) {
+        throw runtime_error{"QOI image too large: " + filePath};
+    }
+
+    TextureImage img{w, h};
+
+    // the end marker is left out of the chunk data
+    auto const * const end = data + std::max(file.size() - kEndSize, kHeaderSize);
+
+    auto const done = decode(data + kHeaderSize, end, img.pixels, w, h);
+
+    // a truncated file leaves the rest black, rows are
+    // decoded from the top so the missing ones are below
+    auto const missing = static_cast<size_t>(w * h) - done;
+
+    if (missing > 0)
+    {
+        auto const rows = static_cast<long>(done) / w;
+        auto const cols = static_cast<long>(done) % w;
+
+        std::fill(img.pixels, img.pixels + (h - 1 - rows) * w, Rgb{0});
+        std::fill(img.pixels + (h - 1 - rows) * w + cols, img.pixels + (h - rows) * w, Rgb{0});
+    }
+
+    return img;
+}
+
+// save as a 3 channel QOI, encoded into a reused buffer
+// and written in one piece since the size is only known
+// once encoded
+inline
+void
+saveQoiFile(
+    std::string const & filePath,
+    Rgb const * pixels,
+    long const w,
+    long const h)
+{
+    using namespace qoiParse;
+
+    auto & buf = encodeBuffer();
+
+    auto const size = encode(pixels, w, h, buf);
+
+    std::ofstream fh{filePath, std::ios::binary};
+
+    fh.write(reinterpret_cast<char const *>(buf.data()), static_cast<std::streamsize>(size));
+
+    fh.close();
+
+    if (!fh) {
+        throw std::runtime_error{"ERROR WRITING: " + filePath};
+    }
+}
+
+} // namespace CxxRay
+
+#endif
@@ -0,0 +1,569 @@
+#ifndef CXXRAY_TEXTURE_CACHE_H
+#define CXXRAY_TEXTURE_CACHE_H
+
+#include "loaders/image_file.h"
+#include "image/texture_image.h"
+#include "image/tiled_texture.h"
+#include "image/mipmap.h"
+#include "image/texture_compress.h"
+#include "utils/mapped_file.h"
+#include "utils/hash.h"
+
+#include <string>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace CxxRay {
+
+// texture cache files hold a texture's pixels exactly as
+// TextureImage keeps them in memory, packed Rgb in its
+// layout or BC1 blocks, after a fixed size header and
+// followed by the rest of its mip chain, level after level
+//
+// a cached texture is mapped and sampled in place so it
+// costs nothing up front and only the pages holding
+// texels a frame touches are ever read in
+namespace texCache
+{
+    constexpr char kMagic[8] = {'C', 'X', 'R', 'T', 'E', 'X', '\0', '\0'};
+    constexpr uint32_t kVersion = 2;
+    constexpr size_t kHeaderSize = 64;
+
+    struct Header
+    {
+        char magic[8] = {};
+        uint32_t version = kVersion;
+
+        // mip levels stored, counting the full size one
+        uint32_t levels = 0;
+
+        // TexelLayout and TextureFormat of every level
+        uint32_t layout = 0;
+        uint32_t format = 0;
+
+        int64_t w = 0;
+        int64_t h = 0;
+
+        // size and modification time of the source image
+        uint64_t sourceSize = 0;
+        int64_t sourceTime = 0;
+
+        uint64_t pixelOffset = kHeaderSize;
+    };
+
+    static_assert(sizeof(Header) <= kHeaderSize, "texture cache header must fit its slot");
+
+    // identifies the source image as it is now, a missing
+    // file gets a stamp no cache file can match
+    inline
+    bool
+    sourceStamp(
+        std::string const & texPath,
+        uint64_t & size,
+        int64_t & time)
+    {
+        namespace fs = std::filesystem;
+
+        std::error_code ec;
+
+        size = static_cast<uint64_t>(fs::file_size(texPath, ec));
+
+        if (ec) {
+            return false;
+        }
+
+        time = static_cast<int64_t>(fs::last_write_time(texPath, ec).time_since_epoch().count());
+
+        return !ec;
+    }
+
+    inline
+    bool
+    writeCache(
+        std::string const & filePath,
+        TextureImage const & img,
+        uint64_t const sourceSize,
+        int64_t const sourceTime)
+    {
+        namespace fs = std::filesystem;
+
+        Header header{};
+
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.levels = static_cast<uint32_t>(img.levels());
+        header.layout = static_cast<uint32_t>(img.layout);
+        header.format = static_cast<uint32_t>(img.format);
+        header.w = img.w;
+        header.h = img.h;
+        header.sourceSize = sourceSize;
+        header.sourceTime = sourceTime;
+
+        char headerBuf[kHeaderSize] = {};
+        std::memcpy(headerBuf, &header, sizeof(header));
+
+        // write next to the target and rename so a reader
+        // never maps a half written file
+        auto const tmpPath = filePath + ".tmp";
+
+        {
+            std::ofstream fh{tmpPath, std::ios::binary};
+
+            if (!fh.is_open()) {
+                return false;
+            }
+
+            fh.write(headerBuf, kHeaderSize);
+            if (img.format == TextureFormat::Bc1)
+            {
+                // the levels' blocks are stored back to back
+                auto const blocks = bc1ChainBlocks(img.w, img.h, img.mips);
+
+                fh.write(reinterpret_cast<char const *>(img.blocks), static_cast<std::streamsize>(static_cast<size_t>(blocks) * sizeof(Bc1Block)));
+            }
+            else
+            {
+                auto const bytes = [&img](long const w, long const h) {
+                    return static_cast<std::streamsize>(layoutTexels(img.layout, w, h) * 3);
+                };
+
+                fh.write(reinterpret_cast<char const *>(img.pixels), bytes(img.w, img.h));
+
+                for (auto const & mip : img.mips) {
+                    fh.write(reinterpret_cast<char const *>(mip.pixels), bytes(mip.w, mip.h));
+                }
+            }
+
+            if (!fh) {
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        fs::rename(tmpPath, filePath, ec);
+
+        return !ec;
+    }
+
+    // map a cache file, leaves the image unmapped when the
+    // file is missing, damaged, in another layout or format
+    // or made from another version of the source
+    inline
+    TextureImage
+    openCache(
+        std::string const & filePath,
+        uint64_t const sourceSize,
+        int64_t const sourceTime,
+        TexelLayout const layout = TexelLayout::RowMajor,
+        TextureFormat const format = TextureFormat::Rgb8)
+    {
+        MappedFile file{filePath};
+
+        if (!file.isOpen() || file.size() < kHeaderSize) {
+            return TextureImage{};
+        }
+
+        Header header{};
+        std::memcpy(&header, file.data(), sizeof(header));
+
+        // sizes are checked against the file below, this only
+        // keeps them from overflowing on the way
+        if (header.w <= 0 || header.h <= 0 || header.w > (1l << 30) || header.h > (1l << 30)) {
+            return TextureImage{};
+        }
+
+        auto const w = static_cast<long>(header.w);
+        auto const h = static_cast<long>(header.h);
+
+        auto levels = mipLevelSizes(w, h);
+
+        auto const pixelBytes = format == TextureFormat::Bc1
+            ? static_cast<uint64_t>(bc1ChainBlocks(w, h, levels)) * sizeof(Bc1Block)
+            : static_cast<uint64_t>(layoutTexels(layout, w, h) + mipChainTexels(levels, layout)) * 3;
+
+        bool const ok = std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0
+            && header.version == kVersion
+            && header.layout == static_cast<uint32_t>(layout)
+            && header.format == static_cast<uint32_t>(format)
+            && header.levels == levels.size() + 1
+            && header.sourceSize == sourceSize
+            && header.sourceTime == sourceTime
+            && header.pixelOffset == kHeaderSize
+            && file.size() == kHeaderSize + pixelBytes;
+
+        if (!ok) {
+            return TextureImage{};
+        }
+
+        TextureImage img{std::move(file), kHeaderSize, w, h};
+
+        img.layout = layout;
+        img.mips = std::move(levels);
+
+        if (format == TextureFormat::Bc1) {
+            placeBc1Levels(img, reinterpret_cast<Bc1Block const *>(img.mapping.data() + kHeaderSize));
+        } else {
+            placeMipLevels(img.mips, img.pixels + layoutTexels(layout, w, h), layout);
+        }
+
+        return img;
+    }
+
+    // tiled cache files hold the same pixels cut into square
+    // tiles of tileSize texels a side, each tile contiguous so
+    // it is read with a single seek, tiles on the right and
+    // top edges are padded by repeating the last texel
+    constexpr char kTileMagic[8] = {'C', 'X', 'R', 'T', 'I', 'L', '\0', '\0'};
+
+    struct TileHeader
+    {
+        char magic[8] = {};
+        uint32_t version = kVersion;
+        uint32_t tileSize = 0;
+
+        int64_t w = 0;
+        int64_t h = 0;
+
+        uint64_t sourceSize = 0;
+        int64_t sourceTime = 0;
+
+        uint64_t tileOffset = kHeaderSize;
+    };
+
+    static_assert(sizeof(TileHeader) <= kHeaderSize, "tiled texture header must fit its slot");
+
+    inline
+    bool
+    writeTiles(
+        std::string const & filePath,
+        TextureImage const & img,
+        long const tileSize,
+        uint64_t const sourceSize,
+        int64_t const sourceTime)
+    {
+        namespace fs = std::filesystem;
+
+        TileHeader header{};
+
+        std::memcpy(header.magic, kTileMagic, sizeof(kTileMagic));
+        header.tileSize = static_cast<uint32_t>(tileSize);
+        header.w = img.w;
+        header.h = img.h;
+        header.sourceSize = sourceSize;
+        header.sourceTime = sourceTime;
+
+        char headerBuf[kHeaderSize] = {};
+        std::memcpy(headerBuf, &header, sizeof(header));
+
+        auto const tmpPath = filePath + ".tmp";
+
+        {
+            std::ofstream fh{tmpPath, std::ios::binary};
+
+            if (!fh.is_open()) {
+                return false;
+            }
+
+            fh.write(headerBuf, kHeaderSize);
+
+            std::vector<Rgb> tile(static_cast<size_t>(tileSize * tileSize));
+
+            for (long ty = 0; ty * tileSize < img.h; ty++)
+            {
+                for (long tx = 0; tx * tileSize < img.w; tx++)
+                {
+                    for (long j = 0; j < tileSize; j++)
+                    {
+                        auto const y = std::min(ty * tileSize + j, img.h - 1);
+
+                        for (long i = 0; i < tileSize; i++)
+                        {
+                            auto const x = std::min(tx * tileSize + i, img.w - 1);
+
+                            tile[static_cast<size_t>(j * tileSize + i)] = img.texel(x, y);
+                        }
+                    }
+
+                    fh.write(reinterpret_cast<char const *>(tile.data()), static_cast<std::streamsize>(tile.size() * sizeof(Rgb)));
+                }
+            }
+
+            if (!fh) {
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        fs::rename(tmpPath, filePath, ec);
+
+        return !ec;
+    }
+
+    // open a tiled cache file, null when the file is missing,
+    // damaged, cut into other tiles or made from another
+    // version of the source
+    inline
+    std::shared_ptr<TiledTexture const>
+    openTiles(
+        std::string const & filePath,
+        long const tileSize,
+        TileCache & cache,
+        uint64_t const sourceSize,
+        int64_t const sourceTime)
+    {
+        namespace fs = std::filesystem;
+
+        std::error_code ec;
+
+        auto const fileSize = fs::file_size(filePath, ec);
+
+        if (ec || fileSize < kHeaderSize) {
+            return nullptr;
+        }
+
+        TileHeader header{};
+
+        {
+            std::ifstream fh{filePath, std::ios::binary};
+
+            if (!fh.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+                return nullptr;
+            }
+        }
+
+        // bounded like openCache before the tile count is
+        // worked out from them
+        if (tileSize <= 0 || header.w <= 0 || header.h <= 0 || header.w > (1l << 30) || header.h > (1l << 30)) {
+            return nullptr;
+        }
+
+        auto const tiles = static_cast<uint64_t>((header.w + tileSize - 1) / tileSize)
+            * static_cast<uint64_t>((header.h + tileSize - 1) / tileSize);
+
+        auto const tileBytes = static_cast<uint64_t>(tileSize) * static_cast<uint64_t>(tileSize) * sizeof(Rgb);
+
+        bool const ok = std::memcmp(header.magic, kTileMagic, sizeof(kTileMagic)) == 0
+            && header.version == kVersion
+            && header.tileSize == static_cast<uint32_t>(tileSize)
+            && header.sourceSize == sourceSize
+            && header.sourceTime == sourceTime
+            && header.tileOffset == kHeaderSize
+            && fileSize == kHeaderSize + tiles * tileBytes;
+
+        if (!ok) {
+            return nullptr;
+        }
+
+        auto tiled = std::make_shared<TiledTexture>(
+            filePath, kHeaderSize, static_cast<long>(header.w), static_cast<long>(header.h), tileSize, cache);
+
+        if (!tiled->isOpen()) {
+            return nullptr;
+        }
+
+        return tiled;
+    }
+}
+
+// where a texture's cache file lives, named after the
+// texture with a hash of its path so files of the same
+// name in different folders do not collide
+inline
+std::string
+textureCachePath(
+    std::string const & texPath,
+    std::string const & cacheDir,
+    std::string const & extension = ".cxtex")
+{
+    namespace fs = std::filesystem;
+
+    auto const absPath = fs::absolute(texPath).lexically_normal().string();
+
+    auto const name = fs::path{texPath}.stem().string() + "-" + hashHex(hashString(absPath)) + extension;
+
+    return (fs::path{cacheDir} /= name).string();
+}
+
+// decode a texture into memory along with its mip chain,
+// compressed textures have no layout of their own
+inline
+TextureImage
+loadMippedTexture(
+    std::string const & texPath,
+    TexelLayout const layout = TexelLayout::RowMajor,
+    TextureFormat const format = TextureFormat::Rgb8)
+{
+    auto img = loadTextureFile(texPath);
+
+    generateMips(img);
+
+    if (format == TextureFormat::Bc1) {
+        compressTexture(img);
+    } else {
+        relayoutTexture(img, layout);
+    }
+
+    return img;
+}
+
+// load a texture mapped from the cache directory
+//
+// the first time a texture is seen (or after its file
+// changed) it is decoded as usual and written to the cache,
+// from then on only the header is read at load time, if
+// the cache can not be written the decoded image is used
+inline
+TextureImage
+loadMappedTexture(
+    std::string const & texPath,
+    std::string const & cacheDir,
+    TexelLayout const layout = TexelLayout::RowMajor,
+    TextureFormat const format = TextureFormat::Rgb8)
+{
+    using namespace texCache;
+
+    namespace fs = std::filesystem;
+
+    uint64_t size = 0;
+    int64_t time = 0;
+
+    if (!sourceStamp(texPath, size, time)) {
+        return loadMippedTexture(texPath, layout, format);
+    }
+
+    // a compressed texture is only encoded once, and each
+    // layout has its own file so switching is free
+    auto const cacheLayout = format == TextureFormat::Bc1 ? TexelLayout::RowMajor : layout;
+
+    auto const extension = format == TextureFormat::Bc1 ? ".bc1.cxtex"
+        : layout == TexelLayout::Blocked ? ".blk.cxtex"
+        : ".cxtex";
+
+    auto const cachePath = textureCachePath(texPath, cacheDir, extension);
+
+    auto cached = openCache(cachePath, size, time, cacheLayout, format);
+
+    if (cached.mapped()) {
+        return cached;
+    }
+
+    auto img = loadMippedTexture(texPath, cacheLayout, format);
+
+    std::error_code ec;
+    fs::create_directories(cacheDir, ec);
+
+    if (!writeCache(cachePath, img, size, time)) {
+        std::cout << "Could not write texture cache: " << cachePath << std::endl;
+        return img;
+    }
+
+    auto written = openCache(cachePath, size, time, cacheLayout, format);
+
+    return written.mapped() ? std::move(written) : std::move(img);
+}
+
+// load a texture streamed in tiles through a tile cache
+//
+// the tiled file is written to the cache directory the
+// first time, after that only its header is read at load
+// time and tiles are read in as they are sampled, evicting
+// the least recently used ones to stay within the cache's
+// budget, falls back to the decoded image when the tiled
+// file can not be written
+inline
+TextureImage
+loadTiledTexture(
+    std::string const & texPath,
+    std::string const & cacheDir,
+    TileCache & cache,
+    long const tileSize = 64)
+{
+    using namespace texCache;
+
+    namespace fs = std::filesystem;
+
+    uint64_t size = 0;
+    int64_t time = 0;
+
+    if (!sourceStamp(texPath, size, time)) {
+        return loadMippedTexture(texPath);
+    }
+
+    auto const cachePath = textureCachePath(texPath, cacheDir, ".t" + std::to_string(tileSize) + ".cxtile");
+
+    if (auto tiles = openTiles(cachePath, tileSize, cache, size, time)) {
+        return TextureImage{std::move(tiles)};
+    }
+
+    auto img = loadTextureFile(texPath);
+
+    std::error_code ec;
+    fs::create_directories(cacheDir, ec);
+
+    if (!writeTiles(cachePath, img, tileSize, size, time)) {
+        std::cout << "Could not write tiled texture: " << cachePath << std::endl;
+        return img;
+    }
+
+    if (auto tiles = openTiles(cachePath, tileSize, cache, size, time)) {
+        return TextureImage{std::move(tiles)};
+    }
+
+    return img;
+}
+
+// how textures are loaded: decoded into memory, mapped
+// from the cache directory or, with a tile cache as well,
+// streamed in tiles from it
+//
+// decoded and mapped textures come with their mip chain
+// in the layout and format asked for, streamed ones only
+// have the full size level and their tiles are row major
+// and uncompressed
+struct TextureLoadOptions
+{
+    std::string cacheDir = "";
+
+    TileCache * tileCache = nullptr;
+
+    long tileSize = 64;
+
+    TexelLayout layout = TexelLayout::RowMajor;
+
+    TextureFormat format = TextureFormat::Rgb8;
+};
+
+// load a texture as the options ask
+inline
+TextureImage
+loadTexture(
+    std::string const & texPath,
+    TextureLoadOptions const & opts)
+{
+    if (opts.cacheDir == "") {
+        return loadMippedTexture(texPath, opts.layout, opts.format);
+    }
+
+    return opts.tileCache != nullptr
+        ? loadTiledTexture(texPath, opts.cacheDir, *opts.tileCache, opts.tileSize)
+        : loadMappedTexture(texPath, opts.cacheDir, opts.layout, opts.format);
+}
+
+// load a texture, through the cache when a directory is given
+inline
+TextureImage
+loadTexture(
+    std::string const & texPath,
+    std::string const & cacheDir = "")
+{
+    return loadTexture(texPath, TextureLoadOptions{cacheDir});
+}
+
+} // namespace CxxRay
+
+#endif
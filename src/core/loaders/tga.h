@@ -4,13 +4,19 @@
 #include "image/texture_image.h"
 #include "image/pixel.h"
 #include "rgb/rgb.h"
+#include "image/swizzle.h"
+#include "image/image_write.h"
 #include "utils/data_array.h"
+#include "utils/mapped_file.h"
 
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <stdexcept>
+#include <cstdint>
+#include <cstring>
 
 namespace CxxRay {
 
@@ -47,6 +53,7 @@ namespace tgaParse
         }
     };
 
+    inline
     std::string
     toString(
         TargaHeader const & h)
@@ -70,50 +77,155 @@ namespace tgaParse
         return ss.str();
     }
 
+    constexpr size_t kHeaderSize = 18;
+
+    // image descriptor bit set when the first row
+    // in the file is the top of the image
+    constexpr int kTopOrigin = 0x20;
+
+    inline
+    int16_t
+    readWord(
+        unsigned char const * p)
+    {
+        return static_cast<int16_t>(p[0] | (p[1] << 8));
+    }
+
+    // parse the header at the start of the file, returns
+    // the offset of the pixel data or 0 when the file is
+    // too short to hold the header
     inline
-    TargaHeader
+    size_t
     readHeader(
-        std::ifstream & fh)
+        unsigned char const * data,
+        size_t const len,
+        TargaHeader & header)
     {
-        TargaHeader header;
+        if (len < kHeaderSize) {
+            return 0;
+        }
 
-        header.idLen = static_cast<char>(fh.get());
-        header.cmType = static_cast<char>(fh.get());
-        header.dataType = static_cast<char>(fh.get());
+        header.idLen = static_cast<char>(data[0]);
+        header.cmType = static_cast<char>(data[1]);
+        header.dataType = static_cast<char>(data[2]);
+        header.cmOrigin = readWord(data + 3);
+        header.cmLen = readWord(data + 5);
+        header.cmDepth = static_cast<char>(data[7]);
+        header.xOrigin = readWord(data + 8);
+        header.yOrigin = readWord(data + 10);
+        header.w = readWord(data + 12);
+        header.h = readWord(data + 14);
+        header.depth = static_cast<char>(data[16]);
+        header.id = static_cast<char>(data[17]);
+
+        size_t at = kHeaderSize;
+
+        auto const take = [&](size_t const n, std::string & out) {
+            auto const avail = std::min(n, len - at);
+
+            out.assign(reinterpret_cast<char const *>(data + at), avail);
+            at += avail;
+        };
 
-        fh.read(reinterpret_cast<char*>(&header.cmOrigin), 2);
-        fh.read(reinterpret_cast<char*>(&header.cmLen), 2);
+        take(static_cast<unsigned char>(header.idLen), header.descr);
 
-        header.cmDepth = static_cast<char>(fh.get());
+        // color map entries are skipped, only true color
+        // images are decoded
+        auto const cmBytes = header.cmType != 0
+            ? static_cast<size_t>(static_cast<uint16_t>(header.cmLen)) * ((static_cast<size_t>(header.cmDepth) + 7) / 8)
+            : 0;
 
-        fh.read(reinterpret_cast<char*>(&header.xOrigin), 2);
-        fh.read(reinterpret_cast<char*>(&header.yOrigin), 2);
+        take(cmBytes, header.colormap);
 
-        fh.read(reinterpret_cast<char*>(&header.w), 2);
-        fh.read(reinterpret_cast<char*>(&header.h), 2);
+        return at;
+    }
 
-        header.depth = static_cast<char>(fh.get());
+    // swizzle n pixels of bpp bytes each into Rgb
+    inline
+    void
+    copyPixels(
+        unsigned char const * src,
+        Rgb * dst,
+        size_t const n,
+        size_t const bpp)
+    {
+        if (bpp == 4) {
+            bgraToRgb(src, dst, n);
+        } else {
+            bgrToRgb(src, dst, n);
+        }
+    }
 
-        header.id = static_cast<char>(fh.get());
+    // decode run length packets into count pixels, a packet
+    // may cross row ends, returns the pixels decoded
+    inline
+    size_t
+    decodeRle(
+        unsigned char const * p,
+        unsigned char const * const end,
+        Rgb * dst,
+        size_t const count,
+        size_t const bpp)
+    {
+        size_t done = 0;
+
+        while (done < count && p < end)
+        {
+            auto const packet = *p++;
+            auto const n = std::min(static_cast<size_t>(packet & 0x7f) + 1, count - done);
 
-        if (int(header.idLen) > 0) {
-            std::string strBuf(header.idLen, ' ');
+            if (packet & 0x80)
+            {
+                // one pixel repeated
+                if (static_cast<size_t>(end - p) < bpp) {
+                    break;
+                }
 
-            fh.read(strBuf.data(), header.idLen);
+                Rgb px;
+                copyPixels(p, &px, 1, bpp);
+                p += bpp;
 
-            header.descr = strBuf;
+                std::fill(dst + done, dst + done + n, px);
+            }
+            else
+            {
+                // n literal pixels
+                auto const avail = static_cast<size_t>(end - p) / bpp;
+                auto const m = std::min(n, avail);
+
+                copyPixels(p, dst + done, m, bpp);
+                p += (static_cast<size_t>(packet & 0x7f) + 1) * bpp;
+
+                if (m < n) {
+                    return done + m;
+                }
+            }
+
+            done += n;
         }
 
-        auto const cmSz = header.cmType * header.cmLen;
-        if (cmSz > 0) {
-            std::string strBuf(cmSz, ' ');
+        return done;
+    }
 
-            fh.read(strBuf.data(), cmSz);
+    // images are kept bottom row first like TGA's default
+    inline
+    void
+    flipRows(
+        Rgb * pixels,
+        long const w,
+        long const h)
+    {
+        std::vector<Rgb> tmp(static_cast<size_t>(w));
 
-            header.colormap = strBuf;
-        }
+        for (long top = 0, bot = h - 1; top < bot; top++, bot--)
+        {
+            auto * a = pixels + top * w;
+            auto * b = pixels + bot * w;
 
-        return header;
+            std::copy(a, a + w, tmp.begin());
+            std::copy(b, b + w, a);
+            std::copy(tmp.begin(), tmp.end(), b);
+        }
     }
 
     inline char wordLo( int16_t x) {
@@ -126,11 +238,11 @@ namespace tgaParse
 
     inline
     void
-    writeHeader(
-        std::ofstream & fh,
-        TargaHeader const & header)
+    headerBytes(
+        TargaHeader const & header,
+        char buf[kHeaderSize])
     {
-        char buf[18] = {
+        char const bytes[kHeaderSize] = {
             header.idLen, // no image descriptor
             header.cmType,
             header.dataType,
@@ -151,10 +263,29 @@ namespace tgaParse
             header.id
         };
 
-        fh.write(buf, 18);
+        std::memcpy(buf, bytes, kHeaderSize);
+    }
+
+    inline
+    void
+    writeHeader(
+        std::ofstream & fh,
+        TargaHeader const & header)
+    {
+        char buf[kHeaderSize];
+
+        headerBytes(header, buf);
+
+        fh.write(buf, kHeaderSize);
     }
 }
 
+// load a 24 or 32 bit true color TGA, uncompressed
+// (type 2) or run length encoded (type 10)
+//
+// the file is mapped and decoded in one pass, alpha is
+// dropped and images stored top row first are flipped
+// to the bottom row first order used everywhere else
 inline
 TextureImage
 loadTargaFile(
@@ -162,59 +293,75 @@ loadTargaFile(
 {
     using namespace tgaParse;
 
-    using std::ifstream;
     using std::runtime_error;
 
-    ifstream fh{filePath, ::std::ios::binary};
+    MappedFile file{filePath};
 
-    if (!fh.good()) {
+    if (!file.isOpen()) {
         throw std::runtime_error{"ERROR OPENING: " + filePath};
     }
 
-    auto header = readHeader(fh);
+    auto const * const data = reinterpret_cast<unsigned char const *>(file.data());
+    auto const * const end = data + file.size();
+
+    TargaHeader header;
+
+    auto const offset = readHeader(data, file.size(), header);
+
+    if (offset == 0) {
+        throw runtime_error{"TGA file too short: " + filePath};
+    }
+
+    auto const type = static_cast<int>(header.dataType);
+    auto const depth = static_cast<int>(static_cast<unsigned char>(header.depth));
 
-    if (static_cast<int>(header.dataType) != 2) {
-        throw runtime_error{"TGA Loader only supports uncompressed RGB format."};
+    if (type != 2 && type != 10) {
+        throw runtime_error{"TGA Loader only supports uncompressed or RLE RGB format."};
     }
 
-    if (static_cast<int>(header.depth) != 24) {
-        throw runtime_error{"TGA Loader only supports 24-bit color depth."};
+    if (depth != 24 && depth != 32) {
+        throw runtime_error{"TGA Loader only supports 24 or 32-bit color depth."};
     }
 
-    auto const w = header.w;
-    auto const h = header.w;
+    long const w = static_cast<uint16_t>(header.w);
+    long const h = static_cast<uint16_t>(header.h);
+
+    auto const bpp = static_cast<size_t>(depth / 8);
+    auto const count = static_cast<size_t>(w * h);
 
     TextureImage img{w, h};
     Rgb * pixels = img.pixels;
 
-    for (long row = 0; row < h; row++)
-    {
-        for (long col = 0; col < w; col++)
-        {
-            if (fh.eof()) {
-                return img;
-            }
+    size_t done = 0;
 
-            Rgb p{};
+    if (type == 2) {
+        done = std::min(count, static_cast<size_t>(end - (data + offset)) / bpp);
 
-            p.b = static_cast<char>(fh.get());
-            p.g = static_cast<char>(fh.get());
-            p.r = static_cast<char>(fh.get());
+        copyPixels(data + offset, pixels, done, bpp);
+    } else {
+        done = decodeRle(data + offset, end, pixels, count, bpp);
+    }
 
-            pixels[row * w + col] = p;
-        }
+    // a truncated file leaves the rest black
+    std::fill(pixels + done, pixels + count, Rgb{0});
+
+    if (static_cast<unsigned char>(header.id) & kTopOrigin) {
+        flipRows(pixels, w, h);
     }
 
     return img;
 }
 
+// save as an uncompressed 24-bit TGA, rows are written
+// bottom first as stored so only the color order changes
 inline
 void
 saveTargaFile(
     std::string const & filePath,
     Rgb const * pixels,
     long const w,
-    long const h)
+    long const h,
+    ImageWriteMode const mode = ImageWriteMode::Buffered)
 {
     using namespace tgaParse;
     using std::ios;
@@ -223,27 +370,56 @@ saveTargaFile(
     // initialize a header instance
     TargaHeader header{w, h};
 
+    char headerBuf[kHeaderSize];
+    headerBytes(header, headerBuf);
+
+    auto const count = static_cast<size_t>(w * h);
+
+    if (mode == ImageWriteMode::Mapped)
+    {
+        MappedOutputFile out{filePath, kHeaderSize + 3 * count};
+
+        if (out.isOpen())
+        {
+            std::memcpy(out.data(), headerBuf, kHeaderSize);
+
+            rgbToBgr(pixels, reinterpret_cast<unsigned char *>(out.data() + kHeaderSize), count);
+
+            if (!out.close()) {
+                throw std::runtime_error{"ERROR WRITING: " + filePath};
+            }
+
+            return;
+        }
+    }
+
     // open the file in binary mode
     ofstream fh{filePath, ios::binary};
 
     // write the header to the file
-    writeHeader(fh, header);
+    fh.write(headerBuf, kHeaderSize);
+
+    // convert and write the image data a block at a time
+    auto & buf = imageWriteBuffer();
 
-    // write image data to the file
-    for (long row = 0; row < h; row++)
+    auto const block = buf.size() / 3;
+
+    for (size_t i = 0; i < count; i += block)
     {
-        for (long col = 0; col < w; col++)
-        {
-            auto const p = pixels[row * w + col];
+        auto const n = std::min(block, count - i);
 
-            fh.put(p.b);
-            fh.put(p.g);
-            fh.put(p.r);
-        }
+        rgbToBgr(pixels + i, buf.data(), n);
+
+        fh.write(reinterpret_cast<char const *>(buf.data()), static_cast<std::streamsize>(3 * n));
     }
 
     fh.flush();
     fh.close();
+
+    // a file that could not be opened or filled fails too
+    if (!fh) {
+        throw std::runtime_error{"ERROR WRITING: " + filePath};
+    }
 }
 
 } // namespace CxxRay
@@ -3,10 +3,13 @@
 
 #include "world/mesh.h"
 #include "utils/strings.h"
-#include "loaders/tga.h"
+#include "loaders/image_file.h"
+#include "loaders/texture_cache.h"
+#include "utils/thread_pool.h"
 
 #include <string>
 #include <unordered_map>
+#include <future>
 
 #include <regex>
 #include <sstream>
@@ -16,11 +19,59 @@
 
 namespace CxxRay {
 
+// textures being decoded on the default thread pool
+using TextureLoads = std::unordered_map<std::string,std::future<TextureHandle>>;
+
+// start decoding a texture in the background unless it
+// is already loaded or on its way, with a cache directory
+// it is mapped or streamed from its cache file instead
+inline
+void
+requestTexture(
+    std::string const & texPath,
+    TextureMap const & textures,
+    TextureLoads & loads,
+    TextureLoadOptions const & opts = {})
+{
+    if (textures.count(texPath) != 0 || loads.count(texPath) != 0) {
+        return;
+    }
+
+    std::cout << "Loading texture: " << texPath << std::endl;
+
+    loads[texPath] = defaultThreadPool().submit([texPath, opts]() {
+        return makeTextureHandle(loadTexture(texPath, opts));
+    });
+}
+
+// wait for every requested texture and move it into the
+// map, a texture that failed to load rethrows its error
+//
+// must not be called from a pool thread, the decodes
+// could be queued behind it
+inline
+void
+resolveTextures(
+    TextureMap & textures,
+    TextureLoads & loads)
+{
+    for (auto & [ texPath, load ] : loads) {
+        textures[texPath] = load.get();
+    }
+
+    loads.clear();
+}
+
+// with loads given textures are only requested and the
+// caller resolves them, otherwise each is decoded on the
+// spot
 inline
 void loadWavefrontMtlFile(
     Mesh & mesh,
     std::string const & filePathArg,
-    std::unordered_map<std::string,TextureImage> & textures)
+    TextureMap & textures,
+    TextureLoads * loads = nullptr,
+    TextureLoadOptions const & textureOpts = {})
 {
     using std::cout;
     using std::endl;
@@ -112,11 +163,15 @@ void loadWavefrontMtlFile(
 
             string const texPath = m[1];
 
-            if (textures.count(texPath) == 0)
+            if (loads != nullptr)
+            {
+                requestTexture(texPath, textures, *loads, textureOpts);
+            }
+            else if (textures.count(texPath) == 0)
             {
                 cout << "Loading texture: " << texPath << endl;
 
-                textures[texPath] = loadTargaFile(texPath);
+                textures[texPath] = makeTextureHandle(loadTexture(texPath, textureOpts));
             }
 
             mesh.mtls[mtlName].texName = texPath;
@@ -180,6 +235,65 @@ void loadWavefrontMtlFile(
     }
 }
 
+namespace mtlWrite {
+
+    inline
+    void
+    appendColor(
+        std::string & out,
+        char const * tok,
+        RgbReal const & c)
+    {
+        out += tok;
+        out += ' '; appendReal(out, c.r);
+        out += ' '; appendReal(out, c.g);
+        out += ' '; appendReal(out, c.b);
+        out += '\n';
+    }
+
+} // namespace mtlWrite
+
+// reals are written in fixed notation which
+// stays within what the loader's patterns accept
+inline
+void
+saveWavefrontMtlFile(
+    std::string const & filePath,
+    Mesh const & mesh)
+{
+    using namespace mtlWrite;
+
+    using std::string;
+    using std::ofstream;
+
+    string out = "";
+
+    for (auto const & [ mtlName, mtl ] : mesh.mtls)
+    {
+        if (mtlName == "no_mtl") {
+            continue;
+        }
+
+        out += "newmtl " + mtlName + "\n";
+
+        out += "Ns "; appendReal(out, mtl.specExp); out += '\n';
+
+        appendColor(out, "Ka", mtl.ambient);
+        appendColor(out, "Kd", mtl.diffuse);
+        appendColor(out, "Ks", mtl.specular);
+
+        if (mtl.texName != "") {
+            out += "map_Kd " + mtl.texName + "\n";
+        }
+
+        out += '\n';
+    }
+
+    ofstream fh{filePath, std::ios::binary};
+
+    fh.write(out.data(), static_cast<std::streamsize>(out.size()));
+}
+
 } // namespace CxxRay
 
 #endif
@@ -5,182 +5,933 @@
 
 #include "world/mesh.h"
 #include "utils/strings.h"
+#include "utils/mapped_file.h"
+#include "utils/mem_stats.h"
+#include "utils/thread_pool.h"
 
 #include <string>
-#include <regex>
-#include <sstream>
+#include <vector>
+#include <future>
+#include <algorithm>
+#include <utility>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
+#include <charconv>
+#include <cstring>
+#include <unordered_map>
+#include <cstdint>
 
 namespace CxxRay {
 
-inline
-Mesh
-loadWavefrontObjFile(
-    std::string const & filePath,
-    std::unordered_map<std::string,TextureImage> & textures)
-{
-    using std::cout;
-    using std::endl;
+namespace objParse {
 
-    using std::string;
-    using std::stringstream;
-    using std::ifstream;
-    using std::getline;
+    inline
+    bool isSpace(char const c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
 
-    using std::regex;
-    using std::regex_match;
-    using std::smatch;
+    inline
+    char const *
+    skipSpace(
+        char const * p,
+        char const * const end)
+    {
+        while (p < end && isSpace(*p)) {
+            p++;
+        }
 
-    using std::stod;
-    using std::stoll;
+        return p;
+    }
 
-    namespace fs = std::filesystem;
+    // end of the line starting at p, not including
+    // the newline, a comment ends the line early
+    inline
+    char const *
+    lineEnd(
+        char const * const p,
+        char const * const end,
+        char const ** next)
+    {
+        auto const * nl = static_cast<char const *>(
+            std::memchr(p, '\n', static_cast<size_t>(end - p)));
 
-    Mesh mesh;
+        auto const * eol = nl != nullptr ? nl : end;
 
-    regex pat_usemtl{"usemtl (.*)"};
-    regex pat_mtllib{"mtllib (.*)"};
-    regex pat_o{"o (.*)"};
-    regex pat_v{"v (-?\\d+\\.\\d+) (-?\\d+\\.\\d+) (-?\\d+\\.\\d+) ?(-?\\d+\\.\\d+)?"};
-    regex pat_vn{"vn (-?\\d+\\.\\d+) (-?\\d+\\.\\d+) (-?\\d+\\.\\d+) ?(-?\\d+\\.\\d+)?"};
-    regex pat_vt{"vt (-?\\d+\\.\\d+) (-?\\d+\\.\\d+)"};
-    regex pat_f{"f (\\d+)/?(\\d+)?/?(\\d+)? (\\d+)/?(\\d+)?/?(\\d+)? (\\d+)/?(\\d+)?/?(\\d+)?"};
+        *next = nl != nullptr ? nl + 1 : end;
 
-    string line = "";
-    string tok = "";
+        auto const * hash = static_cast<char const *>(
+            std::memchr(p, '#', static_cast<size_t>(eol - p)));
 
-    auto fileName = fs::path{filePath}.filename().string();
-    auto fileDir = fs::path{filePath}.parent_path().string();
+        return hash != nullptr ? hash : eol;
+    }
 
-    auto fh = ifstream{filePath};
+    // the rest of the line with surrounding white space trimmed
+    inline
+    std::string
+    restOfLine(
+        char const * p,
+        char const * end)
+    {
+        p = skipSpace(p, end);
+
+        while (end > p && isSpace(*(end - 1))) {
+            end--;
+        }
 
-    if (!fh.is_open()) {
-        cout << "loadMeshOBJ(): File not found " << filePath << endl;
-        return mesh;
+        return std::string{p, end};
     }
 
-    string mtlName = "no_mtl";
+    // whitespace separated reals, returns
+    // false when fewer than n were found
+    inline
+    bool
+    parseReals(
+        char const * p,
+        char const * const end,
+        Real * out,
+        int const n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            p = skipSpace(p, end);
+            p = parseReal(p, end, out[i]);
 
-    while (!fh.eof()) {
-        getline(fh, line);
+            if (p == nullptr || (p < end && !isSpace(*p))) {
+                return false;
+            }
+        }
 
-        trim(line);
-        strip_comments(line);
+        return true;
+    }
 
-        if (line.size() == 0) {
-            continue;
+    // v, v/vt, v//vn or v/vt/vn with missing
+    // references left as 0
+    inline
+    char const *
+    parseFaceVertex(
+        char const * p,
+        char const * const end,
+        MeshIndex & out)
+    {
+        out = MeshIndex{};
+
+        p = parseInt(p, end, out.id);
+
+        if (p == nullptr) {
+            return nullptr;
         }
 
-        stringstream ss{line};
-        ss >> tok;
-
-        smatch m;
-        if (tok == "mtllib")
+        if (p < end && *p == '/')
         {
-            if (!regex_match(line, m, pat_mtllib))
+            p++;
+
+            if (p < end && *p != '/' && !isSpace(*p)) {
+                p = parseInt(p, end, out.uvId);
+
+                if (p == nullptr) {
+                    return nullptr;
+                }
+            }
+
+            if (p < end && *p == '/')
             {
-                cout << "INVALID MTL LIB" << endl;
-                continue;
+                p++;
+
+                if (p < end && !isSpace(*p)) {
+                    p = parseInt(p, end, out.normId);
+
+                    if (p == nullptr) {
+                        return nullptr;
+                    }
+                }
+            }
+        }
+
+        if (p < end && !isSpace(*p)) {
+            return nullptr;
+        }
+
+        return p;
+    }
+
+    inline
+    bool
+    parseFace(
+        char const * p,
+        char const * const end,
+        MeshFaceIndex & out)
+    {
+        for (auto & I : out)
+        {
+            p = skipSpace(p, end);
+            p = parseFaceVertex(p, end, I);
+
+            if (p == nullptr) {
+                return false;
             }
+        }
 
-            string mtlLibName = m[1];
-            string mtlLibPath = (fs::path{fileDir} /= mtlLibName).string();
+        // only triangles are supported
+        return skipSpace(p, end) == end;
+    }
+
+    // negative references count back from the
+    // most recent element, -1 being the last one
+    inline
+    void
+    resolveRelative(
+        MeshFaceIndex & face,
+        size_t const verts,
+        size_t const uvs,
+        size_t const norms)
+    {
+        for (auto & I : face)
+        {
+            if (I.id < 0) { I.id += static_cast<long long>(verts) + 1; }
+            if (I.uvId < 0) { I.uvId += static_cast<long long>(uvs) + 1; }
+            if (I.normId < 0) { I.normId += static_cast<long long>(norms) + 1; }
+        }
+    }
 
-            loadWavefrontMtlFile(mesh, mtlLibPath, textures);
+    enum class Record
+    {
+        None,
+        Vertex,
+        Normal,
+        Uv,
+        Face,
+        UseMtl,
+        MtlLib,
+        Object,
+        Group,
+        Other
+    };
+
+    // identify the record from its leading token, p is
+    // left at the first character after the token
+    inline
+    Record
+    readRecord(
+        char const *& p,
+        char const * const end)
+    {
+        p = skipSpace(p, end);
+
+        auto const * tok = p;
+
+        while (p < end && !isSpace(*p)) {
+            p++;
         }
-        else if (tok == "v")
+
+        auto const len = p - tok;
+
+        if (len == 0) {
+            return Record::None;
+        }
+
+        if (len == 1 && tok[0] == 'v') { return Record::Vertex; }
+        if (len == 1 && tok[0] == 'f') { return Record::Face; }
+        if (len == 1 && tok[0] == 'o') { return Record::Object; }
+        if (len == 1 && tok[0] == 'g') { return Record::Group; }
+        if (len == 2 && tok[0] == 'v' && tok[1] == 'n') { return Record::Normal; }
+        if (len == 2 && tok[0] == 'v' && tok[1] == 't') { return Record::Uv; }
+        if (len == 6 && std::memcmp(tok, "usemtl", 6) == 0) { return Record::UseMtl; }
+        if (len == 6 && std::memcmp(tok, "mtllib", 6) == 0) { return Record::MtlLib; }
+
+        return Record::Other;
+    }
+
+    // names of the mtllib records ahead of the first
+    // vertex or face, which is where files put them
+    inline
+    std::vector<std::string>
+    leadingMtlLibs(
+        char const * p,
+        char const * const end)
+    {
+        std::vector<std::string> names;
+
+        while (p < end)
         {
-            if (!regex_match(line, m, pat_v))
+            char const * next = end;
+            char const * const eol = lineEnd(p, end, &next);
+
+            auto const rec = readRecord(p, eol);
+
+            if (rec == Record::Vertex || rec == Record::Normal || rec == Record::Uv || rec == Record::Face) {
+                break;
+            }
+
+            if (rec == Record::MtlLib)
             {
-                cout << "INVALID VERTEX" << endl;
-                continue;
+                auto name = restOfLine(p, eol);
+
+                if (name.size() > 0) {
+                    names.push_back(std::move(name));
+                }
             }
 
-            mesh.verts.push_back(Vec3{
-                stod(m[1]),
-                stod(m[2]),
-                stod(m[3])
-            });
+            p = next;
         }
-        else if (tok == "vn")
+
+        return names;
+    }
+
+    struct ObjCounts
+    {
+        size_t verts = 0;
+        size_t norms = 0;
+        size_t uvs = 0;
+        size_t faces = 0;
+    };
+
+    // count records so the arrays can be
+    // reserved once instead of growing
+    inline
+    ObjCounts
+    prescan(
+        char const * p,
+        char const * const end)
+    {
+        ObjCounts counts{};
+
+        while (p < end)
         {
-            if (!regex_match(line, m, pat_vn))
+            auto const * nl = static_cast<char const *>(
+                std::memchr(p, '\n', static_cast<size_t>(end - p)));
+
+            auto const * eol = nl != nullptr ? nl : end;
+
+            if (eol - p >= 2)
             {
-                cout << "INVALID NORMAL" << endl;
-                continue;
+                if (p[0] == 'v' && p[1] == ' ') { counts.verts++; }
+                else if (p[0] == 'f' && p[1] == ' ') { counts.faces++; }
+                else if (p[0] == 'v' && p[1] == 'n') { counts.norms++; }
+                else if (p[0] == 'v' && p[1] == 't') { counts.uvs++; }
             }
 
-            mesh.norms.push_back(Vec3{
-                stod(m[1]),
-                stod(m[2]),
-                stod(m[3])
-            });
+            p = nl != nullptr ? nl + 1 : end;
         }
-        else if (tok == "vt")
+
+        return counts;
+    }
+
+    inline
+    bool
+    hasRelative(
+        MeshFaceIndex const & face)
+    {
+        for (auto const & I : face)
         {
-            if (!regex_match(line, m, pat_vt))
+            if (I.id < 0 || I.uvId < 0 || I.normId < 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // usemtl, mtllib, o or g record, applied before
+    // face number `face` of its chunk
+    struct ObjEvent
+    {
+        size_t face = 0;
+        Record rec = Record::None;
+        std::string name = "";
+    };
+
+    // a face with negative references along with the
+    // element counts of its chunk when it was read
+    struct ObjRelativeFace
+    {
+        size_t face = 0;
+        ObjCounts seen = {};
+    };
+
+    // everything read from one line aligned slice of the
+    // file, faces reference elements by file wide numbers
+    // except for the relative ones which are resolved
+    // once the counts of the earlier chunks are known
+    struct ObjChunk
+    {
+        ScratchVector<Vec3> verts = {};
+        ScratchVector<Vec3> norms = {};
+        ScratchVector<std::tuple<Real,Real>> uvs = {};
+        ScratchVector<MeshFaceIndex> faces = {};
+
+        std::vector<ObjEvent> events = {};
+        std::vector<ObjRelativeFace> relative = {};
+        std::vector<std::string> errors = {};
+    };
+
+    inline
+    ObjChunk
+    parseChunk(
+        char const * p,
+        char const * const end)
+    {
+        ObjChunk chunk{};
+
+        auto const counts = prescan(p, end);
+
+        chunk.verts.reserve(counts.verts);
+        chunk.norms.reserve(counts.norms);
+        chunk.uvs.reserve(counts.uvs);
+        chunk.faces.reserve(counts.faces);
+
+        Real vals[3] = {0.0, 0.0, 0.0};
+
+        while (p < end)
+        {
+            char const * next = end;
+            char const * const eol = lineEnd(p, end, &next);
+
+            auto const rec = readRecord(p, eol);
+
+            switch (rec)
             {
-                cout << "INVALID UV COORD" << endl;
-                continue;
+                case Record::Vertex:
+                    if (!parseReals(p, eol, vals, 3)) {
+                        chunk.errors.push_back("INVALID VERTEX");
+                        break;
+                    }
+
+                    chunk.verts.push_back(Vec3{vals[0], vals[1], vals[2]});
+                    break;
+
+                case Record::Normal:
+                    if (!parseReals(p, eol, vals, 3)) {
+                        chunk.errors.push_back("INVALID NORMAL");
+                        break;
+                    }
+
+                    chunk.norms.push_back(Vec3{vals[0], vals[1], vals[2]});
+                    break;
+
+                case Record::Uv:
+                    if (!parseReals(p, eol, vals, 2)) {
+                        chunk.errors.push_back("INVALID UV COORD");
+                        break;
+                    }
+
+                    chunk.uvs.push_back({vals[0], vals[1]});
+                    break;
+
+                case Record::Face:
+                {
+                    // The first reference number is the geometric vertex.
+                    // * The second reference number is the texture vertex. It follows the first slash.
+                    // * The third reference number is the vertex normal. It follows the second slash.
+                    MeshFaceIndex I;
+
+                    if (!parseFace(p, eol, I)) {
+                        chunk.errors.push_back("INVALID FACE");
+                        break;
+                    }
+
+                    if (hasRelative(I)) {
+                        chunk.relative.push_back({chunk.faces.size(),
+                            {chunk.verts.size(), chunk.norms.size(), chunk.uvs.size(), 0}});
+                    }
+
+                    chunk.faces.push_back(I);
+                    break;
+                }
+
+                case Record::UseMtl:
+                case Record::MtlLib:
+                {
+                    auto name = restOfLine(p, eol);
+
+                    if (name.size() == 0) {
+                        chunk.errors.push_back(rec == Record::UseMtl ? "INVALID MTL NAME" : "INVALID MTL LIB");
+                        break;
+                    }
+
+                    chunk.events.push_back({chunk.faces.size(), rec, std::move(name)});
+                    break;
+                }
+
+                // a group may be left unnamed
+                case Record::Object:
+                case Record::Group:
+                    chunk.events.push_back({chunk.faces.size(), rec, restOfLine(p, eol)});
+                    break;
+
+                default:
+                    break;
             }
 
-            mesh.uvs.push_back({
-                stod(m[1]),
-                stod(m[2])
-            });
+            p = next;
         }
-        else if (tok == "usemtl")
+
+        return chunk;
+    }
+
+    // split [p, end) into at most n pieces
+    // of similar size ending at line breaks
+    inline
+    std::vector<std::pair<char const *,char const *>>
+    splitLines(
+        char const * const p,
+        char const * const end,
+        size_t const n)
+    {
+        std::vector<std::pair<char const *,char const *>> out;
+
+        auto const len = static_cast<size_t>(end - p);
+
+        char const * first = p;
+
+        for (size_t i = 1; i <= n && first < end; i++)
         {
-            if (!regex_match(line, m, pat_usemtl))
+            char const * last = end;
+
+            if (i < n)
             {
-                cout << "INVALID MTL NAME" << endl;
-                continue;
+                last = p + len / n * i;
+
+                if (last < first) {
+                    last = first;
+                }
+
+                auto const * nl = static_cast<char const *>(
+                    std::memchr(last, '\n', static_cast<size_t>(end - last)));
+
+                last = nl != nullptr ? nl + 1 : end;
             }
 
-            mtlName = m[1];
+            out.push_back({first, last});
+
+            first = last;
         }
-        else if (tok == "f")
-        {
-            if (!regex_match(line, m, pat_f))
+
+        return out;
+    }
+
+} // namespace objParse
+
+struct ObjLoadOptions
+{
+    // most chunks parsed at once, 0 for one per hardware thread
+    unsigned threads = 0;
+
+    // files are not split into pieces smaller than this
+    size_t minChunkBytes = 4u << 20;
+
+    // how textures are decoded, mapped or streamed
+    TextureLoadOptions textures = {};
+};
+
+// load a triangulated OBJ file
+//
+// the file is memory mapped and tokenized in place,
+// numbers are converted straight from the mapped bytes
+// with no intermediate strings
+//
+// large files are split at line breaks and the pieces
+// parsed on the default thread pool, the pieces are then
+// stitched in file order so element numbering and the
+// material of every face come out as if read in one go
+//
+// the faces of each object or group become a part of the
+// mesh with the bounds of the vertexes they use
+inline
+Mesh
+loadWavefrontObjFile(
+    std::string const & filePath,
+    TextureMap & textures,
+    ObjLoadOptions const & opts = {})
+{
+    using namespace objParse;
+
+    using std::cout;
+    using std::endl;
+
+    using std::string;
+    using std::vector;
+    using std::future;
+
+    namespace fs = std::filesystem;
+
+    Mesh mesh;
+
+    auto fileDir = fs::path{filePath}.parent_path().string();
+
+    MappedFile file{filePath};
+
+    if (!file.isOpen()) {
+        cout << "loadMeshOBJ(): File not found " << filePath << endl;
+        return mesh;
+    }
+
+    file.adviseSequential();
+
+    char const * const begin = file.data();
+    char const * const end = begin + file.size();
+
+    auto & pool = defaultThreadPool();
+
+    size_t const maxThreads = opts.threads > 0 ? opts.threads : pool.size();
+    size_t const bySize = file.size() / std::max<size_t>(opts.minChunkBytes, 1);
+
+    auto const pieces = splitLines(begin, end, std::clamp<size_t>(bySize, 1, maxThreads));
+
+    // the pool runs jobs in order so the pieces go first
+    // and the texture decodes queue up behind them
+    vector<future<ObjChunk>> parsed;
+
+    if (pieces.size() > 1)
+    {
+        for (auto const & [ first, last ] : pieces) {
+            parsed.push_back(pool.submit([first = first, last = last]() { return parseChunk(first, last); }));
+        }
+    }
+
+    // the leading MTL files are read now so their textures
+    // decode while the geometry is parsed, the materials are
+    // kept and merged in as their mtllib records are replayed,
+    // textures of any found later start at that point
+    TextureLoads loads;
+
+    vector<std::pair<string,Mesh>> leading;
+
+    for (auto const & name : leadingMtlLibs(begin, end))
+    {
+        Mesh lib;
+
+        loadWavefrontMtlFile(lib, (fs::path{fileDir} /= name).string(), textures, &loads, opts.textures);
+
+        leading.push_back({name, std::move(lib)});
+    }
+
+    vector<ObjChunk> chunks(pieces.size());
+
+    if (pieces.size() == 1) {
+        chunks[0] = parseChunk(pieces[0].first, pieces[0].second);
+    } else {
+        for (size_t i = 0; i < parsed.size(); i++) {
+            chunks[i] = parsed[i].get();
+        }
+    }
+
+    // where each chunk's elements start in the mesh
+    vector<ObjCounts> base(chunks.size());
+    ObjCounts total{};
+
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        base[i] = total;
+
+        total.verts += chunks[i].verts.size();
+        total.norms += chunks[i].norms.size();
+        total.uvs += chunks[i].uvs.size();
+        total.faces += chunks[i].faces.size();
+    }
+
+    // replay the material records in file order, each run of
+    // faces gets a table entry for its material as it was at
+    // the time since a later mtllib may redefine it
+    vector<uint32_t> runMtls;
+
+    // table entry of each name until an mtllib is read
+    std::unordered_map<string,uint32_t> mtlIds;
+    vector<vector<std::pair<size_t,size_t>>> runs(chunks.size());
+
+    string mtlName = "no_mtl";
+    bool stale = true;
+
+    // leading mtllib records are the first ones replayed
+    size_t nextLeading = 0;
+
+    // every o and g record starts a new part, faces ahead
+    // of the first one go in an unnamed part
+    vector<MeshPart> parts(1);
+
+    auto const startPart = [&parts](size_t const face, string const & name) {
+        parts.back().faceCount = face - parts.back().firstFace;
+        parts.push_back(MeshPart{name, face});
+    };
+
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        for (auto const & msg : chunks[i].errors) {
+            cout << msg << endl;
+        }
+
+        size_t at = 0;
+
+        auto const addRun = [&](size_t const upTo) {
+            if (upTo > at)
             {
-                cout << "INVALID FACE" << endl;
+                if (stale) {
+                    auto [ id, added ] = mtlIds.try_emplace(mtlName, 0);
+
+                    if (added) {
+                        id->second = addFaceMtl(mesh, mesh.mtls[mtlName], mtlName);
+                    }
+
+                    runMtls.push_back(id->second);
+                    stale = false;
+                }
+
+                runs[i].push_back({at, runMtls.size() - 1});
+                at = upTo;
+            }
+        };
+
+        for (auto const & ev : chunks[i].events)
+        {
+            if (ev.rec == Record::Object || ev.rec == Record::Group) {
+                startPart(base[i].faces + ev.face, ev.name);
                 continue;
             }
 
-            // The first reference number is the geometric vertex.
-            // * The second reference number is the texture vertex. It follows the first slash.
-            // * The third reference number is the vertex normal. It follows the second slash.
+            addRun(ev.face);
 
-            MeshFace face{
-                mesh.mtls[mtlName],
-                {
-                    MeshIndex{
-                        stoll(m[1]),
-                        m[2] != "" ? stoll(m[2]) : 0,
-                        m[3] != "" ? stoll(m[3]) : 0
-                    },
-                    MeshIndex{
-                        stoll(m[4]),
-                        m[5] != "" ? stoll(m[5]) : 0,
-                        m[6] != "" ? stoll(m[6]) : 0
-                    },
-                    MeshIndex{
-                        stoll(m[7]),
-                        m[8] != "" ? stoll(m[8]) : 0,
-                        m[9] != "" ? stoll(m[9]) : 0
-                    }
+            if (ev.rec == Record::UseMtl) {
+                mtlName = ev.name;
+            } else if (nextLeading < leading.size() && leading[nextLeading].first == ev.name) {
+                for (auto const & [ name, mtl ] : leading[nextLeading].second.mtls) {
+                    mesh.mtls[name] = mtl;
                 }
-            };
 
-            mesh.faces.push_back(face);
+                mtlIds.clear();
+                nextLeading++;
+            } else {
+                string mtlLibPath = (fs::path{fileDir} /= ev.name).string();
+
+                loadWavefrontMtlFile(mesh, mtlLibPath, textures, &loads, opts.textures);
+
+                mtlIds.clear();
+            }
+
+            stale = true;
+        }
+
+        addRun(chunks[i].faces.size());
+    }
+
+    startPart(total.faces, "");
+    parts.pop_back();
+
+    for (auto & part : parts)
+    {
+        if (part.faceCount > 0) {
+            mesh.parts.push_back(std::move(part));
         }
     }
 
+    mesh.verts.resize(total.verts);
+    mesh.norms.resize(total.norms);
+    mesh.uvs.resize(total.uvs);
+    mesh.faces.resize(total.faces);
+
+    auto const fill = [&](size_t const i) {
+        auto & chunk = chunks[i];
+        auto const & at = base[i];
+
+        for (auto const & rel : chunk.relative)
+        {
+            resolveRelative(chunk.faces[rel.face],
+                at.verts + rel.seen.verts,
+                at.uvs + rel.seen.uvs,
+                at.norms + rel.seen.norms);
+        }
+
+        std::copy(chunk.verts.begin(), chunk.verts.end(), mesh.verts.begin() + static_cast<long>(at.verts));
+        std::copy(chunk.norms.begin(), chunk.norms.end(), mesh.norms.begin() + static_cast<long>(at.norms));
+        std::copy(chunk.uvs.begin(), chunk.uvs.end(), mesh.uvs.begin() + static_cast<long>(at.uvs));
+
+        auto const & chunkRuns = runs[i];
+
+        for (size_t r = 0; r < chunkRuns.size(); r++)
+        {
+            auto const first = chunkRuns[r].first;
+            auto const last = r + 1 < chunkRuns.size() ? chunkRuns[r + 1].first : chunk.faces.size();
+
+            auto const mtlId = runMtls[chunkRuns[r].second];
+
+            for (size_t f = first; f < last; f++) {
+                mesh.faces[at.faces + f] = MeshFace{mtlId, chunk.faces[f]};
+            }
+        }
+
+        chunk = ObjChunk{};
+    };
+
+    if (chunks.size() == 1) {
+        fill(0);
+    } else {
+        vector<future<void>> filled;
+
+        for (size_t i = 0; i < chunks.size(); i++) {
+            filled.push_back(pool.submit([&fill, i]() { fill(i); }));
+        }
+
+        for (auto & f : filled) {
+            f.get();
+        }
+    }
+
+    // once every chunk is in place since faces may use
+    // vertexes from any of them
+    for (auto & part : mesh.parts) {
+        part.bounds = faceBounds(mesh.faces, part.firstFace, part.faceCount, mesh.verts, mesh.verts.size());
+    }
+
+    resolveTextures(textures, loads);
+
     return mesh;
 }
 
+namespace objWrite {
+
+    inline
+    void
+    appendIndex(
+        std::string & out,
+        MeshIndex const & I)
+    {
+        char buf[24];
+        char * const end = buf + sizeof(buf);
+
+        out.append(buf, std::to_chars(buf, end, I.id).ptr);
+        out += '/';
+
+        if (I.uvId != 0) {
+            out.append(buf, std::to_chars(buf, end, I.uvId).ptr);
+        }
+
+        out += '/';
+
+        if (I.normId != 0) {
+            out.append(buf, std::to_chars(buf, end, I.normId).ptr);
+        }
+    }
+
+} // namespace objWrite
+
+// write a mesh as OBJ text, materials other than the
+// default go to an MTL file of the same name next to it
+//
+// text is gathered in a buffer and written out in large
+// blocks since generated meshes can be very large
+inline
+void
+saveWavefrontObjFile(
+    std::string const & filePath,
+    Mesh const & mesh)
+{
+    using namespace objWrite;
+
+    using std::string;
+    using std::ofstream;
+
+    namespace fs = std::filesystem;
+
+    constexpr size_t kFlushSize = 1 << 20;
+
+    ofstream fh{filePath, std::ios::binary};
+
+    string out = "";
+    out.reserve(kFlushSize + 256);
+
+    auto const flush = [&fh, &out](size_t const atLeast) {
+        if (out.size() >= atLeast) {
+            fh.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    };
+
+    bool const hasMtls = mesh.mtls.size() > (mesh.mtls.count("no_mtl") != 0 ? 1u : 0u);
+
+    if (hasMtls)
+    {
+        auto const mtlPath = fs::path{filePath}.replace_extension(".mtl");
+
+        saveWavefrontMtlFile(mtlPath.string(), mesh);
+
+        out += "mtllib " + mtlPath.filename().string() + "\n";
+    }
+
+    for (auto const & v : mesh.verts)
+    {
+        out += "v ";
+        appendReal(out, v.x); out += ' ';
+        appendReal(out, v.y); out += ' ';
+        appendReal(out, v.z); out += '\n';
+
+        flush(kFlushSize);
+    }
+
+    for (auto const & [ u, v ] : mesh.uvs)
+    {
+        out += "vt ";
+        appendReal(out, u); out += ' ';
+        appendReal(out, v); out += '\n';
+
+        flush(kFlushSize);
+    }
+
+    for (auto const & n : mesh.norms)
+    {
+        out += "vn ";
+        appendReal(out, n.x); out += ' ';
+        appendReal(out, n.y); out += ' ';
+        appendReal(out, n.z); out += '\n';
+
+        flush(kFlushSize);
+    }
+
+    // faces hold an index into the material table, its name
+    // is looked up again only when the index changes
+    uint32_t lastMtl = UINT32_MAX;
+    string lastName = "";
+
+    // each part is written as a group
+    size_t part = 0;
+
+    for (size_t f = 0; f < mesh.faces.size(); f++)
+    {
+        auto const & face = mesh.faces[f];
+
+        for (; part < mesh.parts.size() && mesh.parts[part].firstFace <= f; part++)
+        {
+            auto const & name = mesh.parts[part].name;
+
+            out += name != "" ? "g " + name + "\n" : "g\n";
+        }
+
+        if (face.mtlId != lastMtl)
+        {
+            lastMtl = face.mtlId;
+
+            string const name = lastMtl < mesh.mtlNames.size() ? mesh.mtlNames[lastMtl] : "";
+
+            if (name != "" && name != lastName)
+            {
+                lastName = name;
+
+                out += "usemtl " + lastName + "\n";
+            }
+        }
+
+        auto const & I = face.vertexIndexes;
+
+        out += "f ";
+        appendIndex(out, I[0]); out += ' ';
+        appendIndex(out, I[1]); out += ' ';
+        appendIndex(out, I[2]); out += '\n';
+
+        flush(kFlushSize);
+    }
+
+    flush(0);
+}
+
 } // namespace CxxRay
 
 #endif
@@ -3,13 +3,21 @@
 
 #include "raster/vertex_shader.h"
 #include "raster/fragment_shader.h"
+#include "raster/raster_options.h"
+#include "raster/view_frustum.h"
 #include "image/draw_lines.h"
 #include "world/mesh.h"
+#include "world/mesh_view.h"
+#include "world/indexed_mesh.h"
+#include "world/quantized_mesh.h"
 #include "world/light.h"
 #include "world/camera.h"
 #include "world/view_volume.h"
 #include "image/depth_buf_image.h"
 #include "utils/profiler.h"
+#include "utils/perf_counters.h"
+#include "utils/stats.h"
+#include "utils/mem_stats.h"
 #include "linalg/linalg.h"
 
 #include <iostream>
@@ -52,15 +60,283 @@ getViewTransforms(
     };
 }
 
+// calls shade(firstFace, faceCount) for each part not
+// entirely off screen, or once for every face when there
+// are no parts or no frustum, returns the faces skipped
+template<typename Shade>
+size_t
+shadeVisibleParts(
+    std::vector<MeshPart> const & parts,
+    size_t const faceCount,
+    ViewFrustum const * frustum,
+    Shade const & shade)
+{
+    if (parts.empty() || frustum == nullptr) {
+        shade(size_t{0}, faceCount);
+        return 0;
+    }
+
+    size_t culled = 0;
+
+    for (auto const & part : parts)
+    {
+        if (frustum->outside(part.bounds)) {
+            culled += part.faceCount;
+        } else {
+            shade(part.firstFace, part.faceCount);
+        }
+    }
+
+    return culled;
+}
+
+// run the vertex shader on every corner of every face,
+// returns the faces of parts culled by the frustum
+inline
+size_t
+appendShadedFaces(
+    ScratchVector<ShadedFace> & out,
+    Mesh const & mesh,
+    Mat4 const & M,
+    Mat4 const & M_cam,
+    std::vector<Light> const & lights,
+    ViewFrustum const * frustum = nullptr)
+{
+    auto const & verts = mesh.verts;
+    auto const & norms = mesh.norms;
+    auto const & uvs = mesh.uvs;
+
+    // a face without a uv or normal (numbered 0) shades
+    // with default values, as welding gives it
+    auto const shadeCorner = [&](MeshIndex const & I) {
+        return vertexShaderProgram(M, M_cam, lights, verts[I.id - 1],
+            weld::fetch(norms, norms.size(), I.normId, Vec3{}),
+            weld::fetch(uvs, uvs.size(), I.uvId, std::tuple<Real,Real>{0.0, 0.0}));
+    };
+
+    // there may be many materials, but for now
+    // we'll only ever use the first one.
+    //
+    // the textures are stored in a hash which
+    // gives a pair where the second item in
+    // the pair is the actual material object
+    return shadeVisibleParts(mesh.parts, mesh.faces.size(), frustum, [&](size_t const first, size_t const count) {
+        for (size_t f = first; f < first + count; f++)
+        {
+            auto const & I = mesh.faces[f].vertexIndexes;
+
+            out.push_back({
+                mesh.faceMtl(f),
+                ShadedTriangle{ shadeCorner(I[0]), shadeCorner(I[1]), shadeCorner(I[2]) },
+            });
+        }
+    });
+}
+
+// same for a mesh mapped from the mesh cache
+inline
+size_t
+appendShadedFaces(
+    ScratchVector<ShadedFace> & out,
+    MeshView const & mesh,
+    Mat4 const & M,
+    Mat4 const & M_cam,
+    std::vector<Light> const & lights,
+    ViewFrustum const * frustum = nullptr)
+{
+    auto const * const verts = mesh.verts;
+    auto const * const norms = mesh.norms;
+
+    auto const shadeCorner = [&](MeshIndex const & I) {
+        auto const uv = I.uvId >= 1 && static_cast<size_t>(I.uvId) <= mesh.uvCount
+            ? mesh.uv(static_cast<size_t>(I.uvId - 1))
+            : std::tuple<Real,Real>{0.0, 0.0};
+
+        return vertexShaderProgram(M, M_cam, lights, verts[I.id - 1],
+            weld::fetch(norms, mesh.normCount, I.normId, Vec3{}), uv);
+    };
+
+    return shadeVisibleParts(mesh.parts, mesh.faceCount, frustum, [&](size_t const first, size_t const count) {
+        for (size_t i = first; i < first + count; i++)
+        {
+            auto const & I = mesh.faces[i];
+
+            out.push_back({
+                mesh.faceMtl(i),
+                ShadedTriangle{ shadeCorner(I[0]), shadeCorner(I[1]), shadeCorner(I[2]) },
+            });
+        }
+    });
+}
+
+// welded meshes shade every unique vertex once and
+// then gather the three results for each triangle
+//
+// with parts culled only the vertexes of the rest are
+// shaded, shadeVertex takes a vertex of the mesh
+//
+// meshlets, when built, are culled in place of parts
+// and their vertexes shaded as first reached
+template<typename WeldedMesh, typename ShadeVertex>
+size_t
+appendWeldedFaces(
+    ScratchVector<ShadedFace> & out,
+    WeldedMesh const & mesh,
+    ViewFrustum const * frustum,
+    ShadeVertex const & shadeVertex)
+{
+    std::vector<MeshPart const *> visible;
+
+    size_t culled = 0;
+
+    ScratchVector<ShadedVertex> shaded;
+
+    auto const emit = [&](size_t const first, size_t const count) {
+        auto const * I = mesh.indices.data() + 3 * first;
+
+        for (size_t i = first; i < first + count; i++, I += 3)
+        {
+            out.push_back({
+                mesh.faceMtl(i),
+                ShadedTriangle{
+                    shaded[I[0]],
+                    shaded[I[1]],
+                    shaded[I[2]]
+                },
+            });
+        }
+    };
+
+    if (frustum != nullptr && !mesh.meshlets.empty())
+    {
+        shaded.resize(mesh.vertices.size());
+
+        std::vector<bool> done(mesh.vertices.size(), false);
+
+        for (auto const & m : mesh.meshlets)
+        {
+            if (frustum->outside(m.bounds) || frustum->facesAway(m)) {
+                culled += m.faceCount;
+                continue;
+            }
+
+            auto const * const first = mesh.indices.data() + 3 * m.firstFace;
+
+            for (auto const * I = first; I != first + 3 * m.faceCount; I++)
+            {
+                if (!done[*I])
+                {
+                    shaded[*I] = shadeVertex(mesh.vertices[*I]);
+                    done[*I] = true;
+                }
+            }
+
+            emit(m.firstFace, m.faceCount);
+        }
+
+        return culled;
+    }
+
+    if (frustum != nullptr)
+    {
+        for (auto const & part : mesh.parts)
+        {
+            if (frustum->outside(part.bounds)) {
+                culled += part.faceCount;
+            } else {
+                visible.push_back(&part);
+            }
+        }
+    }
+
+    if (culled == 0)
+    {
+        shaded.reserve(mesh.vertices.size());
+
+        for (auto const & vtx : mesh.vertices) {
+            shaded.push_back(shadeVertex(vtx));
+        }
+
+        emit(0, mesh.faceCount());
+
+        return 0;
+    }
+
+    shaded.resize(mesh.vertices.size());
+
+    // parts may share vertexes, overlapping ranges are
+    // merged so each is shaded once
+    std::vector<std::pair<uint32_t,uint32_t>> ranges;
+
+    for (auto const * part : visible) {
+        ranges.push_back({part->firstVertex, part->firstVertex + part->vertexCount});
+    }
+
+    std::sort(ranges.begin(), ranges.end());
+
+    uint32_t done = 0;
+
+    for (auto const & [ first, last ] : ranges)
+    {
+        for (auto v = std::max(first, done); v < last; v++) {
+            shaded[v] = shadeVertex(mesh.vertices[v]);
+        }
+
+        done = std::max(done, last);
+    }
+
+    for (auto const * part : visible) {
+        emit(part->firstFace, part->faceCount);
+    }
+
+    return culled;
+}
+
+inline
+size_t
+appendShadedFaces(
+    ScratchVector<ShadedFace> & out,
+    IndexedMesh const & mesh,
+    Mat4 const & M,
+    Mat4 const & M_cam,
+    std::vector<Light> const & lights,
+    ViewFrustum const * frustum = nullptr)
+{
+    return appendWeldedFaces(out, mesh, frustum, [&](MeshVertex const & vtx) {
+        return vertexShaderProgram(M, M_cam, lights, vtx.pos, vtx.norm, {vtx.u, vtx.v});
+    });
+}
+
+// quantized meshes are decoded one vertex at a time
+// right before the vertex shader
 inline
+size_t
+appendShadedFaces(
+    ScratchVector<ShadedFace> & out,
+    QuantizedMesh const & mesh,
+    Mat4 const & M,
+    Mat4 const & M_cam,
+    std::vector<Light> const & lights,
+    ViewFrustum const * frustum = nullptr)
+{
+    return appendWeldedFaces(out, mesh, frustum, [&](QuantizedVertex const & q) {
+        auto const vtx = decodeVertex(mesh, q);
+
+        return vertexShaderProgram(M, M_cam, lights, vtx.pos, vtx.norm, {vtx.u, vtx.v});
+    });
+}
+
+// MeshT is Mesh, MeshView, IndexedMesh or QuantizedMesh
+template<typename MeshT>
 int
 drawColorScene(
     DepthBufImage & img,
     std::vector<Light> const & lights,
-    std::vector<Mesh> const & meshes,
-    std::unordered_map<std::string,TextureImage> & textures,
+    std::vector<MeshT> const & meshes,
+    TextureMap const & textures,
     Mat4 const & M,
-    Mat4 const & M_cam)
+    Mat4 const & M_cam,
+    RasterOptions const & opts = {})
 {
     using std::cout;
     using std::endl;
@@ -71,58 +347,93 @@ drawColorScene(
     Profiler timer;
     auto time = timer.stop();
 
+    auto * const stats = opts.stats;
+
+    // hardware counters for each zone timed below
+    PerfCounters counters;
+
+    if (kPerfCountersEnabled && !counters.available()) {
+        cout << "hardware counters unavailable" << endl;
+    }
+
+    auto const pixels = static_cast<double>(img.size);
+
+    auto const reportCounts = [&stats, &counters, pixels](std::string const & zone) {
+        auto const counts = counters.stop();
+
+        if (counts.hasIpc()) {
+            std::cout << zone << " ipc: " << counts.ipc() << std::endl;
+        }
+
+        recordPerfCounts(stats, zone, counts, pixels);
+    };
+
     ////////////////////////////////////////////////////////////
     // Drawing
     ////////////////////////////////////////////////////////////
     cout << "shading vertexes..." << endl;
 
-    vector<ShadedFace> shadedFaces;
+    ScratchVector<ShadedFace> shadedFaces;
+
+    auto frustum = makeViewFrustum(M, img.w, img.h);
+    frustum.cullBackFaces = opts.cullBackFaces;
+
+    size_t culled = 0;
 
     timer.start();
+    counters.start();
     for (auto const & mesh : meshes)
     {
-        auto const & verts = mesh.verts;
-        auto const & norms = mesh.norms;
-        auto const & uvs = mesh.uvs;
-
-        // there may be many materials, but for now
-        // we'll only ever use the first one.
-        //
-        // the textures are stored in a hash which
-        // gives a pair where the second item in
-        // the pair is the actual material object
-        for (auto const & face : mesh.faces)
-        {
-            auto const & I = face.vertexIndexes;
-
-            shadedFaces.push_back({
-                face.mtl,
-                ShadedTriangle{
-                    vertexShaderProgram(M, M_cam, lights, verts[I[0].id - 1], norms[I[0].normId - 1], uvs[I[0].uvId - 1]),
-                    vertexShaderProgram(M, M_cam, lights, verts[I[1].id - 1], norms[I[1].normId - 1], uvs[I[1].uvId - 1]),
-                    vertexShaderProgram(M, M_cam, lights, verts[I[2].id - 1], norms[I[2].normId - 1], uvs[I[2].uvId - 1])
-                },
-            });
-        }
+        culled += appendShadedFaces(shadedFaces, mesh, M, M_cam, lights, opts.cullParts ? &frustum : nullptr);
     }
 
     time = timer.stop();
 
     cout << "vertex shader time: " << time << endl;
 
+    record(stats, "vertex_shader_ms", time);
+
+    if (opts.cullParts)
+    {
+        cout << "culled faces: " << culled << endl;
+
+        record(stats, "faces_culled", static_cast<double>(culled));
+    }
+
+    reportCounts("vertex_shader");
+
     cout << "shading fragments..." << endl;
 
+    size_t backFaces = 0;
+
     timer.start();
+    counters.start();
 
     for (auto const & face : shadedFaces)
     {
-        fragementShaderProgram(img, face, textures);
+        if (opts.cullBackFaces && frustum.backFacing(face.triangle)) {
+            backFaces++;
+            continue;
+        }
+
+        fragementShaderProgram(img, face, textures, opts.heatmap, opts.textureFilter);
     }
 
     time = timer.stop();
 
     cout << "fragment shader time: " << time << endl;
 
+    record(stats, "fragment_shader_ms", time);
+
+    if (opts.cullBackFaces)
+    {
+        cout << "back faces skipped: " << backFaces << endl;
+
+        record(stats, "back_faces", static_cast<double>(backFaces));
+    }
+
+    reportCounts("fragment_shader");
+
     // the fragment shader needs
     // vertex material info (color, texture)
     // vertex position info
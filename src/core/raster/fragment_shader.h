@@ -5,7 +5,9 @@
 
 #include "world/mesh.h"
 #include "image/depth_buf_image.h"
+#include "image/cost_heatmap.h"
 #include "image/pixel.h"
+#include "raster/texture_sampler.h"
 #include "rgb/rgb.h"
 
 #include "global/global.h"
@@ -14,6 +16,7 @@
 #include <string>
 #include <vector>
 #include <tuple>
+#include <utility>
 #include <algorithm>
 #include <functional>
 #include <cmath>
@@ -97,14 +100,19 @@ void
 fragementShaderProgram(
     DepthBufImage & img,
     ShadedFace const & face,
-    std::unordered_map<std::string,TextureImage> & textures)
+    TextureMap const & textures,
+    CostHeatmap * heatmap = nullptr,
+    TextureFilter const filter = TextureFilter::Nearest)
 {
     auto const & mtl = face.mtl;
 
     auto const & texName = mtl.texName;
 
-    bool const hasTex = texName != "" && textures.count(texName) != 0;
-    auto const & tex = textures[mtl.texName];
+    auto const found = texName != "" ? textures.find(texName) : textures.end();
+
+    TextureImage const * const tex = found != textures.end() ? found->second.get() : nullptr;
+
+    bool const hasTex = tex != nullptr;
 
     auto const & tri = face.triangle;
 
@@ -176,6 +184,53 @@ fragementShaderProgram(
     Real const edge20 = fp1 * static_cast<Real>(A20*offx + B20*offy + C20);
     Real const edge01 = fp2 * static_cast<Real>(A01*offx + B01*offy + C01);
 
+    if (heatmap != nullptr) {
+        heatmap->addTriangle(xmin, xmax, ymin, ymax);
+    }
+
+    ////////////////////////////////////////////////
+    // Texturing
+    ////////////////////////////////////////////////
+    //
+    // In its simplest form the relative position of
+    // the appropriate color from the texture is
+    // given by finding barycentric versions of
+    // the uv coordinates and interpolating
+    // across the vertices as would be done with
+    // color
+    //
+    // u(β,γ) = u_a + β(u_a - u_c) + γ(u_b - u_a)
+    // v(β,γ) = v_a + β(v_a - v_c) + γ(v_b - v_a)
+    //
+    // However this will not work properly with
+    // respect to the perspective transform, so
+    // we want to find the barycentric coordinates
+    // relative to the world before the perspective
+    // transform
+    //
+    // pixels outside the triangle extrapolate, which
+    // is what the derivatives below need
+    auto const texCoordAt = [&](PixVal const px, PixVal const py) {
+        Real const beta  = static_cast<Real>(A20*px + B20*py + C20) / fp1;
+        Real const gamma = static_cast<Real>(A01*px + B01*py + C01) / fp2;
+
+        auto const bary_d = bHom*cHom + cHom*beta*(aHom - bHom) + bHom*gamma*(aHom - cHom);
+        auto const beta_w = (aHom*cHom*beta)/bary_d;
+        auto const gamma_w = (aHom*bHom*gamma)/bary_d;
+        auto const alpha_w = 1 - beta_w - gamma_w;
+
+        return std::pair<Real,Real>{
+            alpha_w*aTexU + beta_w*bTexU + gamma_w*cTexU,
+            alpha_w*aTexV + beta_w*bTexV + gamma_w*cTexV,
+        };
+    };
+
+    // like a GPU, the mip level is chosen once per 2x2 quad
+    // of pixels from the differences of uv across the quad
+    PixVal quadX = -1;
+    PixVal quadY = -1;
+    Real quadLod = 0;
+
     for (PixVal y = ymin; y < ymax; y++)
     {
         for (PixVal x = xmin; x < xmax; x++)
@@ -224,12 +279,20 @@ fragementShaderProgram(
 
                     auto const curz = img.zval(x, y);
 
+                    if (heatmap != nullptr) {
+                        heatmap->addDepthTest(x, y);
+                    }
+
                     if (zdist <= curz) {
                         continue;
                     }
 
                     img.zval(x, y, zdist);
 
+                    if (heatmap != nullptr) {
+                        heatmap->addShade(x, y);
+                    }
+
                     // if there is no UV texture map
                     // we'll just use the diffuse color
                     // (or surface color) from the MTL
@@ -238,46 +301,33 @@ fragementShaderProgram(
 
                     if (hasTex)
                     {
-                        ////////////////////////////////////////////////
-                        // Texturing
-                        ////////////////////////////////////////////////
-                        //
-                        // In its simplest form the relative position of
-                        // the appropriate color from the texture is
-                        // given by finding barycentric versions of
-                        // the uv coordinates and interpolating
-                        // across the vertices as would be done with
-                        // color
-                        //
-                        // u(β,γ) = u_a + β(u_a - u_c) + γ(u_b - u_a)
-                        // v(β,γ) = v_a + β(v_a - v_c) + γ(v_b - v_a)
-                        //
-                        // However this will not work properly with
-                        // respect to the perspective transform, so
-                        // we want to find the barycentric coordinates
-                        // relative to the world before the perspective
-                        // transform
-
-                        auto const bary_d = bHom*cHom + cHom*beta*(aHom - bHom) + bHom*gamma*(aHom - cHom);
-                        auto const beta_w = (aHom*cHom*beta)/bary_d;
-                        auto const gamma_w = (aHom*bHom*gamma)/bary_d;
-                        auto const alpha_w = 1 - beta_w - gamma_w;
-                        auto const u0 = alpha_w*aTexU + beta_w*bTexU + gamma_w*cTexU;
-                        auto const v0 = alpha_w*aTexV + beta_w*bTexV + gamma_w*cTexV;
+                        auto const [ u0, v0 ] = texCoordAt(x, y);
 
                         Real const u = std::clamp(u0, 0.0, 1.0);
                         Real const v = std::clamp(v0, 0.0, 1.0);
 
-                        // we multiply u by the texture width
-                        // and v by the texture height to arrive at
-                        // the pixel color from the texture which
-                        // corresponds to this pixel of the triangle
-                        auto const xTex = static_cast<long>(u * static_cast<Real>(tex.w));
-                        auto const yTex = static_cast<long>(v * static_cast<Real>(tex.h));
-
-                        auto const idxTex = (yTex * tex.w) + xTex;
-
-                        kd = toRgbReal(tex.pixels[idxTex]);
+                        if (filter == TextureFilter::Nearest)
+                        {
+                            kd = sampleNearest(*tex, u, v);
+                        }
+                        else
+                        {
+                            PixVal const qx = x & ~1l;
+                            PixVal const qy = y & ~1l;
+
+                            if (qx != quadX || qy != quadY)
+                            {
+                                auto const [ uq, vq ] = texCoordAt(qx, qy);
+                                auto const [ ur, vr ] = texCoordAt(qx + 1, qy);
+                                auto const [ uu, vu ] = texCoordAt(qx, qy + 1);
+
+                                quadLod = textureLod(*tex, ur - uq, vr - vq, uu - uq, vu - vq);
+                                quadX = qx;
+                                quadY = qy;
+                            }
+
+                            kd = sampleTexture(*tex, u, v, quadLod, filter);
+                        }
                     }
 
                     // for nice looking (non-washed out) results, the
@@ -0,0 +1,34 @@
+#ifndef CXXRAY_RASTER_OPTIONS_H
+#define CXXRAY_RASTER_OPTIONS_H
+
+#include "image/cost_heatmap.h"
+#include "raster/texture_sampler.h"
+#include "utils/stats.h"
+
+namespace CxxRay {
+
+// optional instrumentation and settings for
+// drawColorScene, anything left null is not collected
+struct RasterOptions
+{
+    Stats * stats = nullptr;
+    CostHeatmap * heatmap = nullptr;
+
+    // nearest keeps the full size texture only, the others
+    // read the mip chain built when textures are loaded
+    TextureFilter textureFilter = TextureFilter::Nearest;
+
+    // skip mesh parts and meshlets entirely off screen
+    // before shading their vertexes, what is drawn stays
+    // the same
+    bool cullParts = true;
+
+    // leave out faces seen from behind, only right for
+    // closed meshes, meshlets facing away are then skipped
+    // before shading as well
+    bool cullBackFaces = false;
+};
+
+} // namespace CxxRay
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef CXXRAY_TEXTURE_SAMPLER_H
+#define CXXRAY_TEXTURE_SAMPLER_H
+
+#include "image/texture_image.h"
+#include "rgb/rgb.h"
+
+#include "global/global.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace CxxRay {
+
+// how texels are read for a pixel
+//
+// Nearest:   the closest texel of the full size texture
+// Bilinear:  blend of the 4 closest texels in the mip level
+//            nearest the pixel's footprint
+// Trilinear: bilinear in the two levels around the
+//            footprint, blended by how far between them it is
+enum class TextureFilter
+{
+    Nearest,
+    Bilinear,
+    Trilinear,
+};
+
+// mip level for a pixel whose uv changes by (dudx, dvdx)
+// one pixel to the right and (dudy, dvdy) one pixel up,
+// the log2 of how many texels the longer side of its
+// footprint covers, negative when the texture is magnified
+inline
+Real
+textureLod(
+    TextureImage const & tex,
+    Real const dudx,
+    Real const dvdx,
+    Real const dudy,
+    Real const dvdy)
+{
+    auto const w = static_cast<Real>(tex.w);
+    auto const h = static_cast<Real>(tex.h);
+
+    auto const lenX = (dudx * w) * (dudx * w) + (dvdx * h) * (dvdx * h);
+    auto const lenY = (dudy * w) * (dudy * w) + (dvdy * h) * (dvdy * h);
+
+    auto const rho = std::max(lenX, lenY);
+
+    // half the log of the squared length
+    return rho > 0 ? 0.5 * std::log2(rho) : 0.0;
+}
+
+// u and v are in [0, 1]
+inline
+RgbReal
+sampleNearest(
+    TextureImage const & tex,
+    Real const u,
+    Real const v)
+{
+    auto const x = std::min(static_cast<long>(u * static_cast<Real>(tex.w)), tex.w - 1);
+    auto const y = std::min(static_cast<long>(v * static_cast<Real>(tex.h)), tex.h - 1);
+
+    return toRgbReal(tex.texel(x, y));
+}
+
+// texel centers sit at half texel offsets, edges clamp
+inline
+RgbReal
+sampleBilinear(
+    TextureImage const & tex,
+    long const level,
+    Real const u,
+    Real const v)
+{
+    auto const lw = tex.levelW(level);
+    auto const lh = tex.levelH(level);
+
+    auto const s = u * static_cast<Real>(lw) - 0.5;
+    auto const t = v * static_cast<Real>(lh) - 0.5;
+
+    auto const sf = std::floor(s);
+    auto const tf = std::floor(t);
+
+    auto const fx = s - sf;
+    auto const fy = t - tf;
+
+    auto const x0 = std::clamp(static_cast<long>(sf), 0l, lw - 1);
+    auto const y0 = std::clamp(static_cast<long>(tf), 0l, lh - 1);
+    auto const x1 = std::clamp(static_cast<long>(sf) + 1, 0l, lw - 1);
+    auto const y1 = std::clamp(static_cast<long>(tf) + 1, 0l, lh - 1);
+
+    auto const a = tex.levelTexel(level, x0, y0);
+    auto const b = tex.levelTexel(level, x1, y0);
+    auto const c = tex.levelTexel(level, x0, y1);
+    auto const d = tex.levelTexel(level, x1, y1);
+
+    auto const mix = [fx, fy](ByteT const c00, ByteT const c10, ByteT const c01, ByteT const c11) {
+        auto const bottom = static_cast<Real>(c00) + fx * (static_cast<Real>(c10) - static_cast<Real>(c00));
+        auto const top = static_cast<Real>(c01) + fx * (static_cast<Real>(c11) - static_cast<Real>(c01));
+
+        return (bottom + fy * (top - bottom)) / 255;
+    };
+
+    return RgbReal{
+        mix(a.r, b.r, c.r, d.r),
+        mix(a.g, b.g, c.g, d.g),
+        mix(a.b, b.b, c.b, d.b),
+    };
+}
+
+// sample at (u, v) in [0, 1] for a footprint at mip level
+// lod (see textureLod)
+inline
+RgbReal
+sampleTexture(
+    TextureImage const & tex,
+    Real const u,
+    Real const v,
+    Real const lod,
+    TextureFilter const filter)
+{
+    auto const last = static_cast<Real>(tex.levels() - 1);
+
+    auto const level = std::clamp(lod, 0.0, last);
+
+    if (filter == TextureFilter::Nearest) {
+        return sampleNearest(tex, u, v);
+    }
+
+    if (filter == TextureFilter::Bilinear) {
+        return sampleBilinear(tex, static_cast<long>(std::lround(level)), u, v);
+    }
+
+    auto const lo = std::floor(level);
+    auto const f = level - lo;
+
+    auto const a = sampleBilinear(tex, static_cast<long>(lo), u, v);
+
+    if (f <= 0) {
+        return a;
+    }
+
+    auto const b = sampleBilinear(tex, static_cast<long>(lo) + 1, u, v);
+
+    return RgbReal{
+        a.r + f * (b.r - a.r),
+        a.g + f * (b.g - a.g),
+        a.b + f * (b.b - a.b),
+    };
+}
+
+} // namespace CxxRay
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef CXXRAY_VIEW_FRUSTUM_H
+#define CXXRAY_VIEW_FRUSTUM_H
+
+#include "world/bounds.h"
+#include "world/mesh.h"
+#include "linalg/linalg.h"
+
+#include "global/global.h"
+
+#include <array>
+#include <cmath>
+
+namespace CxxRay {
+
+// the edges of the image as planes in world space, taken
+// from the full transform so bounds can be tested before
+// any of their vertexes are shaded
+//
+// triangles are not clipped against the near and far
+// planes when drawn, so only the sides are tested
+struct ViewFrustum
+{
+    // a point is inside side i when sides[i] and eye have
+    // the same sign at it, xyz are unit length
+    std::array<Vec4,4> sides = {};
+
+    // signed distance from the camera's plane
+    Vec4 eye = {};
+
+    // camera position in world space
+    Vec3 eyePos = {};
+
+    // sign of the determinant of the transform's x, y and h
+    // rows, relates a triangle's winding on screen to its
+    // winding in world space
+    Real winding = 1.0;
+
+    // faces seen from behind are not drawn, so meshlets
+    // facing away can be skipped too
+    bool cullBackFaces = false;
+
+    // true when no pixel of anything inside b can be drawn
+    //
+    // points behind the camera project mirrored, so the
+    // sign of the distance from the camera's plane picks
+    // the side, bounds across that plane are always kept
+    bool outside(
+        Bounds const & b) const
+    {
+        if (b.empty()) {
+            return true;
+        }
+
+        auto const w = eye.x * b.center.x + eye.y * b.center.y + eye.z * b.center.z + eye.h;
+
+        if (std::abs(w) <= b.radius) {
+            return false;
+        }
+
+        auto const s = w > 0 ? 1.0 : -1.0;
+
+        for (auto const & p : sides)
+        {
+            auto const d = p.x * b.center.x + p.y * b.center.y + p.z * b.center.z + p.h;
+
+            if (s * d < -b.radius) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // true when the camera sees the back of a transformed
+    // triangle, the test is on the x, y and h coordinates
+    // before the divide so it holds behind the camera too
+    bool backFacing(
+        ShadedTriangle const & t) const
+    {
+        auto const & a = t[0].coord;
+        auto const & b = t[1].coord;
+        auto const & c = t[2].coord;
+
+        auto const det = a.x * (b.y * c.h - b.h * c.y)
+            - a.y * (b.x * c.h - b.h * c.x)
+            + a.h * (b.x * c.y - b.y * c.x);
+
+        return winding * det > 0;
+    }
+
+    // true when the camera sees the back of every face of
+    // the meshlet, from anywhere in its bounding sphere
+    bool facesAway(
+        Meshlet const & m) const
+    {
+        if (!cullBackFaces || m.cone.cutoff >= 1 || m.bounds.empty()) {
+            return false;
+        }
+
+        auto const d = m.bounds.center - eyePos;
+
+        return dot(d, m.cone.axis) >= m.cone.cutoff * length(d) + m.bounds.radius;
+    }
+};
+
+namespace viewFrustum {
+
+    inline
+    Vec4
+    plane(
+        Real const x,
+        Real const y,
+        Real const z,
+        Real const h)
+    {
+        auto const len = std::sqrt(x * x + y * y + z * z);
+
+        // a degenerate side never culls
+        if (len <= 0) {
+            return Vec4{0.0, 0.0, 0.0, 1.0};
+        }
+
+        return Vec4{x / len, y / len, z / len, h / len};
+    }
+}
+
+// M takes world points to pixels before the divide by h,
+// sides are a pixel past the image since pixel positions
+// are truncated
+inline
+ViewFrustum
+makeViewFrustum(
+    Mat4 const & M,
+    long const w,
+    long const h)
+{
+    using viewFrustum::plane;
+
+    auto const X = M.a();
+    auto const Y = M.b();
+    auto const W = M.d();
+
+    auto const right = static_cast<Real>(w + 1);
+    auto const top = static_cast<Real>(h + 1);
+
+    ViewFrustum f;
+
+    // x >= -1, x <= w + 1, y >= -1, y <= h + 1
+    f.sides[0] = plane(X.x + W.x, X.y + W.y, X.z + W.z, X.h + W.h);
+    f.sides[1] = plane(right * W.x - X.x, right * W.y - X.y, right * W.z - X.z, right * W.h - X.h);
+    f.sides[2] = plane(Y.x + W.x, Y.y + W.y, Y.z + W.z, Y.h + W.h);
+    f.sides[3] = plane(top * W.x - Y.x, top * W.y - Y.y, top * W.z - Y.z, top * W.h - Y.h);
+
+    f.eye = plane(W.x, W.y, W.z, W.h);
+
+    // the camera is the one point x, y and h all map to
+    // zero, solved by Cramer's rule
+    auto const rx = Vec3{X.x, X.y, X.z};
+    auto const ry = Vec3{Y.x, Y.y, Y.z};
+    auto const rw = Vec3{W.x, W.y, W.z};
+
+    auto const det = dot(rx, cross(ry, rw));
+
+    if (det != 0)
+    {
+        f.eyePos = (cross(ry, rw) * X.h + cross(rw, rx) * Y.h + cross(rx, ry) * W.h) * (-1.0 / det);
+        f.winding = det > 0 ? 1.0 : -1.0;
+    }
+
+    return f;
+}
+
+} // namespace CxxRay
+
+#endif
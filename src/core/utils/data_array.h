@@ -1,23 +1,36 @@
 #ifndef CXXRAY_DATA_ARRAY_H
 #define CXXRAY_DATA_ARRAY_H
 
+#include "utils/mem_stats.h"
+
 #include <memory>
 #include <cstdlib>
 
 namespace CxxRay {
 
 template<typename T>
-T* allocateDataArray(long length)
+T* allocateDataArray(long length, MemTag tag = MemTag::Scratch)
 {
-    return (T*)std::malloc(length * sizeof(T));
+    auto const bytes = static_cast<size_t>(length) * sizeof(T);
+
+    memAdd(tag, static_cast<long long>(bytes));
+
+    return (T*)std::malloc(bytes);
 }
 
+// frees the array and takes it off the tag's count,
+// arrays adopted from elsewhere carry zero bytes
 template<typename T>
 struct DataArrayDeleter
 {
+    MemTag tag = MemTag::Scratch;
+    long long bytes = 0;
+
     void operator()(T * ptr)
     {
         std::free(ptr);
+
+        memSub(tag, bytes);
     }
 };
 
@@ -28,23 +41,25 @@ struct DataArray
     using DataT = T*;
 
     long len;
+    MemTag tag;
     GuardT guard;
     DataT data;
 
     DataArray(T* dat, long l)
         : len{l}
+        , tag{MemTag::Scratch}
         , guard{dat}
         , data{dat}
     {
     }
 
-    DataArray(long l)
+    DataArray(long l, MemTag t = MemTag::Scratch)
         : len{l}
+        , tag{t}
         , guard{nullptr}
         , data{nullptr}
     {
-        guard.reset(allocateDataArray<T>(l));
-        data = guard.get();
+        reallocate(l);
     }
 
     DataArray()
@@ -54,12 +69,15 @@ struct DataArray
 
     void reallocate()
     {
-        guard.reset(allocateDataArray<T>(len));
+        reallocate(len);
     }
 
     void reallocate(long l)
     {
-        guard.reset(allocateDataArray<T>(l));
+        auto const bytes = static_cast<long long>(static_cast<size_t>(l) * sizeof(T));
+
+        guard = GuardT{allocateDataArray<T>(l, tag), DataArrayDeleter<T>{tag, bytes}};
+        data = guard.get();
 
         len = l;
     }
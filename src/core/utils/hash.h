@@ -0,0 +1,95 @@
+#ifndef CXXRAY_HASH_H
+#define CXXRAY_HASH_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace CxxRay {
+
+constexpr uint64_t kHashSeed = 14695981039346656037ull;
+
+// murmur3's 64 bit finalizer, every input bit reaches
+// every output bit
+inline
+uint64_t
+mixBits(
+    uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+
+    return x;
+}
+
+// 64 bit words are xored into the state and mixed one at
+// a time so large files hash at memory speed, a change in
+// any bit of a word spreads over the whole state so later
+// edits can not cancel it, used to tell when a cached
+// file is out of date, not for security
+//
+// chain calls by passing the previous result as h
+inline
+uint64_t
+hashBytes(
+    void const * data,
+    size_t const len,
+    uint64_t h = kHashSeed)
+{
+    auto const * p = static_cast<unsigned char const *>(data);
+
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, p + i, 8);
+
+        h = mixBits(h ^ word);
+    }
+
+    // the last few bytes padded with zeros to a word
+    if (i < len)
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, p + i, len - i);
+
+        h = mixBits(h ^ word);
+    }
+
+    // fold the length in so trailing zeros count
+    return mixBits(h ^ static_cast<uint64_t>(len));
+}
+
+inline
+uint64_t
+hashString(
+    std::string const & s,
+    uint64_t const h = kHashSeed)
+{
+    return hashBytes(s.data(), s.size(), h);
+}
+
+inline
+std::string
+hashHex(
+    uint64_t const h)
+{
+    static char const digits[] = "0123456789abcdef";
+
+    std::string out(16, '0');
+
+    for (size_t i = 0; i < 16; i++) {
+        out[15 - i] = digits[(h >> (4 * i)) & 0xf];
+    }
+
+    return out;
+}
+
+} // namespace CxxRay
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef CXXRAY_MAPPED_FILE_H
+#define CXXRAY_MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+#include <cstddef>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CXXRAY_HAS_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace CxxRay {
+
+// read only view of a whole file
+//
+// the file is memory mapped where the platform supports
+// it so pages are only read in as they are touched,
+// elsewhere the file is read into a buffer up front
+struct MappedFile
+{
+    char const * ptr = nullptr;
+    size_t len = 0;
+    bool opened = false;
+
+#ifdef CXXRAY_HAS_MMAP
+    void * mapping = nullptr;
+#else
+    std::vector<char> buffer = {};
+#endif
+
+    MappedFile()
+    {
+    }
+
+    explicit MappedFile(std::string const & filePath)
+    {
+#ifdef CXXRAY_HAS_MMAP
+        int const fd = ::open(filePath.c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return;
+        }
+
+        opened = true;
+        len = static_cast<size_t>(st.st_size);
+
+        if (len > 0)
+        {
+            mapping = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (mapping == MAP_FAILED) {
+                mapping = nullptr;
+                opened = false;
+                len = 0;
+            } else {
+                ptr = static_cast<char const *>(mapping);
+            }
+        }
+
+        // the mapping stays valid after the descriptor is closed
+        ::close(fd);
+#else
+        std::ifstream fh{filePath, std::ios::binary | std::ios::ate};
+
+        if (!fh.is_open()) {
+            return;
+        }
+
+        opened = true;
+        len = static_cast<size_t>(fh.tellg());
+
+        buffer.resize(len);
+
+        fh.seekg(0);
+        fh.read(buffer.data(), static_cast<std::streamsize>(len));
+
+        ptr = buffer.data();
+#endif
+    }
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile & operator=(MappedFile const &) = delete;
+
+    MappedFile(MappedFile && other)
+    {
+        swap(other);
+    }
+
+    MappedFile & operator=(MappedFile && other)
+    {
+        MappedFile tmp{std::move(other)};
+        swap(tmp);
+
+        return (*this);
+    }
+
+    ~MappedFile()
+    {
+#ifdef CXXRAY_HAS_MMAP
+        if (mapping != nullptr) {
+            munmap(mapping, len);
+        }
+#endif
+    }
+
+    void swap(MappedFile & other)
+    {
+        std::swap(ptr, other.ptr);
+        std::swap(len, other.len);
+        std::swap(opened, other.opened);
+#ifdef CXXRAY_HAS_MMAP
+        std::swap(mapping, other.mapping);
+#else
+        std::swap(buffer, other.buffer);
+#endif
+    }
+
+    bool isOpen() const
+    {
+        return opened;
+    }
+
+    char const * data() const
+    {
+        return ptr;
+    }
+
+    size_t size() const
+    {
+        return len;
+    }
+
+    // hint that the whole file will be read front to back
+    void adviseSequential() const
+    {
+#ifdef CXXRAY_HAS_MMAP
+        if (mapping != nullptr) {
+            madvise(mapping, len, MADV_SEQUENTIAL);
+        }
+#endif
+    }
+};
+
+// writable file of a size known up front, mapped so
+// callers can fill it in place, elsewhere the bytes go
+// to a buffer that is written out on close
+struct MappedOutputFile
+{
+    char * ptr = nullptr;
+    size_t len = 0;
+    bool opened = false;
+
+#ifdef CXXRAY_HAS_MMAP
+    void * mapping = nullptr;
+#else
+    std::vector<char> buffer = {};
+    std::string path = "";
+#endif
+
+    MappedOutputFile()
+    {
+    }
+
+    MappedOutputFile(
+        std::string const & filePath,
+        size_t const size)
+    {
+#ifdef CXXRAY_HAS_MMAP
+        int const fd = ::open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+        if (fd < 0) {
+            return;
+        }
+
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            ::close(fd);
+            return;
+        }
+
+        opened = true;
+        len = size;
+
+        if (len > 0)
+        {
+            mapping = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+            if (mapping == MAP_FAILED) {
+                mapping = nullptr;
+                opened = false;
+                len = 0;
+            } else {
+                ptr = static_cast<char *>(mapping);
+            }
+        }
+
+        ::close(fd);
+#else
+        std::ofstream fh{filePath, std::ios::binary};
+
+        if (!fh.is_open()) {
+            return;
+        }
+
+        opened = true;
+        len = size;
+        path = filePath;
+
+        buffer.resize(len);
+
+        ptr = buffer.data();
+#endif
+    }
+
+    MappedOutputFile(MappedOutputFile const &) = delete;
+    MappedOutputFile & operator=(MappedOutputFile const &) = delete;
+
+    ~MappedOutputFile()
+    {
+        close();
+    }
+
+    bool isOpen() const
+    {
+        return opened;
+    }
+
+    char * data()
+    {
+        return ptr;
+    }
+
+    size_t size() const
+    {
+        return len;
+    }
+
+    // finish the file, the pages reach the disk through
+    // the page cache like any other write, false when the
+    // file was never opened or could not be finished
+    bool close()
+    {
+        if (!opened) {
+            return false;
+        }
+
+        opened = false;
+
+#ifdef CXXRAY_HAS_MMAP
+        bool ok = true;
+
+        if (mapping != nullptr) {
+            ok = munmap(mapping, len) == 0;
+            mapping = nullptr;
+        }
+
+        ptr = nullptr;
+
+        return ok;
+#else
+        std::ofstream fh{path, std::ios::binary};
+
+        fh.write(buffer.data(), static_cast<std::streamsize>(len));
+
+        ptr = nullptr;
+
+        return static_cast<bool>(fh);
+#endif
+    }
+};
+
+} // namespace CxxRay
+
+#endif
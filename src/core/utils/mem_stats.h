@@ -0,0 +1,209 @@
+#ifndef CXXRAY_MEM_STATS_H
+#define CXXRAY_MEM_STATS_H
+
+#include "utils/stats.h"
+
+#include <atomic>
+#include <array>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace CxxRay {
+
+// who owns a block of memory, every tracked allocation
+// is counted against exactly one of these
+enum class MemTag
+{
+    Mesh,        // vertex, normal, uv and face arrays
+    Texture,     // texture pixels
+    Framebuffer, // color and depth buffers
+    Scratch,     // per frame working memory such as shaded faces
+    Count
+};
+
+constexpr size_t kMemTagCount = static_cast<size_t>(MemTag::Count);
+
+inline
+char const *
+memTagName(
+    MemTag const tag)
+{
+    switch (tag)
+    {
+        case MemTag::Mesh: return "mesh";
+        case MemTag::Texture: return "texture";
+        case MemTag::Framebuffer: return "framebuffer";
+        case MemTag::Scratch: return "scratch";
+        default: return "unknown";
+    }
+}
+
+struct MemTagCounter
+{
+    std::atomic<long long> current{0};
+    std::atomic<long long> peak{0};
+};
+
+inline
+std::array<MemTagCounter,kMemTagCount> &
+memCounters()
+{
+    static std::array<MemTagCounter,kMemTagCount> counters;
+
+    return counters;
+}
+
+inline
+void
+memAdd(
+    MemTag const tag,
+    long long const bytes)
+{
+    auto & c = memCounters()[static_cast<size_t>(tag)];
+
+    auto const now = c.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+    auto peak = c.peak.load(std::memory_order_relaxed);
+
+    while (now > peak && !c.peak.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+    {
+    }
+}
+
+inline
+void
+memSub(
+    MemTag const tag,
+    long long const bytes)
+{
+    memCounters()[static_cast<size_t>(tag)].current.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+inline
+long long
+memCurrent(
+    MemTag const tag)
+{
+    return memCounters()[static_cast<size_t>(tag)].current.load(std::memory_order_relaxed);
+}
+
+inline
+long long
+memPeak(
+    MemTag const tag)
+{
+    return memCounters()[static_cast<size_t>(tag)].peak.load(std::memory_order_relaxed);
+}
+
+// restart peak tracking from the current usage,
+// e.g. to measure a single frame
+inline
+void
+memResetPeaks()
+{
+    for (auto & c : memCounters()) {
+        c.peak.store(c.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+// add mem_<tag>_current_bytes and mem_<tag>_peak_bytes
+// for every tag to the stats
+inline
+void
+recordMemStats(
+    Stats * stats)
+{
+    for (size_t i = 0; i < kMemTagCount; i++)
+    {
+        auto const tag = static_cast<MemTag>(i);
+        auto const name = std::string{"mem_"} + memTagName(tag);
+
+        record(stats, name + "_current_bytes", static_cast<double>(memCurrent(tag)));
+        record(stats, name + "_peak_bytes", static_cast<double>(memPeak(tag)));
+    }
+}
+
+inline
+std::string
+memReport()
+{
+    std::stringstream ss{""};
+
+    ss << std::fixed << std::setprecision(2);
+
+    for (size_t i = 0; i < kMemTagCount; i++)
+    {
+        auto const tag = static_cast<MemTag>(i);
+
+        ss << std::left << std::setw(12) << memTagName(tag) << std::right
+            << " current " << std::setw(10) << static_cast<double>(memCurrent(tag)) / (1024.0 * 1024.0) << " MiB"
+            << "  peak " << std::setw(10) << static_cast<double>(memPeak(tag)) / (1024.0 * 1024.0) << " MiB"
+            << "\n";
+    }
+
+    return ss.str();
+}
+
+// standard allocator that counts its memory against a tag,
+// for containers such as the mesh arrays
+template<typename T, MemTag Tag>
+struct TaggedAllocator
+{
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = TaggedAllocator<U,Tag>;
+    };
+
+    TaggedAllocator() = default;
+
+    template<typename U>
+    TaggedAllocator(TaggedAllocator<U,Tag> const &)
+    {
+    }
+
+    T * allocate(size_t const n)
+    {
+        auto * const ptr = static_cast<T*>(::operator new(n * sizeof(T)));
+
+        memAdd(Tag, static_cast<long long>(n * sizeof(T)));
+
+        return ptr;
+    }
+
+    void deallocate(T * const ptr, size_t const n)
+    {
+        memSub(Tag, static_cast<long long>(n * sizeof(T)));
+
+        ::operator delete(ptr);
+    }
+};
+
+template<typename T, typename U, MemTag Tag>
+bool operator==(TaggedAllocator<T,Tag> const &, TaggedAllocator<U,Tag> const &)
+{
+    return true;
+}
+
+template<typename T, typename U, MemTag Tag>
+bool operator!=(TaggedAllocator<T,Tag> const &, TaggedAllocator<U,Tag> const &)
+{
+    return false;
+}
+
+template<typename T>
+using MeshVector = std::vector<T,TaggedAllocator<T,MemTag::Mesh>>;
+
+template<typename T>
+using ScratchVector = std::vector<T,TaggedAllocator<T,MemTag::Scratch>>;
+
+} // namespace CxxRay
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef CXXRAY_PERF_COUNTERS_H
+#define CXXRAY_PERF_COUNTERS_H
+
+#include "utils/stats.h"
+
+#include <array>
+#include <string>
+#include <cstdint>
+
+#if defined(CXXRAY_PERF_COUNTERS) && defined(__linux__)
+#define CXXRAY_HAS_PERF_EVENTS 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace CxxRay {
+
+// hardware events read around a zone of code, the
+// same zones timed with a Profiler in the render loop
+enum class PerfEvent
+{
+    Cycles,
+    Instructions,
+    L1dMisses,
+    LlcMisses,
+    BranchMisses,
+    Count
+};
+
+constexpr size_t kPerfEventCount = static_cast<size_t>(PerfEvent::Count);
+
+#ifdef CXXRAY_HAS_PERF_EVENTS
+constexpr bool kPerfCountersEnabled = true;
+#else
+constexpr bool kPerfCountersEnabled = false;
+#endif
+
+struct PerfCounts
+{
+    std::array<bool,kPerfEventCount> valid = {};
+    std::array<double,kPerfEventCount> values = {};
+
+    bool has(PerfEvent const e) const
+    {
+        return valid[static_cast<size_t>(e)];
+    }
+
+    double get(PerfEvent const e) const
+    {
+        return values[static_cast<size_t>(e)];
+    }
+
+    // instructions per cycle, only when both were read
+    // and some cycles were counted
+    bool hasIpc() const
+    {
+        return has(PerfEvent::Cycles) && has(PerfEvent::Instructions) && get(PerfEvent::Cycles) > 0.0;
+    }
+
+    double ipc() const
+    {
+        return get(PerfEvent::Instructions) / get(PerfEvent::Cycles);
+    }
+};
+
+// reads hardware counters for the calling thread through
+// perf_event_open on Linux when built with the
+// CXXRAY_PERF_COUNTERS option
+//
+// each event is opened on its own so a machine without
+// e.g. an LLC miss event still reports the others, when
+// nothing can be opened (other platforms, containers,
+// a strict perf_event_paranoid) available() is false
+// and stop() returns counts with nothing valid
+struct PerfCounters
+{
+    std::array<int,kPerfEventCount> fds = {};
+
+    PerfCounters()
+    {
+        fds.fill(-1);
+
+#ifdef CXXRAY_HAS_PERF_EVENTS
+        open(PerfEvent::Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open(PerfEvent::Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open(PerfEvent::L1dMisses, PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_L1D |
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        open(PerfEvent::LlcMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        open(PerfEvent::BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+    }
+
+    PerfCounters(PerfCounters const &) = delete;
+    PerfCounters & operator=(PerfCounters const &) = delete;
+
+    ~PerfCounters()
+    {
+#ifdef CXXRAY_HAS_PERF_EVENTS
+        for (auto const fd : fds)
+        {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    bool available() const
+    {
+        for (auto const fd : fds)
+        {
+            if (fd >= 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void start()
+    {
+#ifdef CXXRAY_HAS_PERF_EVENTS
+        for (auto const fd : fds)
+        {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    PerfCounts stop()
+    {
+        PerfCounts counts{};
+
+#ifdef CXXRAY_HAS_PERF_EVENTS
+        for (auto const fd : fds)
+        {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+
+        for (size_t i = 0; i < kPerfEventCount; i++)
+        {
+            if (fds[i] < 0) {
+                continue;
+            }
+
+            // value, time enabled, time running
+            uint64_t buf[3] = {0, 0, 0};
+
+            auto const got = read(fds[i], buf, sizeof(buf));
+
+            if (got != static_cast<ssize_t>(sizeof(buf)) || buf[2] == 0) {
+                continue;
+            }
+
+            // when the kernel multiplexes more events than
+            // there are hardware counters scale up to the
+            // full time the event was enabled
+            counts.values[i] =
+                static_cast<double>(buf[0]) *
+                static_cast<double>(buf[1]) /
+                static_cast<double>(buf[2]);
+
+            counts.valid[i] = true;
+        }
+#endif
+
+        return counts;
+    }
+
+#ifdef CXXRAY_HAS_PERF_EVENTS
+    void open(
+        PerfEvent const e,
+        uint32_t const type,
+        uint64_t const config)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED |
+            PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // this thread, any cpu
+        auto const fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+        fds[static_cast<size_t>(e)] = static_cast<int>(fd);
+    }
+#endif
+};
+
+// add a zone's counts to the stats as <zone>_cycles,
+// <zone>_ipc, <zone>_llc_misses_per_pixel and so on,
+// events that could not be read are left out
+inline
+void
+recordPerfCounts(
+    Stats * stats,
+    std::string const & zone,
+    PerfCounts const & counts,
+    double const pixels)
+{
+    if (counts.has(PerfEvent::Cycles)) {
+        record(stats, zone + "_cycles", counts.get(PerfEvent::Cycles));
+    }
+
+    if (counts.has(PerfEvent::Instructions)) {
+        record(stats, zone + "_instructions", counts.get(PerfEvent::Instructions));
+    }
+
+    if (counts.hasIpc()) {
+        record(stats, zone + "_ipc", counts.ipc());
+    }
+
+    if (pixels <= 0.0) {
+        return;
+    }
+
+    if (counts.has(PerfEvent::L1dMisses)) {
+        record(stats, zone + "_l1d_misses_per_pixel", counts.get(PerfEvent::L1dMisses) / pixels);
+    }
+
+    if (counts.has(PerfEvent::LlcMisses)) {
+        record(stats, zone + "_llc_misses_per_pixel", counts.get(PerfEvent::LlcMisses) / pixels);
+    }
+
+    if (counts.has(PerfEvent::BranchMisses)) {
+        record(stats, zone + "_branch_misses_per_pixel", counts.get(PerfEvent::BranchMisses) / pixels);
+    }
+}
+
+} // namespace CxxRay
+
+#endif
@@ -24,6 +24,14 @@ struct RandReal
     {
     }
 
+    // seeded for repeatable sequences, e.g. generated test scenes
+    RandReal(ValT const lbound, ValT const ubound, unsigned const seed)
+        : rd{}
+        , gen{seed}
+        , dis{lbound, ubound}
+    {
+    }
+
     RandReal()
         : rd{}
         , gen{rd()}
@@ -50,6 +58,14 @@ struct RandInt
     {
     }
 
+    // seeded for repeatable sequences, e.g. generated test scenes
+    RandInt(ValT const lbound, ValT const ubound, unsigned const seed)
+        : rd{}
+        , gen{seed}
+        , dis{lbound, ubound}
+    {
+    }
+
     RandInt()
         : rd{}
         , gen{rd()}
@@ -80,12 +96,13 @@ T get(RandInt<T> & r)
     return r.dis(r.gen);
 }
 
+inline
 unsigned char
 get(RandByte & b)
 {
     auto & r = b.rand;
 
-    return r.dis(r.gen);
+    return static_cast<unsigned char>(r.dis(r.gen));
 }
 
 template<typename T>
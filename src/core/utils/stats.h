@@ -0,0 +1,321 @@
+#ifndef CXXRAY_STATS_H
+#define CXXRAY_STATS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <cctype>
+#include <cmath>
+
+namespace CxxRay {
+
+// named measurements collected over one run of a
+// program, every metric holds one sample per repetition
+//
+// saved as JSON so runs can be compared later
+//
+// {
+//   "name": "draw_raster",
+//   "metrics": {
+//     "fragment_shader_ms": [ 41.2, 40.8, 41.9 ],
+//     "vertex_shader_ms": [ 12.1, 12.0, 12.4 ]
+//   }
+// }
+struct Stats
+{
+    std::string name = "";
+    std::map<std::string,std::vector<double>> metrics = {};
+};
+
+inline
+void
+record(
+    Stats & stats,
+    std::string const & metric,
+    double const value)
+{
+    stats.metrics[metric].push_back(value);
+}
+
+inline
+void
+record(
+    Stats * stats,
+    std::string const & metric,
+    double const value)
+{
+    if (stats != nullptr) {
+        record(*stats, metric, value);
+    }
+}
+
+inline
+std::string
+toJson(
+    Stats const & stats)
+{
+    std::stringstream ss{""};
+
+    ss << std::setprecision(10);
+
+    ss << "{\n";
+    ss << "  \"name\": \"" << stats.name << "\",\n";
+    ss << "  \"metrics\": {";
+
+    bool first = true;
+
+    for (auto const & [ metric, samples ] : stats.metrics)
+    {
+        ss << (first ? "\n" : ",\n");
+        ss << "    \"" << metric << "\": [";
+
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            // json has no representation for nan or inf
+            auto const val = std::isfinite(samples[i]) ? samples[i] : 0.0;
+
+            ss << (i == 0 ? " " : ", ") << val;
+        }
+
+        ss << " ]";
+
+        first = false;
+    }
+
+    ss << "\n  }\n";
+    ss << "}\n";
+
+    return ss.str();
+}
+
+namespace statsParse {
+
+    // just enough json to read back what toJson() writes,
+    // unknown keys are skipped so files may carry extra data
+    struct Reader
+    {
+        std::string const & src;
+        size_t pos = 0;
+
+        void fail(std::string const & msg) const
+        {
+            throw std::runtime_error{
+                "Stats JSON: " + msg + " at offset " + std::to_string(pos)};
+        }
+
+        void skipWhite()
+        {
+            while (pos < src.size() && std::isspace(static_cast<unsigned char>(src[pos]))) {
+                pos++;
+            }
+        }
+
+        char peek()
+        {
+            skipWhite();
+
+            return pos < src.size() ? src[pos] : '\0';
+        }
+
+        void expect(char const c)
+        {
+            if (peek() != c) {
+                fail(std::string{"expected '"} + c + "'");
+            }
+
+            pos++;
+        }
+
+        std::string readString()
+        {
+            expect('"');
+
+            std::string out = "";
+
+            while (pos < src.size() && src[pos] != '"')
+            {
+                if (src[pos] == '\\' && pos + 1 < src.size()) {
+                    pos++;
+                }
+
+                out += src[pos++];
+            }
+
+            expect('"');
+
+            return out;
+        }
+
+        double readNumber()
+        {
+            skipWhite();
+
+            size_t used = 0;
+            double val = 0.0;
+
+            try {
+                val = std::stod(src.substr(pos, 64), &used);
+            } catch (std::exception const &) {
+                fail("invalid number");
+            }
+
+            pos += used;
+
+            return val;
+        }
+
+        std::vector<double> readNumbers()
+        {
+            std::vector<double> out;
+
+            expect('[');
+
+            if (peek() == ']') {
+                pos++;
+                return out;
+            }
+
+            while (true)
+            {
+                out.push_back(readNumber());
+
+                if (peek() == ',') {
+                    pos++;
+                    continue;
+                }
+
+                expect(']');
+                break;
+            }
+
+            return out;
+        }
+
+        void skipValue()
+        {
+            auto const c = peek();
+
+            if (c == '"') {
+                readString();
+            } else if (c == '{' || c == '[') {
+                auto const close = c == '{' ? '}' : ']';
+
+                pos++;
+
+                while (peek() != close)
+                {
+                    if (c == '{') {
+                        readString();
+                        expect(':');
+                    }
+
+                    skipValue();
+
+                    if (peek() == ',') {
+                        pos++;
+                    }
+                }
+
+                pos++;
+            } else if (c == 't' || c == 'f' || c == 'n') {
+                while (pos < src.size() && std::isalpha(static_cast<unsigned char>(src[pos]))) {
+                    pos++;
+                }
+            } else {
+                readNumber();
+            }
+        }
+    };
+
+} // namespace statsParse
+
+inline
+Stats
+parseStatsJson(
+    std::string const & src)
+{
+    statsParse::Reader rd{src};
+
+    Stats stats;
+
+    rd.expect('{');
+
+    while (rd.peek() != '}')
+    {
+        auto const key = rd.readString();
+        rd.expect(':');
+
+        if (key == "name")
+        {
+            stats.name = rd.readString();
+        }
+        else if (key == "metrics")
+        {
+            rd.expect('{');
+
+            while (rd.peek() != '}')
+            {
+                auto const metric = rd.readString();
+                rd.expect(':');
+
+                stats.metrics[metric] = rd.readNumbers();
+
+                if (rd.peek() == ',') {
+                    rd.pos++;
+                }
+            }
+
+            rd.expect('}');
+        }
+        else
+        {
+            rd.skipValue();
+        }
+
+        if (rd.peek() == ',') {
+            rd.pos++;
+        }
+    }
+
+    rd.expect('}');
+
+    return stats;
+}
+
+inline
+void
+saveStatsFile(
+    std::string const & filePath,
+    Stats const & stats)
+{
+    std::ofstream fh{filePath, std::ios::binary};
+
+    auto const json = toJson(stats);
+
+    fh.write(json.data(), static_cast<std::streamsize>(json.size()));
+}
+
+inline
+Stats
+loadStatsFile(
+    std::string const & filePath)
+{
+    std::ifstream fh{filePath, std::ios::binary};
+
+    if (!fh.good()) {
+        throw std::runtime_error{"ERROR OPENING: " + filePath};
+    }
+
+    std::stringstream ss{""};
+    ss << fh.rdbuf();
+
+    return parseStatsJson(ss.str());
+}
+
+} // namespace CxxRay
+
+#endif
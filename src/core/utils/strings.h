@@ -1,8 +1,15 @@
 #ifndef CXXRAY_STRINGS_H
 #define CXXRAY_STRINGS_H
 
+#include "global/global.h"
+
 #include <string>
 #include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <cctype>
 
 namespace CxxRay {
@@ -44,6 +51,77 @@ void strip_comments(std::string & s)
     s.erase(pos, s.end());
 }
 
+// parse a real number at the start of [first, last),
+// returns one past the last character used or nullptr
+// when there is no number there
+inline
+char const *
+parseReal(
+    char const * first,
+    char const * last,
+    Real & out)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto const res = std::from_chars(first, last, out);
+
+    return res.ec == std::errc{} ? res.ptr : nullptr;
+#else
+    // strtod needs a terminated string
+    char buf[64];
+
+    auto const n = std::min<size_t>(static_cast<size_t>(last - first), sizeof(buf) - 1);
+
+    std::memcpy(buf, first, n);
+    buf[n] = '\0';
+
+    char * end = nullptr;
+    out = std::strtod(buf, &end);
+
+    return end != buf ? first + (end - buf) : nullptr;
+#endif
+}
+
+// parse an integer at the start of [first, last),
+// returns one past the last digit or nullptr
+inline
+char const *
+parseInt(
+    char const * first,
+    char const * last,
+    long long & out)
+{
+    auto const res = std::from_chars(first, last, out);
+
+    return res.ec == std::errc{} ? res.ptr : nullptr;
+}
+
+// append the shortest text that reads back as the same
+// real, exponent notation for very small or large values
+inline
+void
+appendReal(
+    std::string & out,
+    Real const val)
+{
+    char buf[64];
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto const res = std::to_chars(buf, buf + sizeof(buf), val);
+
+    if (res.ec != std::errc{}) {
+        throw std::runtime_error{"Real does not fit the text buffer"};
+    }
+
+    out.append(buf, res.ptr);
+#else
+    // 17 significant digits always read back the same
+    auto const n = std::snprintf(buf, sizeof(buf), "%.17g", val);
+
+    // snprintf gives the length it wanted, not what fit
+    out.append(buf, std::min<size_t>(static_cast<size_t>(n > 0 ? n : 0), sizeof(buf) - 1));
+#endif
+}
+
 } // namespace CxxRay
 
 #endif
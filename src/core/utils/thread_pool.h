@@ -0,0 +1,130 @@
+#ifndef CXXRAY_THREAD_POOL_H
+#define CXXRAY_THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+namespace CxxRay {
+
+inline
+unsigned
+hardwareThreads()
+{
+    auto const n = std::thread::hardware_concurrency();
+
+    return n > 0 ? n : 1;
+}
+
+// fixed set of worker threads taking jobs from one queue
+//
+// jobs must not block waiting on other jobs of the same
+// pool, the pool may have fewer workers than jobs
+struct ThreadPool
+{
+    std::vector<std::thread> workers = {};
+    std::deque<std::function<void()>> jobs = {};
+
+    std::mutex mutex = {};
+    std::condition_variable wake = {};
+
+    bool stopping = false;
+
+    explicit ThreadPool(unsigned const threads = hardwareThreads())
+    {
+        auto const n = threads > 0 ? threads : 1;
+
+        workers.reserve(n);
+
+        for (unsigned i = 0; i < n; i++) {
+            workers.emplace_back([this]() { work(); });
+        }
+    }
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool & operator=(ThreadPool const &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for (auto & t : workers) {
+            t.join();
+        }
+    }
+
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+    // queue a job, the future holds its result
+    // or the exception it threw
+    template<typename F>
+    auto submit(F && f) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using R = std::invoke_result_t<std::decay_t<F>>;
+
+        // std::function needs a copyable target
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        auto result = task->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            jobs.emplace_back([task]() { (*task)(); });
+        }
+
+        wake.notify_one();
+
+        return result;
+    }
+
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+
+                wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+                if (jobs.empty()) {
+                    return;
+                }
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            job();
+        }
+    }
+};
+
+// pool shared by the loaders, one worker per hardware thread
+inline
+ThreadPool &
+defaultThreadPool()
+{
+    static ThreadPool pool{hardwareThreads()};
+
+    return pool;
+}
+
+} // namespace CxxRay
+
+#endif
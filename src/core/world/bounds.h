@@ -0,0 +1,126 @@
+#ifndef CXXRAY_BOUNDS_H
+#define CXXRAY_BOUNDS_H
+
+#include "linalg/linalg.h"
+
+#include "global/global.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace CxxRay {
+
+// axis aligned box and bounding sphere of a set of points,
+// the sphere is centered on the box and just reaches the
+// farthest point, a negative radius means no points
+struct Bounds
+{
+    Vec3 lo = {};
+    Vec3 hi = {};
+    Vec3 center = {};
+    Real radius = -1.0;
+
+    bool empty() const
+    {
+        return radius < 0;
+    }
+};
+
+// bounds of the points forEachPoint passes to the function
+// it is given, it is called twice so the sphere can be
+// fitted once the box is known
+template<typename ForEachPoint>
+Bounds
+makeBounds(
+    ForEachPoint const & forEachPoint)
+{
+    Bounds b;
+
+    bool first = true;
+
+    forEachPoint([&b, &first](Vec3 const & p) {
+        if (first) {
+            b.lo = p;
+            b.hi = p;
+            first = false;
+            return;
+        }
+
+        b.lo = Vec3{std::min(b.lo.x, p.x), std::min(b.lo.y, p.y), std::min(b.lo.z, p.z)};
+        b.hi = Vec3{std::max(b.hi.x, p.x), std::max(b.hi.y, p.y), std::max(b.hi.z, p.z)};
+    });
+
+    if (first) {
+        return b;
+    }
+
+    b.center = (b.lo + b.hi) * 0.5;
+
+    Real farthest = 0.0;
+
+    forEachPoint([&b, &farthest](Vec3 const & p) {
+        auto const d = p - b.center;
+
+        farthest = std::max(farthest, dot(d, d));
+    });
+
+    b.radius = std::sqrt(farthest);
+
+    return b;
+}
+
+// spread of a set of unit normals, every one is within
+// acos(sqrt(1 - cutoff^2)) of axis, a cutoff of 1 means
+// they spread too wide for the cone to be of any use
+struct NormalCone
+{
+    Vec3 axis = {};
+    Real cutoff = 1.0;
+};
+
+// cone around the normals forEachNormal passes to the
+// function it is given, called twice like makeBounds,
+// zero normals are skipped
+template<typename ForEachNormal>
+NormalCone
+makeNormalCone(
+    ForEachNormal const & forEachNormal)
+{
+    // below this the cone is near a half space and
+    // culls next to nothing
+    constexpr Real kMinSpreadDot = 0.1;
+
+    NormalCone c;
+
+    Vec3 sum = {};
+
+    forEachNormal([&sum](Vec3 const & n) {
+        sum = sum + n;
+    });
+
+    auto const len = length(sum);
+
+    if (len <= 0) {
+        return c;
+    }
+
+    c.axis = sum * (1.0 / len);
+
+    Real minDot = 1.0;
+
+    forEachNormal([&c, &minDot](Vec3 const & n) {
+        if (dot(n, n) > 0) {
+            minDot = std::min(minDot, dot(n, c.axis));
+        }
+    });
+
+    if (minDot > kMinSpreadDot) {
+        c.cutoff = std::sqrt(1 - minDot * minDot);
+    }
+
+    return c;
+}
+
+} // namespace CxxRay
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef CXXRAY_INDEXED_MESH_H
+#define CXXRAY_INDEXED_MESH_H
+
+#include "world/mesh.h"
+#include "world/mesh_view.h"
+#include "utils/mem_stats.h"
+
+#include <vector>
+#include <tuple>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstdint>
+
+namespace CxxRay {
+
+// position, normal and uv of one corner, shared by
+// every triangle that uses the same combination
+struct MeshVertex
+{
+    Vec3 pos = {};
+    Vec3 norm = {};
+    Real u = 0.0;
+    Real v = 0.0;
+};
+
+// welded mesh, one interleaved vertex array and three
+// zero based 32 bit indexes per triangle
+struct IndexedMesh
+{
+    MeshVector<MeshVertex> vertices = {};
+    MeshVector<uint32_t> indices = {};
+    MeshVector<uint32_t> faceMtls = {};
+
+    std::vector<MeshMtl> mtls = {};
+
+    // parts of the mesh welded from, with the range of
+    // vertexes each one's faces use
+    std::vector<MeshPart> parts = {};
+
+    // clusters covering the faces in order, left empty
+    // until buildMeshlets is run
+    std::vector<Meshlet> meshlets = {};
+
+    size_t faceCount() const
+    {
+        return indices.size() / 3;
+    }
+
+    MeshMtl const & faceMtl(size_t const i) const
+    {
+        return mtls[faceMtls[i]];
+    }
+};
+
+namespace weld {
+
+    constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+    // merges (v, vt, vn) references into unique vertexes
+    //
+    // welded vertexes sharing a position are chained off
+    // that position, so a lookup only compares the few
+    // uv/normal combinations seen with it
+    struct Welder
+    {
+        IndexedMesh & out;
+
+        struct Node
+        {
+            long long uvId = 0;
+            long long normId = 0;
+            uint32_t next = kNone;
+        };
+
+        std::vector<uint32_t> head;
+        std::vector<Node> nodes = {};
+
+        Welder(
+            IndexedMesh & out_,
+            size_t const positions)
+            : out{out_}
+            , head(positions + 1, kNone)
+        {
+            nodes.reserve(positions);
+        }
+
+        template<typename GetVertex>
+        uint32_t add(
+            MeshIndex const & I,
+            GetVertex const & getVertex)
+        {
+            // out of range positions share slot 0
+            auto const slot = I.id >= 1 && static_cast<size_t>(I.id) < head.size()
+                ? static_cast<size_t>(I.id)
+                : 0;
+
+            for (auto at = head[slot]; at != kNone; at = nodes[at].next)
+            {
+                if (nodes[at].uvId == I.uvId && nodes[at].normId == I.normId) {
+                    return at;
+                }
+            }
+
+            // kNone ends the chains so it is never an index
+            if (out.vertices.size() >= kNone) {
+                throw std::runtime_error{"Welded mesh has too many vertexes for 32 bit indexes"};
+            }
+
+            auto const id = static_cast<uint32_t>(out.vertices.size());
+
+            out.vertices.push_back(getVertex(I));
+            nodes.push_back({I.uvId, I.normId, head[slot]});
+            head[slot] = id;
+
+            return id;
+        }
+    };
+
+    // references outside the arrays (such as a missing
+    // uv or normal, numbered 0) weld to default values
+    template<typename T, typename Array>
+    T
+    fetch(
+        Array const & arr,
+        size_t const count,
+        long long const ref,
+        T const & fallback)
+    {
+        if (ref < 1 || static_cast<size_t>(ref) > count) {
+            return fallback;
+        }
+
+        return arr[static_cast<size_t>(ref - 1)];
+    }
+
+    // vertexes are numbered as they are first used so each
+    // part's are mostly one run, shared ones widen the range
+    inline
+    void
+    setPartVertices(
+        IndexedMesh & mesh)
+    {
+        for (auto & part : mesh.parts)
+        {
+            auto const first = mesh.indices.begin() + static_cast<long>(3 * part.firstFace);
+            auto const last = first + static_cast<long>(3 * part.faceCount);
+
+            if (first == last) {
+                continue;
+            }
+
+            auto const [ lo, hi ] = std::minmax_element(first, last);
+
+            part.firstVertex = *lo;
+            part.vertexCount = *hi - *lo + 1;
+        }
+    }
+
+} // namespace weld
+
+// weld a loaded mesh, faces keep their index into its
+// material table
+inline
+IndexedMesh
+weldMesh(
+    Mesh const & mesh)
+{
+    using namespace weld;
+
+    IndexedMesh out;
+
+    out.indices.reserve(mesh.faces.size() * 3);
+    out.faceMtls.reserve(mesh.faces.size());
+    out.vertices.reserve(mesh.verts.size());
+
+    Welder welder{out, mesh.verts.size()};
+
+    auto const getVertex = [&mesh](MeshIndex const & I) {
+        auto const [ u, v ] = fetch(mesh.uvs, mesh.uvs.size(), I.uvId, std::tuple<Real,Real>{0.0, 0.0});
+
+        return MeshVertex{
+            fetch(mesh.verts, mesh.verts.size(), I.id, Vec3{}),
+            fetch(mesh.norms, mesh.norms.size(), I.normId, Vec3{}),
+            u,
+            v
+        };
+    };
+
+    out.mtls = mesh.mtlTable;
+
+    for (auto const & face : mesh.faces)
+    {
+        for (auto const & I : face.vertexIndexes) {
+            out.indices.push_back(welder.add(I, getVertex));
+        }
+
+        out.faceMtls.push_back(face.mtlId);
+    }
+
+    out.parts = mesh.parts;
+
+    setPartVertices(out);
+
+    return out;
+}
+
+inline
+IndexedMesh
+weldMesh(
+    MeshView const & mesh)
+{
+    using namespace weld;
+
+    IndexedMesh out;
+
+    out.mtls = mesh.mtls;
+
+    out.indices.reserve(mesh.faceCount * 3);
+    out.faceMtls.reserve(mesh.faceCount);
+    out.vertices.reserve(mesh.vertCount);
+
+    Welder welder{out, mesh.vertCount};
+
+    auto const getVertex = [&mesh](MeshIndex const & I) {
+        auto const [ u, v ] = I.uvId >= 1 && static_cast<size_t>(I.uvId) <= mesh.uvCount
+            ? mesh.uv(static_cast<size_t>(I.uvId - 1))
+            : std::tuple<Real,Real>{0.0, 0.0};
+
+        return MeshVertex{
+            fetch(mesh.verts, mesh.vertCount, I.id, Vec3{}),
+            fetch(mesh.norms, mesh.normCount, I.normId, Vec3{}),
+            u,
+            v
+        };
+    };
+
+    for (size_t i = 0; i < mesh.faceCount; i++)
+    {
+        for (auto const & I : mesh.faces[i]) {
+            out.indices.push_back(welder.add(I, getVertex));
+        }
+
+        out.faceMtls.push_back(mesh.faceMtls[i]);
+    }
+
+    out.parts = mesh.parts;
+
+    setPartVertices(out);
+
+    return out;
+}
+
+} // namespace CxxRay
+
+#endif
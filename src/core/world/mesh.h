@@ -5,11 +5,15 @@
 #include "linalg/vec4.h"
 #include "image/pixel.h"
 #include "image/texture_image.h"
+#include "world/bounds.h"
 #include "rgb/rgb.h"
+#include "utils/mem_stats.h"
 
 #include <array>
+#include <string>
 #include <vector>
 #include <unordered_map>
+#include <cstdint>
 
 namespace CxxRay {
 
@@ -23,6 +27,19 @@ struct MeshMtl
     std::string texName = "";
 };
 
+inline
+bool
+sameMtl(
+    MeshMtl const & a,
+    MeshMtl const & b)
+{
+    return a.texName == b.texName &&
+        a.specExp == b.specExp &&
+        a.ambient.r == b.ambient.r && a.ambient.g == b.ambient.g && a.ambient.b == b.ambient.b &&
+        a.diffuse.r == b.diffuse.r && a.diffuse.g == b.diffuse.g && a.diffuse.b == b.diffuse.b &&
+        a.specular.r == b.specular.r && a.specular.g == b.specular.g && a.specular.b == b.specular.b;
+}
+
 struct ShadedVertex
 {
     Vec4 coord = {1.0, 1.0, 1.0, 1.0};
@@ -51,22 +68,123 @@ struct MeshIndex
 
 using MeshFaceIndex = std::array<MeshIndex,3>;
 
-// mesh face information lookup
+// mesh face information lookup, the material is an
+// index into the mesh's material table
 struct MeshFace
 {
-    MeshMtl mtl;
+    uint32_t mtlId = 0;
     MeshFaceIndex vertexIndexes;
 };
 
+inline
+MeshFaceIndex const &
+faceIndexes(
+    MeshFace const & face)
+{
+    return face.vertexIndexes;
+}
+
+inline
+MeshFaceIndex const &
+faceIndexes(
+    MeshFaceIndex const & face)
+{
+    return face;
+}
+
+// run of faces read from one OBJ object or group (o or g
+// record), bounded so it can be skipped as a whole
+struct MeshPart
+{
+    std::string name = "";
+
+    size_t firstFace = 0;
+    size_t faceCount = 0;
+
+    // range of the vertexes its faces use once welded
+    // (see world/indexed_mesh.h)
+    uint32_t firstVertex = 0;
+    uint32_t vertexCount = 0;
+
+    Bounds bounds = {};
+};
+
+// small cluster of neighbouring faces (see world/meshlets.h),
+// bounded and with the spread of its face normals so it can
+// be skipped when off screen or facing away
+struct Meshlet
+{
+    size_t firstFace = 0;
+    size_t faceCount = 0;
+
+    Bounds bounds = {};
+    NormalCone cone = {};
+};
+
+// the arrays count against MemTag::Mesh
+//
+// parts, when there are any, cover the faces in order
+//
+// mtls holds the materials as defined by name, mtlTable
+// the ones faces use with the name each was used under
+// ("" for none) in mtlNames, a material redefined part
+// way through a file has an entry for each definition
 struct Mesh
 {
     std::unordered_map<std::string,MeshMtl> mtls;
-    std::vector<MeshFace> faces = {};
-    std::vector<Vec3> verts = {};
-    std::vector<Vec3> norms = {};
-    std::vector<std::tuple<Real,Real>> uvs = {};
+    MeshVector<MeshFace> faces = {};
+    MeshVector<Vec3> verts = {};
+    MeshVector<Vec3> norms = {};
+    MeshVector<std::tuple<Real,Real>> uvs = {};
+    std::vector<MeshPart> parts = {};
+
+    std::vector<MeshMtl> mtlTable = {};
+    std::vector<std::string> mtlNames = {};
+
+    MeshMtl const & faceMtl(size_t const i) const
+    {
+        return mtlTable[faces[i].mtlId];
+    }
 };
 
+// add a material faces can refer to, returns its index
+inline
+uint32_t
+addFaceMtl(
+    Mesh & mesh,
+    MeshMtl const & mtl,
+    std::string const & name = "")
+{
+    mesh.mtlTable.push_back(mtl);
+    mesh.mtlNames.push_back(name);
+
+    return static_cast<uint32_t>(mesh.mtlTable.size() - 1);
+}
+
+// bounds of the positions a run of faces uses, positions
+// out of range are skipped
+template<typename Faces, typename Verts>
+Bounds
+faceBounds(
+    Faces const & faces,
+    size_t const firstFace,
+    size_t const faceCount,
+    Verts const & verts,
+    size_t const vertCount)
+{
+    return makeBounds([&](auto const & add) {
+        for (size_t f = firstFace; f < firstFace + faceCount; f++)
+        {
+            for (auto const & I : faceIndexes(faces[f]))
+            {
+                if (I.id >= 1 && static_cast<size_t>(I.id) <= vertCount) {
+                    add(verts[static_cast<size_t>(I.id - 1)]);
+                }
+            }
+        }
+    });
+}
+
 } // namespace CxxRay
 
 #endif
@@ -0,0 +1,117 @@
+#ifndef CXXRAY_MESH_VIEW_H
+#define CXXRAY_MESH_VIEW_H
+
+#include "world/mesh.h"
+#include "utils/mapped_file.h"
+#include "utils/mem_stats.h"
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <cstdint>
+
+namespace CxxRay {
+
+// read only mesh whose arrays point straight into a
+// mapped mesh cache file (see loaders/mesh_cache.h)
+//
+// faces keep their indexes in the same 1 based form as
+// Mesh and pick their material from a small table by
+// number instead of carrying a copy of it
+struct MeshView
+{
+    MappedFile file = {};
+
+    // holds the cache when it could not be mapped from disk
+    MeshVector<char> bytes = {};
+
+    Vec3 const * verts = nullptr;
+    Vec3 const * norms = nullptr;
+    Real const * uvs = nullptr; // u, v pairs
+    MeshFaceIndex const * faces = nullptr;
+    uint32_t const * faceMtls = nullptr;
+
+    size_t vertCount = 0;
+    size_t normCount = 0;
+    size_t uvCount = 0;
+    size_t faceCount = 0;
+
+    std::vector<MeshMtl> mtls = {};
+
+    // name each of mtls was kept under, "" for one that
+    // had none
+    std::vector<std::string> mtlNames = {};
+
+    // cover the faces in order when there are any
+    std::vector<MeshPart> parts = {};
+
+    // files the mesh was built from besides the OBJ itself
+    std::vector<std::string> deps = {};
+
+    uint64_t sourceHash = 0;
+
+    // read from an existing cache file instead of being rebuilt
+    bool cached = false;
+
+    bool ok = false;
+
+    bool valid() const
+    {
+        return ok;
+    }
+
+    std::tuple<Real,Real> uv(size_t const i) const
+    {
+        return {uvs[2 * i], uvs[2 * i + 1]};
+    }
+
+    MeshMtl const & faceMtl(size_t const i) const
+    {
+        return mtls[faceMtls[i]];
+    }
+};
+
+// copy a view into an ordinary mesh, for code that
+// edits meshes or only takes a Mesh
+inline
+Mesh
+toMesh(
+    MeshView const & view)
+{
+    Mesh mesh;
+
+    for (size_t i = 0; i < view.mtls.size(); i++)
+    {
+        auto const name = i < view.mtlNames.size() ? view.mtlNames[i] : std::string{""};
+
+        addFaceMtl(mesh, view.mtls[i], name);
+
+        // the last entry of a name is its definition
+        if (name != "") {
+            mesh.mtls[name] = view.mtls[i];
+        }
+    }
+
+    mesh.verts.assign(view.verts, view.verts + view.vertCount);
+    mesh.norms.assign(view.norms, view.norms + view.normCount);
+
+    mesh.uvs.reserve(view.uvCount);
+
+    for (size_t i = 0; i < view.uvCount; i++) {
+        mesh.uvs.push_back(view.uv(i));
+    }
+
+    mesh.faces.reserve(view.faceCount);
+
+    for (size_t i = 0; i < view.faceCount; i++) {
+        mesh.faces.push_back(MeshFace{view.faceMtls[i], view.faces[i]});
+    }
+
+    mesh.parts = view.parts;
+
+    return mesh;
+}
+
+} // namespace CxxRay
+
+#endif
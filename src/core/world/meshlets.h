@@ -0,0 +1,233 @@
+#ifndef CXXRAY_MESHLETS_H
+#define CXXRAY_MESHLETS_H
+
+#include "world/indexed_mesh.h"
+#include "world/bounds.h"
+#include "linalg/linalg.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace CxxRay {
+
+struct MeshletOptions
+{
+    // faces in a cluster at most
+    size_t maxFaces = 96;
+
+    // a face joins a cluster only when its normal is within
+    // acos(minConeDot) of the cluster's average so far, a
+    // tighter cone faces away from the camera more often
+    Real minConeDot = 0.5;
+};
+
+namespace meshlets {
+
+    // unit normal of the triangle in its winding order,
+    // counter clockwise faces point toward the viewer,
+    // zero for a degenerate triangle
+    inline
+    Vec3
+    faceNormal(
+        Vec3 const & a,
+        Vec3 const & b,
+        Vec3 const & c)
+    {
+        auto const n = cross(b - a, c - a);
+        auto const len = length(n);
+
+        return len > 0 ? n * (1.0 / len) : Vec3{};
+    }
+
+    // bounds and normal cone of a run of triangles, pos
+    // takes a vertex index to its position
+    template<typename Pos>
+    void
+    fitMeshlet(
+        Meshlet & m,
+        uint32_t const * indices,
+        Pos const & pos)
+    {
+        auto const * const first = indices + 3 * m.firstFace;
+        auto const * const last = first + 3 * m.faceCount;
+
+        m.bounds = makeBounds([&](auto const & add) {
+            for (auto const * I = first; I != last; I++) {
+                add(pos(*I));
+            }
+        });
+
+        m.cone = makeNormalCone([&](auto const & add) {
+            for (auto const * I = first; I != last; I += 3) {
+                add(faceNormal(pos(I[0]), pos(I[1]), pos(I[2])));
+            }
+        });
+    }
+
+} // namespace meshlets
+
+// split a welded mesh's faces into clusters of neighbouring
+// faces with similar normals, reordering the faces so each
+// cluster is one run, clusters never cross a part
+//
+// each is grown breadth first over faces sharing a vertex
+// from the first face not yet taken
+inline
+void
+buildMeshlets(
+    IndexedMesh & mesh,
+    MeshletOptions const & opts = {})
+{
+    using meshlets::faceNormal;
+    using meshlets::fitMeshlet;
+
+    constexpr uint32_t kNone = weld::kNone;
+
+    auto const faceCount = mesh.faceCount();
+    auto const vertCount = mesh.vertices.size();
+
+    auto const pos = [&mesh](uint32_t const v) -> Vec3 const & {
+        return mesh.vertices[v].pos;
+    };
+
+    std::vector<Vec3> normals(faceCount);
+
+    for (size_t f = 0; f < faceCount; f++)
+    {
+        auto const * I = mesh.indices.data() + 3 * f;
+
+        normals[f] = faceNormal(pos(I[0]), pos(I[1]), pos(I[2]));
+    }
+
+    // faces around each vertex
+    std::vector<uint32_t> start(vertCount + 1, 0);
+    std::vector<uint32_t> around(3 * faceCount);
+
+    for (auto const v : mesh.indices) {
+        start[v + 1]++;
+    }
+
+    for (size_t v = 0; v < vertCount; v++) {
+        start[v + 1] += start[v];
+    }
+
+    {
+        auto fill = start;
+
+        for (size_t i = 0; i < mesh.indices.size(); i++) {
+            around[fill[mesh.indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    // parts are split separately so they stay whole, any
+    // faces between them are split on their own
+    std::vector<std::pair<size_t,size_t>> ranges;
+
+    size_t covered = 0;
+
+    for (auto const & part : mesh.parts)
+    {
+        if (part.firstFace > covered) {
+            ranges.push_back({covered, part.firstFace});
+        }
+
+        ranges.push_back({part.firstFace, part.firstFace + part.faceCount});
+        covered = part.firstFace + part.faceCount;
+    }
+
+    if (covered < faceCount) {
+        ranges.push_back({covered, faceCount});
+    }
+
+    std::vector<uint32_t> order;
+    order.reserve(faceCount);
+
+    std::vector<bool> taken(faceCount, false);
+
+    // cluster a face was last looked at for
+    std::vector<uint32_t> seen(faceCount, kNone);
+
+    mesh.meshlets.clear();
+
+    for (auto const & [ lo, hi ] : ranges)
+    {
+        for (size_t seed = lo; seed < hi; seed++)
+        {
+            if (taken[seed]) {
+                continue;
+            }
+
+            auto const id = static_cast<uint32_t>(mesh.meshlets.size());
+
+            Meshlet m{};
+            m.firstFace = order.size();
+
+            Vec3 sum = {};
+
+            // order doubles as the breadth first queue
+            auto const add = [&](size_t const f) {
+                taken[f] = true;
+                seen[f] = id;
+                sum = sum + normals[f];
+                order.push_back(static_cast<uint32_t>(f));
+                m.faceCount++;
+            };
+
+            add(seed);
+
+            for (auto next = m.firstFace; next < order.size() && m.faceCount < opts.maxFaces; next++)
+            {
+                auto const * I = mesh.indices.data() + 3 * order[next];
+
+                for (size_t k = 0; k < 3 && m.faceCount < opts.maxFaces; k++)
+                {
+                    for (auto a = start[I[k]]; a < start[I[k] + 1] && m.faceCount < opts.maxFaces; a++)
+                    {
+                        auto const f = around[a];
+
+                        if (f < lo || f >= hi || taken[f] || seen[f] == id) {
+                            continue;
+                        }
+
+                        seen[f] = id;
+
+                        // degenerate faces go anywhere
+                        auto const len = length(sum);
+
+                        if (dot(normals[f], normals[f]) > 0 && len > 0 &&
+                            dot(normals[f], sum) < opts.minConeDot * len) {
+                            continue;
+                        }
+
+                        add(f);
+                    }
+                }
+            }
+
+            mesh.meshlets.push_back(m);
+        }
+    }
+
+    decltype(mesh.indices) indices;
+    decltype(mesh.faceMtls) faceMtls;
+
+    indices.reserve(mesh.indices.size());
+    faceMtls.reserve(faceCount);
+
+    for (auto const f : order)
+    {
+        indices.insert(indices.end(), mesh.indices.begin() + 3 * f, mesh.indices.begin() + 3 * f + 3);
+        faceMtls.push_back(mesh.faceMtls[f]);
+    }
+
+    mesh.indices.swap(indices);
+    mesh.faceMtls.swap(faceMtls);
+
+    for (auto & m : mesh.meshlets) {
+        fitMeshlet(m, mesh.indices.data(), pos);
+    }
+}
+
+} // namespace CxxRay
+
+#endif
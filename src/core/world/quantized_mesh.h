@@ -0,0 +1,284 @@
+#ifndef CXXRAY_QUANTIZED_MESH_H
+#define CXXRAY_QUANTIZED_MESH_H
+
+#include "world/indexed_mesh.h"
+#include "world/meshlets.h"
+#include "linalg/linalg.h"
+#include "utils/mem_stats.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace CxxRay {
+
+// 16 byte vertex of a quantized mesh
+//
+// - pos: 16 bits per axis across the mesh bounding box
+// - oct: unit normal folded onto an octahedron, 16 bit
+//   signed fractions per coordinate
+// - uv: 16 bits per coordinate across the mesh uv range
+struct QuantizedVertex
+{
+    uint16_t pos[3] = {0, 0, 0};
+    int16_t oct[2] = {0, 0};
+    uint16_t uv[2] = {0, 0};
+    uint16_t pad = 0;
+};
+
+static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex should stay 16 bytes");
+
+// indexed mesh with quantized vertexes, a quarter the
+// vertex memory of IndexedMesh, vertexes are decoded
+// when drawn
+//
+// normals come back unit length whatever their length
+// in the source mesh
+struct QuantizedMesh
+{
+    MeshVector<QuantizedVertex> vertices = {};
+    MeshVector<uint32_t> indices = {};
+    MeshVector<uint32_t> faceMtls = {};
+
+    std::vector<MeshMtl> mtls = {};
+
+    std::vector<MeshPart> parts = {};
+    std::vector<Meshlet> meshlets = {};
+
+    // decoded value = min + code * step
+    Vec3 posMin = {};
+    Vec3 posStep = {};
+
+    Real uMin = 0.0;
+    Real uStep = 0.0;
+    Real vMin = 0.0;
+    Real vStep = 0.0;
+
+    size_t faceCount() const
+    {
+        return indices.size() / 3;
+    }
+
+    MeshMtl const & faceMtl(size_t const i) const
+    {
+        return mtls[faceMtls[i]];
+    }
+};
+
+namespace quantize {
+
+    constexpr Real kMaxCode = 65535.0;
+    constexpr Real kMaxSnorm = 32767.0;
+
+    inline
+    uint16_t
+    toUnorm16(
+        Real const val,
+        Real const min,
+        Real const step)
+    {
+        if (step <= 0.0) {
+            return 0;
+        }
+
+        auto const code = std::round((val - min) / step);
+
+        return static_cast<uint16_t>(std::clamp(code, 0.0, kMaxCode));
+    }
+
+    inline
+    int16_t
+    toSnorm16(
+        Real const val)
+    {
+        auto const code = std::round(std::clamp(val, -1.0, 1.0) * kMaxSnorm);
+
+        return static_cast<int16_t>(code);
+    }
+
+    inline
+    Real
+    signNotZero(
+        Real const val)
+    {
+        return val >= 0.0 ? 1.0 : -1.0;
+    }
+
+    // project the normal onto the octahedron |x|+|y|+|z| = 1
+    // and fold the lower half over the upper one
+    inline
+    void
+    octEncode(
+        Vec3 const & n,
+        int16_t out[2])
+    {
+        auto const len1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+
+        if (len1 <= 0.0) {
+            out[0] = 0;
+            out[1] = 0;
+            return;
+        }
+
+        Real x = n.x / len1;
+        Real y = n.y / len1;
+
+        if (n.z < 0.0)
+        {
+            auto const fx = (1.0 - std::abs(y)) * signNotZero(x);
+            auto const fy = (1.0 - std::abs(x)) * signNotZero(y);
+
+            x = fx;
+            y = fy;
+        }
+
+        out[0] = toSnorm16(x);
+        out[1] = toSnorm16(y);
+    }
+
+    inline
+    Vec3
+    octDecode(
+        int16_t const in[2])
+    {
+        Real x = static_cast<Real>(in[0]) / kMaxSnorm;
+        Real y = static_cast<Real>(in[1]) / kMaxSnorm;
+        Real const z = 1.0 - std::abs(x) - std::abs(y);
+
+        if (z < 0.0)
+        {
+            auto const fx = (1.0 - std::abs(y)) * signNotZero(x);
+            auto const fy = (1.0 - std::abs(x)) * signNotZero(y);
+
+            x = fx;
+            y = fy;
+        }
+
+        return unit(Vec3{x, y, z});
+    }
+
+    inline
+    void
+    rangeStep(
+        Real const min,
+        Real const max,
+        Real & step)
+    {
+        step = max > min ? (max - min) / kMaxCode : 0.0;
+    }
+
+} // namespace quantize
+
+inline
+Vec3
+decodePosition(
+    QuantizedMesh const & mesh,
+    QuantizedVertex const & q)
+{
+    return Vec3{
+        mesh.posMin.x + q.pos[0] * mesh.posStep.x,
+        mesh.posMin.y + q.pos[1] * mesh.posStep.y,
+        mesh.posMin.z + q.pos[2] * mesh.posStep.z
+    };
+}
+
+inline
+QuantizedMesh
+quantizeMesh(
+    IndexedMesh const & mesh)
+{
+    using namespace quantize;
+
+    QuantizedMesh out;
+
+    out.indices = mesh.indices;
+    out.faceMtls = mesh.faceMtls;
+    out.mtls = mesh.mtls;
+    out.parts = mesh.parts;
+
+    if (mesh.vertices.empty()) {
+        return out;
+    }
+
+    auto lo = mesh.vertices[0];
+    auto hi = mesh.vertices[0];
+
+    for (auto const & vtx : mesh.vertices)
+    {
+        lo.pos.x = std::min(lo.pos.x, vtx.pos.x); hi.pos.x = std::max(hi.pos.x, vtx.pos.x);
+        lo.pos.y = std::min(lo.pos.y, vtx.pos.y); hi.pos.y = std::max(hi.pos.y, vtx.pos.y);
+        lo.pos.z = std::min(lo.pos.z, vtx.pos.z); hi.pos.z = std::max(hi.pos.z, vtx.pos.z);
+        lo.u = std::min(lo.u, vtx.u); hi.u = std::max(hi.u, vtx.u);
+        lo.v = std::min(lo.v, vtx.v); hi.v = std::max(hi.v, vtx.v);
+    }
+
+    out.posMin = lo.pos;
+    out.uMin = lo.u;
+    out.vMin = lo.v;
+
+    rangeStep(lo.pos.x, hi.pos.x, out.posStep.x);
+    rangeStep(lo.pos.y, hi.pos.y, out.posStep.y);
+    rangeStep(lo.pos.z, hi.pos.z, out.posStep.z);
+    rangeStep(lo.u, hi.u, out.uStep);
+    rangeStep(lo.v, hi.v, out.vStep);
+
+    // decoded positions move by up to half a step
+    for (auto & part : out.parts)
+    {
+        if (!part.bounds.empty()) {
+            part.bounds.radius += 0.5 * length(out.posStep);
+        }
+    }
+
+    out.vertices.reserve(mesh.vertices.size());
+
+    for (auto const & vtx : mesh.vertices)
+    {
+        QuantizedVertex q{};
+
+        q.pos[0] = toUnorm16(vtx.pos.x, out.posMin.x, out.posStep.x);
+        q.pos[1] = toUnorm16(vtx.pos.y, out.posMin.y, out.posStep.y);
+        q.pos[2] = toUnorm16(vtx.pos.z, out.posMin.z, out.posStep.z);
+
+        octEncode(vtx.norm, q.oct);
+
+        q.uv[0] = toUnorm16(vtx.u, out.uMin, out.uStep);
+        q.uv[1] = toUnorm16(vtx.v, out.vMin, out.vStep);
+
+        out.vertices.push_back(q);
+    }
+
+    // decoded positions tilt the faces a little, so the
+    // meshlets are fitted again to what is drawn
+    out.meshlets = mesh.meshlets;
+
+    for (auto & m : out.meshlets)
+    {
+        meshlets::fitMeshlet(m, out.indices.data(), [&out](uint32_t const v) {
+            return decodePosition(out, out.vertices[v]);
+        });
+    }
+
+    return out;
+}
+
+inline
+MeshVertex
+decodeVertex(
+    QuantizedMesh const & mesh,
+    QuantizedVertex const & q)
+{
+    using namespace quantize;
+
+    return MeshVertex{
+        decodePosition(mesh, q),
+        octDecode(q.oct),
+        mesh.uMin + q.uv[0] * mesh.uStep,
+        mesh.vMin + q.uv[1] * mesh.vStep
+    };
+}
+
+} // namespace CxxRay
+
+#endif
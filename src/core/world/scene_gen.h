@@ -0,0 +1,531 @@
+#ifndef CXXRAY_SCENE_GEN_H
+#define CXXRAY_SCENE_GEN_H
+
+#include "world/mesh.h"
+#include "image/texture_image.h"
+#include "linalg/linalg.h"
+#include "utils/rand.h"
+#include "rgb/rgb.h"
+
+#include "global/global.h"
+
+#include <string>
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+namespace CxxRay {
+
+// how triangle sizes are spread across a generated scene
+enum class TriangleSizeDist
+{
+    Uniform, // every triangle roughly the same size
+    Varied   // sizes span a couple of orders of magnitude
+};
+
+enum class SceneShape
+{
+    Icosphere,
+    Terrain
+};
+
+struct SceneGenParams
+{
+    SceneShape shape = SceneShape::Icosphere;
+    TriangleSizeDist sizeDist = TriangleSizeDist::Uniform;
+
+    long triangles = 100000; // approximate total triangle count
+    long instances = 1;      // copies scattered over the ground plane
+    long depthLayers = 1;    // copies stacked above each other
+    long textureCount = 0;   // procedural checker textures to cycle through
+    long textureSize = 256;
+
+    Real extent = 2.0;       // half width of the scattered region
+    unsigned seed = 1;
+};
+
+namespace sceneGen {
+
+    inline
+    long
+    addVertex(
+        Mesh & mesh,
+        Vec3 const & pos,
+        Vec3 const & norm,
+        Real const u,
+        Real const v)
+    {
+        mesh.verts.push_back(pos);
+        mesh.norms.push_back(norm);
+        mesh.uvs.push_back({u, v});
+
+        // obj style indexes are 1-based
+        return static_cast<long>(mesh.verts.size());
+    }
+
+    inline
+    void
+    addFace(
+        Mesh & mesh,
+        uint32_t const mtlId,
+        long const a,
+        long const b,
+        long const c)
+    {
+        // generated vertexes share one index
+        // for position, normal and uv alike
+        mesh.faces.push_back(MeshFace{
+            mtlId,
+            {
+                MeshIndex{a, a, a},
+                MeshIndex{b, b, b},
+                MeshIndex{c, c, c}
+            }
+        });
+    }
+
+    // returns the material's index in the mesh's table
+    inline
+    uint32_t
+    defaultMtl(
+        Mesh & mesh)
+    {
+        MeshMtl mtl{};
+        mtl.diffuse = RgbReal{0.8, 0.8, 0.8};
+
+        mesh.mtls["no_mtl"] = mtl;
+
+        return addFaceMtl(mesh, mtl, "no_mtl");
+    }
+
+    inline
+    Vec3
+    sphereUnit(
+        Vec3 const & p)
+    {
+        return unit(p);
+    }
+
+    inline
+    std::tuple<Real,Real>
+    sphereUv(
+        Vec3 const & n)
+    {
+        constexpr Real kPi = 3.14159265358979323846;
+
+        auto const u = 0.5 + std::atan2(n.y, n.x) / (2.0 * kPi);
+        auto const v = 0.5 + std::asin(std::clamp(n.z, -1.0, 1.0)) / kPi;
+
+        return {u, v};
+    }
+
+    inline
+    TextureImage
+    makeCheckerTexture(
+        long const size,
+        long const squares,
+        Rgb const & a,
+        Rgb const & b)
+    {
+        TextureImage img{size, size};
+
+        long const cell = size / squares > 0 ? size / squares : 1;
+
+        for (long y = 0; y < size; y++)
+        {
+            for (long x = 0; x < size; x++)
+            {
+                bool const odd = ((x / cell) + (y / cell)) % 2 == 1;
+
+                img.pixels[y * size + x] = odd ? a : b;
+            }
+        }
+
+        return img;
+    }
+
+} // namespace sceneGen
+
+// subdivided icosahedron, each level of subdivision
+// quadruples the triangle count, 20 * 4^subdivisions
+inline
+Mesh
+makeIcosphere(
+    long const subdivisions,
+    Real const radius = 1.0)
+{
+    using namespace sceneGen;
+
+    using std::vector;
+    using std::unordered_map;
+
+    Real const t = (1.0 + std::sqrt(5.0)) / 2.0;
+
+    vector<Vec3> pts = {
+        {-1,  t,  0}, { 1,  t,  0}, {-1, -t,  0}, { 1, -t,  0},
+        { 0, -1,  t}, { 0,  1,  t}, { 0, -1, -t}, { 0,  1, -t},
+        { t,  0, -1}, { t,  0,  1}, {-t,  0, -1}, {-t,  0,  1}
+    };
+
+    for (auto & p : pts) {
+        p = sphereUnit(p);
+    }
+
+    vector<std::array<long,3>> tris = {
+        {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+        {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+        {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+        {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}
+    };
+
+    for (long level = 0; level < subdivisions; level++)
+    {
+        // each edge is split once, shared edges
+        // look up the midpoint made by the neighbour
+        unordered_map<long long,long> midpoints;
+        midpoints.reserve(tris.size() * 2);
+
+        auto const midpoint = [&pts, &midpoints](long const a, long const b) {
+            auto const lo = a < b ? a : b;
+            auto const hi = a < b ? b : a;
+            auto const key = (static_cast<long long>(lo) << 32) | hi;
+
+            auto const found = midpoints.find(key);
+
+            if (found != midpoints.end()) {
+                return found->second;
+            }
+
+            pts.push_back(sphereUnit((pts[lo] + pts[hi]) * 0.5));
+
+            auto const id = static_cast<long>(pts.size()) - 1;
+            midpoints[key] = id;
+
+            return id;
+        };
+
+        vector<std::array<long,3>> next;
+        next.reserve(tris.size() * 4);
+
+        for (auto const & tri : tris)
+        {
+            auto const ab = midpoint(tri[0], tri[1]);
+            auto const bc = midpoint(tri[1], tri[2]);
+            auto const ca = midpoint(tri[2], tri[0]);
+
+            next.push_back({tri[0], ab, ca});
+            next.push_back({tri[1], bc, ab});
+            next.push_back({tri[2], ca, bc});
+            next.push_back({ab, bc, ca});
+        }
+
+        tris.swap(next);
+    }
+
+    Mesh mesh;
+    auto const mtl = defaultMtl(mesh);
+
+    mesh.verts.reserve(pts.size());
+    mesh.norms.reserve(pts.size());
+    mesh.uvs.reserve(pts.size());
+    mesh.faces.reserve(tris.size());
+
+    for (auto const & p : pts)
+    {
+        auto const [ u, v ] = sphereUv(p);
+
+        addVertex(mesh, p * radius, p, u, v);
+    }
+
+    // faces wind counter clockwise seen from outside
+    for (auto const & tri : tris) {
+        addFace(mesh, mtl, tri[0] + 1, tri[1] + 1, tri[2] + 1);
+    }
+
+    return mesh;
+}
+
+// a height field over the x/y plane made of nx by ny
+// quads, two triangles each, with a few overlapping
+// sine waves for some relief
+//
+// with a varied size distribution the cell spacing
+// grows along x so the triangles on the far side are
+// many times larger than those on the near side
+inline
+Mesh
+makeTerrainGrid(
+    long const nx,
+    long const ny,
+    Real const sizeX = 2.0,
+    Real const sizeY = 2.0,
+    Real const amplitude = 0.1,
+    TriangleSizeDist const sizeDist = TriangleSizeDist::Uniform)
+{
+    using namespace sceneGen;
+
+    // exponential spacing makes the last cell
+    // about fifty times wider than the first
+    auto const spacing = [sizeDist](Real const t) {
+        return sizeDist == TriangleSizeDist::Varied
+            ? (std::exp(4.0 * t) - 1.0) / (std::exp(4.0) - 1.0)
+            : t;
+    };
+
+    auto const height = [amplitude](Real const x, Real const y) {
+        return amplitude * (
+            std::sin(x * 3.1) * std::cos(y * 2.3) +
+            0.5 * std::sin(x * 7.7 + y * 5.3)
+        );
+    };
+
+    Mesh mesh;
+    auto const mtl = defaultMtl(mesh);
+
+    auto const nverts = static_cast<size_t>((nx + 1) * (ny + 1));
+
+    mesh.verts.reserve(nverts);
+    mesh.norms.reserve(nverts);
+    mesh.uvs.reserve(nverts);
+    mesh.faces.reserve(static_cast<size_t>(nx * ny * 2));
+
+    Real const eps = 1e-4;
+
+    for (long j = 0; j <= ny; j++)
+    {
+        auto const v = static_cast<Real>(j) / static_cast<Real>(ny);
+        auto const y = (v - 0.5) * sizeY;
+
+        for (long i = 0; i <= nx; i++)
+        {
+            auto const u = static_cast<Real>(i) / static_cast<Real>(nx);
+            auto const x = (spacing(u) - 0.5) * sizeX;
+
+            // normal from the central differences of the height field
+            auto const dx = (height(x + eps, y) - height(x - eps, y)) / (2.0 * eps);
+            auto const dy = (height(x, y + eps) - height(x, y - eps)) / (2.0 * eps);
+
+            addVertex(mesh,
+                Vec3{x, y, height(x, y)},
+                unit(Vec3{-dx, -dy, 1.0}),
+                u, v);
+        }
+    }
+
+    for (long j = 0; j < ny; j++)
+    {
+        for (long i = 0; i < nx; i++)
+        {
+            auto const a = j * (nx + 1) + i + 1;
+            auto const b = a + 1;
+            auto const c = a + (nx + 1);
+            auto const d = c + 1;
+
+            addFace(mesh, mtl, a, b, d);
+            addFace(mesh, mtl, a, d, c);
+        }
+    }
+
+    return mesh;
+}
+
+// append a scaled and translated copy of src to dst,
+// the copy's faces are given dst's material mtlId and
+// become a part of dst
+inline
+void
+appendMeshInstance(
+    Mesh & dst,
+    Mesh const & src,
+    Vec3 const & offset,
+    Real const scale,
+    uint32_t const mtlId)
+{
+    // parts must cover every face
+    if (dst.parts.empty() && !dst.faces.empty())
+    {
+        MeshPart rest{};
+        rest.faceCount = dst.faces.size();
+        rest.bounds = faceBounds(dst.faces, 0, dst.faces.size(), dst.verts, dst.verts.size());
+
+        dst.parts.push_back(rest);
+    }
+
+    auto const vbase = static_cast<long long>(dst.verts.size());
+    auto const nbase = static_cast<long long>(dst.norms.size());
+    auto const tbase = static_cast<long long>(dst.uvs.size());
+
+    for (auto const & v : src.verts) {
+        dst.verts.push_back(v * scale + offset);
+    }
+
+    dst.norms.insert(dst.norms.end(), src.norms.begin(), src.norms.end());
+    dst.uvs.insert(dst.uvs.end(), src.uvs.begin(), src.uvs.end());
+
+    for (auto const & face : src.faces)
+    {
+        MeshFace copy{mtlId, face.vertexIndexes};
+
+        for (auto & I : copy.vertexIndexes)
+        {
+            I.id += vbase;
+            I.normId += nbase;
+            I.uvId += tbase;
+        }
+
+        dst.faces.push_back(copy);
+    }
+
+    MeshPart part{};
+    part.name = "instance_" + std::to_string(dst.parts.size());
+    part.firstFace = dst.faces.size() - src.faces.size();
+    part.faceCount = src.faces.size();
+    part.bounds = faceBounds(dst.faces, part.firstFace, part.faceCount, dst.verts, dst.verts.size());
+
+    dst.parts.push_back(part);
+}
+
+// add procedural checker textures to the texture
+// map and return the names they were stored under
+inline
+std::vector<std::string>
+generateTextures(
+    long const count,
+    long const size,
+    TextureMap & textures)
+{
+    using std::string;
+    using std::to_string;
+
+    std::vector<string> names;
+
+    for (long i = 0; i < count; i++)
+    {
+        auto const name = "gen_tex_" + to_string(i);
+
+        // vary square count and colors so
+        // each texture is distinguishable
+        auto const squares = 4 + 4 * (i % 4);
+        auto const shade = static_cast<int>(60 + (i * 37) % 160);
+
+        textures[name] = makeTextureHandle(sceneGen::makeCheckerTexture(size, squares,
+            Rgb{shade, 255 - shade, 128},
+            Rgb{240, 240, 240}));
+
+        names.push_back(name);
+    }
+
+    return names;
+}
+
+// build a whole scene from the parameters above
+//
+// the triangle budget is divided among instances and
+// depth layers, each instance is scattered randomly over
+// the x/y ground plane within the extent and each depth
+// layer stacks another full set of instances above the
+// last so the same screen area is covered several times
+inline
+Mesh
+generateScene(
+    SceneGenParams const & params,
+    TextureMap & textures)
+{
+    using std::to_string;
+
+    auto const instances = params.instances > 0 ? params.instances : 1;
+    auto const layers = params.depthLayers > 0 ? params.depthLayers : 1;
+
+    auto const copies = instances * layers;
+    auto const budget = static_cast<Real>(params.triangles) / static_cast<Real>(copies);
+
+    Mesh proto;
+
+    if (params.shape == SceneShape::Icosphere)
+    {
+        // 20 * 4^s triangles, pick the closest level
+        auto const level = std::log(std::max(budget / 20.0, 1.0)) / std::log(4.0);
+
+        proto = makeIcosphere(static_cast<long>(std::round(level)));
+    }
+    else
+    {
+        // 2 * n^2 triangles
+        auto const n = static_cast<long>(std::max(std::round(std::sqrt(budget / 2.0)), 1.0));
+
+        proto = makeTerrainGrid(n, n, 2.0, 2.0, 0.1, params.sizeDist);
+    }
+
+    Mesh mesh;
+
+    auto const texNames = generateTextures(params.textureCount, params.textureSize, textures);
+
+    std::vector<uint32_t> mtls;
+
+    if (texNames.empty())
+    {
+        mtls.push_back(sceneGen::defaultMtl(mesh));
+    }
+
+    for (size_t i = 0; i < texNames.size(); i++)
+    {
+        MeshMtl mtl{};
+        mtl.diffuse = RgbReal{0.8, 0.8, 0.8};
+        mtl.texName = texNames[i];
+
+        auto const name = "gen_mtl_" + to_string(i);
+
+        mesh.mtls[name] = mtl;
+        mtls.push_back(addFaceMtl(mesh, mtl, name));
+    }
+
+    auto const total = proto.faces.size() * static_cast<size_t>(copies);
+    auto const totalVerts = proto.verts.size() * static_cast<size_t>(copies);
+
+    mesh.faces.reserve(total);
+    mesh.verts.reserve(totalVerts);
+    mesh.norms.reserve(totalVerts);
+    mesh.uvs.reserve(totalVerts);
+
+    // scale instances so they roughly tile the extent
+    auto const cells = std::ceil(std::sqrt(static_cast<Real>(instances)));
+    auto const baseScale = params.extent / cells;
+
+    Real const ext = params.extent;
+
+    RandReal<Real> randPos{-ext, ext, params.seed};
+    RandReal<Real> randScale{std::log(0.1), 0.0, params.seed + 1};
+
+    long copy = 0;
+
+    for (long layer = 0; layer < layers; layer++)
+    {
+        auto const z = static_cast<Real>(layer) * baseScale * 2.0;
+
+        for (long i = 0; i < instances; i++)
+        {
+            auto const scale = params.sizeDist == TriangleSizeDist::Varied
+                ? baseScale * std::exp(get(randScale))
+                : baseScale;
+
+            // a single instance stays centered
+            auto const offset = instances == 1
+                ? Vec3{0.0, 0.0, z}
+                : Vec3{get(randPos), get(randPos), z};
+
+            auto const mtlId = mtls[static_cast<size_t>(copy) % mtls.size()];
+
+            appendMeshInstance(mesh, proto, offset, scale, mtlId);
+
+            copy++;
+        }
+    }
+
+    return mesh;
+}
+
+} // namespace CxxRay
+
+#endif
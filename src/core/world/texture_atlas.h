@@ -0,0 +1,475 @@
+#ifndef CXXRAY_TEXTURE_ATLAS_H
+#define CXXRAY_TEXTURE_ATLAS_H
+
+#include "world/mesh.h"
+#include "image/texture_image.h"
+#include "image/texture_compress.h"
+#include "image/mipmap.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace CxxRay {
+
+struct AtlasOptions
+{
+    // textures larger than this on either side stay apart
+    long maxTexSize = 256;
+
+    // widest and tallest an atlas gets
+    long atlasSize = 2048;
+
+    // edge texels repeated around each texture so filtering
+    // never reads a neighbor, covers the first log2(padding)
+    // mip levels
+    long padding = 4;
+
+    // layout and format the atlases are stored in
+    TexelLayout layout = TexelLayout::RowMajor;
+    TextureFormat format = TextureFormat::Rgb8;
+
+    // keep level 0 of each atlas as it was before being
+    // compressed, to measure what compressing cost
+    bool keepUncompressed = false;
+};
+
+// where a texture's texels sit in an atlas, the padding
+// is around the rect
+struct AtlasRect
+{
+    long atlas = 0;
+    long x = 0;
+    long y = 0;
+    long w = 0;
+    long h = 0;
+};
+
+struct AtlasResult
+{
+    std::vector<std::string> atlases = {};
+
+    // textures merged into an atlas, dropped from the map
+    std::vector<std::string> merged = {};
+
+    // level 0 of each atlas before compression, in the
+    // order of atlases, when the options ask for it
+    std::vector<std::vector<Rgb>> uncompressed = {};
+};
+
+namespace texAtlas {
+
+    // cells start on block boundaries so no BC1 block
+    // straddles two textures
+    constexpr long kCellAlign = 4;
+
+    inline
+    long
+    alignCell(
+        long const n)
+    {
+        return (n + kCellAlign - 1) / kCellAlign * kCellAlign;
+    }
+
+    inline
+    long
+    roundUpPow2(
+        long const n)
+    {
+        long p = 1;
+
+        while (p < n) {
+            p *= 2;
+        }
+
+        return p;
+    }
+
+    // next fit shelf packing of w x h rects, tallest first,
+    // each shelf is as tall as its first rect and a new
+    // atlas is started when a shelf no longer fits
+    //
+    // sizes receives the width and height of each atlas
+    inline
+    std::vector<AtlasRect>
+    packShelves(
+        std::vector<std::tuple<long,long>> const & rects,
+        long const atlasSize,
+        long const padding,
+        std::vector<std::tuple<long,long>> & sizes)
+    {
+        std::vector<AtlasRect> out(rects.size());
+
+        std::vector<size_t> order(rects.size());
+        std::iota(order.begin(), order.end(), size_t{0});
+
+        std::stable_sort(order.begin(), order.end(), [&rects](size_t const a, size_t const b) {
+            return std::get<1>(rects[a]) != std::get<1>(rects[b])
+                ? std::get<1>(rects[a]) > std::get<1>(rects[b])
+                : std::get<0>(rects[a]) > std::get<0>(rects[b]);
+        });
+
+        sizes.clear();
+
+        long shelfX = 0;
+        long shelfY = 0;
+        long shelfH = 0;
+
+        for (auto const i : order)
+        {
+            auto const [ w, h ] = rects[i];
+
+            auto const cw = alignCell(w + 2 * padding);
+            auto const ch = alignCell(h + 2 * padding);
+
+            if (sizes.empty() || (shelfX + cw > atlasSize && shelfY + shelfH + ch > atlasSize))
+            {
+                sizes.push_back({0, 0});
+
+                shelfX = 0;
+                shelfY = 0;
+                shelfH = ch;
+            }
+            else if (shelfX + cw > atlasSize)
+            {
+                shelfX = 0;
+                shelfY += shelfH;
+                shelfH = ch;
+            }
+
+            out[i] = AtlasRect{static_cast<long>(sizes.size()) - 1, shelfX + padding, shelfY + padding, w, h};
+
+            shelfX += cw;
+
+            auto & [ aw, ah ] = sizes.back();
+
+            aw = std::max(aw, shelfX);
+            ah = std::max(ah, shelfY + shelfH);
+        }
+
+        // power of 2 sides keep the uv scale a change of
+        // exponent, so texel edges line up with the texture's
+        // own up to rounding, a uv right on an edge may still
+        // pick the texel next to it
+        for (auto & [ aw, ah ] : sizes)
+        {
+            aw = std::min(roundUpPow2(aw), atlasSize);
+            ah = std::min(roundUpPow2(ah), atlasSize);
+        }
+
+        return out;
+    }
+
+    // copy a texture's level 0 into its rect, repeating its
+    // edge texels out over the padding
+    inline
+    void
+    copyPadded(
+        TextureImage const & tex,
+        AtlasRect const & rect,
+        long const padding,
+        Rgb * pixels,
+        long const atlasW)
+    {
+        for (long y = -padding; y < rect.h + padding; y++)
+        {
+            auto const sy = std::clamp(y, 0l, rect.h - 1);
+
+            Rgb * row = pixels + (rect.y + y) * atlasW + rect.x;
+
+            for (long x = -padding; x < rect.w + padding; x++) {
+                row[x] = tex.texel(std::clamp(x, 0l, rect.w - 1), sy);
+            }
+        }
+    }
+
+    // the shader clamps uv to [0, 1] of the whole texture,
+    // coordinates past the edge would then reach into the
+    // neighbors so textures used with them are left out
+    inline
+    bool
+    uvInRange(
+        std::tuple<Real,Real> const & uv)
+    {
+        constexpr Real kSlack = 1e-4;
+
+        auto const [ u, v ] = uv;
+
+        return u >= -kSlack && u <= 1 + kSlack && v >= -kSlack && v <= 1 + kSlack;
+    }
+}
+
+// pack the small textures a mesh's faces use into shared
+// atlases so the fragment stage switches between far fewer
+// textures, the uvs of their faces are moved into the
+// atlas rect, a uv shared by faces that end up in
+// different textures is duplicated
+//
+// level 0 samples exactly as before, the lower mip levels
+// are rebuilt from the atlas
+//
+// sources holds uncompressed copies of compressed textures
+// by name, atlases are filled from those so a compressed
+// atlas loses detail to compression only once, when the
+// atlas is compressed a compressed texture with no source
+// is left out
+inline
+AtlasResult
+buildTextureAtlases(
+    Mesh & mesh,
+    TextureMap & textures,
+    AtlasOptions const & opts = {},
+    TextureMap const & sources = {})
+{
+    using namespace texAtlas;
+
+    using std::string;
+
+    AtlasResult result;
+
+    auto const uvCount = static_cast<long long>(mesh.uvs.size());
+
+    // which textures can be merged, in first use order
+    std::unordered_map<string,long> slot;
+    std::vector<string> names;
+    std::vector<bool> mergeable;
+
+    // texels a texture is copied into its atlas from
+    auto const sourceOf = [&textures, &sources](string const & texName) -> TextureImage const * {
+        auto const source = sources.find(texName);
+
+        if (source != sources.end()) {
+            return source->second.get();
+        }
+
+        auto const found = textures.find(texName);
+
+        return found != textures.end() ? found->second.get() : nullptr;
+    };
+
+    for (auto const & face : mesh.faces)
+    {
+        auto const & texName = mesh.mtlTable[face.mtlId].texName;
+
+        if (texName == "") {
+            continue;
+        }
+
+        auto [ at, added ] = slot.try_emplace(texName, static_cast<long>(names.size()));
+
+        if (added)
+        {
+            auto const * const tex = sourceOf(texName);
+
+            bool const recompressed = tex != nullptr
+                && tex->format != TextureFormat::Rgb8 && opts.format != TextureFormat::Rgb8;
+
+            names.push_back(texName);
+            mergeable.push_back(tex != nullptr && !recompressed && !tex->tiled() && tex->w > 0 && tex->h > 0
+                && tex->w <= opts.maxTexSize && tex->h <= opts.maxTexSize
+                && alignCell(tex->w + 2 * opts.padding) <= opts.atlasSize
+                && alignCell(tex->h + 2 * opts.padding) <= opts.atlasSize);
+        }
+
+        auto const t = static_cast<size_t>(at->second);
+
+        for (auto const & I : face.vertexIndexes)
+        {
+            if (mergeable[t] && (I.uvId < 1 || I.uvId > uvCount || !uvInRange(mesh.uvs[static_cast<size_t>(I.uvId - 1)]))) {
+                mergeable[t] = false;
+            }
+        }
+    }
+
+    std::vector<long> entry(names.size(), -1);
+    std::vector<std::tuple<long,long>> sizes;
+
+    for (size_t t = 0; t < names.size(); t++)
+    {
+        if (mergeable[t])
+        {
+            auto const & tex = *sourceOf(names[t]);
+
+            entry[t] = static_cast<long>(sizes.size());
+            sizes.push_back({tex.w, tex.h});
+        }
+    }
+
+    // one texture gains nothing from an atlas
+    if (sizes.size() < 2) {
+        return result;
+    }
+
+    std::vector<std::tuple<long,long>> atlasSizes;
+
+    auto const rects = packShelves(sizes, opts.atlasSize, opts.padding, atlasSizes);
+
+    std::vector<TextureImage> atlases;
+
+    for (auto const & [ aw, ah ] : atlasSizes)
+    {
+        atlases.emplace_back(aw, ah);
+
+        std::fill(atlases.back().pixels, atlases.back().pixels + aw * ah, Rgb{0});
+    }
+
+    for (size_t t = 0; t < names.size(); t++)
+    {
+        if (entry[t] < 0) {
+            continue;
+        }
+
+        auto const & rect = rects[static_cast<size_t>(entry[t])];
+        auto & atlas = atlases[static_cast<size_t>(rect.atlas)];
+
+        copyPadded(*sourceOf(names[t]), rect, opts.padding, atlas.pixels, atlas.w);
+    }
+
+    for (size_t a = 0; a < atlases.size(); a++)
+    {
+        auto & atlas = atlases[a];
+
+        if (opts.keepUncompressed) {
+            result.uncompressed.emplace_back(atlas.pixels, atlas.pixels + atlas.w * atlas.h);
+        }
+
+        generateMips(atlas);
+
+        if (opts.format == TextureFormat::Bc1) {
+            compressTexture(atlas);
+        } else {
+            relayoutTexture(atlas, opts.layout);
+        }
+
+        string name = "atlas_" + std::to_string(a);
+
+        while (textures.count(name) > 0) {
+            name += "_";
+        }
+
+        textures[name] = makeTextureHandle(std::move(atlas));
+        result.atlases.push_back(name);
+    }
+
+    // a uv is moved in place when only one merged texture
+    // uses it, otherwise each merged texture gets a copy
+    constexpr long kUnused = -1;
+    constexpr long kShared = -2;
+
+    std::vector<long> owner(static_cast<size_t>(uvCount), kUnused);
+
+    // entry of the texture in the atlases, -1 if not merged
+    auto const entryOf = [&slot, &entry](string const & texName) {
+        auto const found = texName != "" ? slot.find(texName) : slot.end();
+
+        return found != slot.end() ? entry[static_cast<size_t>(found->second)] : -1l;
+    };
+
+    for (auto const & face : mesh.faces)
+    {
+        // faces left out of the atlases keep the old uvs
+        auto const merged = entryOf(mesh.mtlTable[face.mtlId].texName);
+        auto const e = merged >= 0 ? merged : kShared;
+
+        for (auto const & I : face.vertexIndexes)
+        {
+            if (I.uvId < 1 || I.uvId > uvCount) {
+                continue;
+            }
+
+            auto & o = owner[static_cast<size_t>(I.uvId - 1)];
+
+            o = o == kUnused || o == e ? e : kShared;
+        }
+    }
+
+    auto const original = mesh.uvs;
+
+    auto const toAtlas = [&](std::tuple<Real,Real> const & uv, AtlasRect const & rect) {
+        auto const [ aw, ah ] = atlasSizes[static_cast<size_t>(rect.atlas)];
+
+        auto const u = std::clamp(std::get<0>(uv), 0.0, 1.0);
+        auto const v = std::clamp(std::get<1>(uv), 0.0, 1.0);
+
+        return std::tuple<Real,Real>{
+            (static_cast<Real>(rect.x) + u * static_cast<Real>(rect.w)) / static_cast<Real>(aw),
+            (static_cast<Real>(rect.y) + v * static_cast<Real>(rect.h)) / static_cast<Real>(ah),
+        };
+    };
+
+    for (size_t i = 0; i < owner.size(); i++)
+    {
+        if (owner[i] >= 0) {
+            mesh.uvs[i] = toAtlas(original[i], rects[static_cast<size_t>(owner[i])]);
+        }
+    }
+
+    // copies of shared uvs by (uv, entry)
+    std::unordered_map<uint64_t,long long> copies;
+
+    for (auto & face : mesh.faces)
+    {
+        auto const e = entryOf(mesh.mtlTable[face.mtlId].texName);
+
+        if (e < 0) {
+            continue;
+        }
+
+        auto const & rect = rects[static_cast<size_t>(e)];
+
+        for (auto & I : face.vertexIndexes)
+        {
+            auto const i = static_cast<size_t>(I.uvId - 1);
+
+            if (owner[i] == kShared)
+            {
+                auto const key = (static_cast<uint64_t>(i) << 24) | static_cast<uint64_t>(e);
+
+                auto [ at, added ] = copies.try_emplace(key, 0);
+
+                if (added)
+                {
+                    mesh.uvs.push_back(toAtlas(original[i], rect));
+                    at->second = static_cast<long long>(mesh.uvs.size());
+                }
+
+                I.uvId = at->second;
+            }
+        }
+    }
+
+    // faces keep their material, its texture becomes the atlas
+    auto const retarget = [&](MeshMtl & mtl) {
+        auto const e = entryOf(mtl.texName);
+
+        if (e >= 0) {
+            mtl.texName = result.atlases[static_cast<size_t>(rects[static_cast<size_t>(e)].atlas)];
+        }
+    };
+
+    for (auto & mtl : mesh.mtlTable) {
+        retarget(mtl);
+    }
+
+    for (auto & [ name, mtl ] : mesh.mtls) {
+        retarget(mtl);
+    }
+
+    for (size_t t = 0; t < names.size(); t++)
+    {
+        if (entry[t] >= 0)
+        {
+            textures.erase(names[t]);
+            result.merged.push_back(names[t]);
+        }
+    }
+
+    return result;
+}
+
+} // namespace CxxRay
+
+#endif
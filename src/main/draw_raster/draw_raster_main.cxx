@@ -3,26 +3,43 @@
 #include "raster/draw_scene.h"
 
 #include "loaders/tga.h"
+#include "loaders/image_file.h"
+#include "loaders/mesh_cache.h"
+#include "loaders/ply.h"
 
 #include "world/mesh.h"
+#include "world/mesh_view.h"
+#include "world/indexed_mesh.h"
+#include "world/quantized_mesh.h"
+#include "world/meshlets.h"
 #include "world/camera.h"
 #include "world/view_volume.h"
+#include "world/texture_atlas.h"
 
 #include "image/depth_buf_image.h"
+#include "image/cost_heatmap.h"
+#include "image/async_image_writer.h"
+#include "image/texture_compress.h"
 #include "image/pixel.h"
 
 #include "rgb/rgb.h"
 
 #include "utils/profiler.h"
+#include "utils/stats.h"
+#include "utils/mem_stats.h"
 #include "utils/strings.h"
 
 #include "global/global.h"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <stdexcept>
+#include <charconv>
 
 namespace CxxRay {
 
@@ -44,6 +61,164 @@ getDefaultPath()
     return ((fs::path{"data"} /= "models") /= "monkey.obj").string();
 }
 
+// command line settings, printUsage() explains each one
+struct RasterArgs
+{
+    std::string infile = "";
+    std::string texfile = getDefaultTex();
+
+    long reps = 1;
+    long heatmapTile = 0;
+
+    std::string cacheDir = "";
+    std::string texCacheDir = "";
+
+    long meshFormat = 0;
+    long frameFormat = 0;
+    long tileBudgetKb = 0;
+    long filter = 0;
+    long layout = 0;
+    long format = 0;
+    long atlasMaxTex = 0;
+    long meshletFaces = 0;
+
+    bool cullBackFaces = false;
+    bool help = false;
+};
+
+static
+void
+printUsage()
+{
+    std::cout <<
+        "usage: draw_raster [model] [options]\n"
+        "\n"
+        "  model                    OBJ or PLY file (default data/models/monkey.obj)\n"
+        "  --texture=FILE           texture for every material, empty for the\n"
+        "                           model's own (default the UV checker map)\n"
+        "  --reps=N                 times the scene is drawn (default 1)\n"
+        "  --heatmap-tile=N         per tile cost heatmaps of N pixel tiles (default off)\n"
+        "  --mesh-cache=DIR         binary mesh cache folder (default none)\n"
+        "  --mesh-format=F          loaded, welded or quantized (default loaded)\n"
+        "  --frames=F               save every repetition as tga or qoi (default off)\n"
+        "  --texture-cache=DIR      texture cache folder (default none)\n"
+        "  --tile-budget=KIB        stream textures in tiles within this many KiB\n"
+        "                           (default 0, maps them whole)\n"
+        "  --filter=F               nearest, bilinear or trilinear (default nearest)\n"
+        "  --texel-layout=L         rows or blocks (default rows)\n"
+        "  --texture-format=F       rgb or bc1 (default rgb)\n"
+        "  --atlas-max=N            pack textures up to N texels a side into atlases\n"
+        "                           (default 0, off)\n"
+        "  --meshlet-faces=N        split welded meshes into meshlets of up to N\n"
+        "                           faces (default 0, off)\n"
+        "  --cull-back-faces        leave out faces seen from behind\n"
+        "  --help                   show this text\n";
+}
+
+// options are --name=value or a --name flag, the one
+// argument not starting with -- is the model
+static
+bool
+parseArgs(
+    int const argc,
+    char** argv,
+    RasterArgs & args)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    bool haveModel = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string const arg = argv[i];
+
+        auto const eq = arg.find('=');
+        auto const key = arg.substr(0, eq);
+        auto const value = eq != string::npos ? arg.substr(eq + 1) : string{""};
+        bool const hasValue = eq != string::npos;
+
+        // whole value is a number no less than lo
+        auto const number = [&value, hasValue](long & out, long const lo) {
+            long long n = 0;
+
+            auto const * const first = value.data();
+            auto const * const last = first + value.size();
+
+            auto const [ end, ec ] = std::from_chars(first, last, n);
+
+            if (!hasValue || ec != std::errc{} || end != last || n < lo) {
+                return false;
+            }
+
+            out = static_cast<long>(n);
+
+            return true;
+        };
+
+        // position of the value among the names
+        auto const pick = [&value, hasValue](long & out, std::vector<char const *> const & names) {
+            for (size_t k = 0; hasValue && k < names.size(); k++)
+            {
+                if (value == names[k]) {
+                    out = static_cast<long>(k);
+                    return true;
+                }
+            }
+
+            return false;
+        };
+
+        bool ok = true;
+
+        if (key == "--texture" && hasValue) {
+            args.texfile = value;
+        } else if (key == "--reps") {
+            ok = number(args.reps, 1);
+        } else if (key == "--heatmap-tile") {
+            ok = number(args.heatmapTile, 0);
+        } else if (key == "--mesh-cache" && hasValue) {
+            args.cacheDir = value;
+        } else if (key == "--mesh-format") {
+            ok = pick(args.meshFormat, {"loaded", "welded", "quantized"});
+        } else if (key == "--frames") {
+            ok = pick(args.frameFormat, {"off", "tga", "qoi"});
+        } else if (key == "--texture-cache" && hasValue) {
+            args.texCacheDir = value;
+        } else if (key == "--tile-budget") {
+            ok = number(args.tileBudgetKb, 0);
+        } else if (key == "--filter") {
+            ok = pick(args.filter, {"nearest", "bilinear", "trilinear"});
+        } else if (key == "--texel-layout") {
+            ok = pick(args.layout, {"rows", "blocks"});
+        } else if (key == "--texture-format") {
+            ok = pick(args.format, {"rgb", "bc1"});
+        } else if (key == "--atlas-max") {
+            ok = number(args.atlasMaxTex, 0);
+        } else if (key == "--meshlet-faces") {
+            ok = number(args.meshletFaces, 0);
+        } else if (arg == "--cull-back-faces") {
+            args.cullBackFaces = true;
+        } else if (arg == "--help") {
+            args.help = true;
+        } else if (arg.rfind("--", 0) != 0 && !haveModel) {
+            args.infile = arg;
+            haveModel = true;
+        } else {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            cout << "Invalid argument: " << arg << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
 int drawRasterMain(int argc, char** argv)
 {
     using std::cout;
@@ -51,8 +226,6 @@ int drawRasterMain(int argc, char** argv)
 
     using std::string;
     using std::vector;
-    using std::unordered_map;
-    using std::for_each;
 
     using std::fixed;
     using std::setprecision;
@@ -67,10 +240,22 @@ int drawRasterMain(int argc, char** argv)
     //##########################################################
     // Command Line Arguments
     //##########################################################
-    string infileArg = argc > 1 ? argv[1] : "";
+    RasterArgs args;
 
-    string infile = infileArg != ""
-        ? infileArg
+    if (!parseArgs(argc, argv, args))
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (args.help)
+    {
+        printUsage();
+        return 0;
+    }
+
+    string const infile = args.infile != ""
+        ? args.infile
         : getDefaultPath();
 
     if (!fs::is_regular_file(infile))
@@ -79,9 +264,7 @@ int drawRasterMain(int argc, char** argv)
         return 1;
     }
 
-    string texfile = argc > 2
-        ? argv[2]
-        : getDefaultTex();
+    string const texfile = args.texfile;
 
     std::cout << "texfile: " << texfile << std::endl;
 
@@ -91,6 +274,51 @@ int drawRasterMain(int argc, char** argv)
         return 1;
     }
 
+    long const reps = args.reps;
+    long const heatmapTile = args.heatmapTile;
+    long const meshFormat = args.meshFormat;
+    long const frameFormat = args.frameFormat;
+    long const tileBudgetKb = args.tileBudgetKb;
+
+    bool const isPly = fs::path{infile}.extension() == ".ply";
+
+    // welded PLY meshes come straight from the file, there
+    // is no loaded mesh to pack atlases for
+    if (args.atlasMaxTex > 0 && isPly && meshFormat != 0)
+    {
+        cout << "--atlas-max needs --mesh-format=loaded for PLY models" << endl;
+        return 1;
+    }
+
+    // tiles are streamed from files in the texture cache
+    if (tileBudgetKb > 0 && args.texCacheDir == "")
+    {
+        cout << "--tile-budget needs a --texture-cache folder" << endl;
+        return 1;
+    }
+
+    // meshlets are built from the welded mesh
+    if (args.meshletFaces > 0 && meshFormat == 0)
+    {
+        cout << "--meshlet-faces needs --mesh-format=welded or quantized" << endl;
+        return 1;
+    }
+
+    // outlives the textures streamed through it
+    TileCache tileCache{static_cast<size_t>(tileBudgetKb) << 10};
+
+    ObjLoadOptions loadOpts{};
+    loadOpts.textures.cacheDir = args.texCacheDir;
+    loadOpts.textures.layout = static_cast<TexelLayout>(args.layout);
+    loadOpts.textures.format = static_cast<TextureFormat>(args.format);
+
+    if (tileBudgetKb > 0) {
+        loadOpts.textures.tileCache = &tileCache;
+    }
+
+    Stats stats;
+    stats.name = "draw_raster";
+
     //##########################################################
     // Scene Setup
     //##########################################################
@@ -117,6 +345,12 @@ int drawRasterMain(int argc, char** argv)
 
             DepthBufImage img{sz};
 
+            CostHeatmap heatmap{};
+
+            if (heatmapTile > 0) {
+                heatmap = CostHeatmap{img.w, img.h, heatmapTile};
+            }
+
         time = timer.stop();
 
         cout << "Allocation time: " << time << endl;
@@ -129,51 +363,237 @@ int drawRasterMain(int argc, char** argv)
 
         timer.start();
 
-            unordered_map<string,TextureImage> textures;
-
-            Mesh mesh = loadWavefrontObjFile(infile, textures);
+            TextureMap textures;
+
+            MeshView mesh;
+            vector<IndexedMesh> welded;
+
+            // binary PLY files are read in place and need no
+            // cache, they are welded straight from the mapping
+            if (isPly) {
+                if (meshFormat == 0) {
+                    mesh = makeMeshView(loadPlyFile(infile));
+                } else {
+                    welded.push_back(weldMesh(openPlyFile(infile)));
+                }
+            } else if (args.cacheDir != "") {
+                mesh = loadCachedWavefrontObj(infile, textures, args.cacheDir, loadOpts);
+            } else {
+                mesh = makeMeshView(loadWavefrontObjFile(infile, textures, loadOpts));
+            }
 
+            // faces pick their material from a table so
+            // overriding the table covers them all
             if (texfile != "") {
-                textures[texfile] = loadTargaFile(texfile);
+                textures[texfile] = makeTextureHandle(loadTexture(texfile, loadOpts.textures));
 
-                auto & faces = mesh.faces;
+                for (auto & mtl : mesh.mtls) {
+                    mtl.texName = texfile;
+                }
 
-                for_each(faces.begin(), faces.end(),
-                    [&texfile](auto & face) {
-                        face.mtl.texName = texfile;
-                    });
+                for (auto & w : welded) {
+                    for (auto & mtl : w.mtls) {
+                        mtl.texName = texfile;
+                    }
+                }
             }
 
-            vector<Mesh> meshes = { mesh };
-
         time = timer.stop();
 
         cout << "Mesh load time: " << time << endl;
+
+        record(stats, "mesh_load_ms", time);
+    //----------------------------------------------------------
+
+    //##########################################################
+    // Build Texture Atlases
+    //##########################################################
+        // atlases as they were before compression, kept to
+        // draw the reference frame the compressed one is
+        // measured against
+        AtlasResult packed;
+
+        if (args.atlasMaxTex > 0)
+        {
+            timer.start();
+
+                AtlasOptions atlasOpts{};
+                atlasOpts.maxTexSize = args.atlasMaxTex;
+                atlasOpts.layout = loadOpts.textures.layout;
+                atlasOpts.format = loadOpts.textures.format;
+                atlasOpts.keepUncompressed = atlasOpts.format != TextureFormat::Rgb8;
+
+                // compressed textures are packed from their
+                // files so the atlas is only compressed once
+                TextureMap sources;
+
+                if (atlasOpts.format != TextureFormat::Rgb8)
+                {
+                    for (auto const & [ name, handle ] : textures)
+                    {
+                        if (handle->w <= atlasOpts.maxTexSize && handle->h <= atlasOpts.maxTexSize && fs::is_regular_file(name)) {
+                            sources[name] = makeTextureHandle(loadTextureFile(name));
+                        }
+                    }
+                }
+
+                auto const before = textures.size();
+
+                auto edited = toMesh(mesh);
+
+                packed = buildTextureAtlases(edited, textures, atlasOpts, sources);
+
+                if (!packed.atlases.empty()) {
+                    mesh = makeMeshView(edited);
+                }
+
+            time = timer.stop();
+
+            cout << "Atlas time: " << time << " (" << packed.merged.size() << " textures into "
+                << packed.atlases.size() << " atlases, " << before << " to "
+                << textures.size() << " textures)" << endl;
+
+            record(stats, "atlas_ms", time);
+            record(stats, "textures", static_cast<double>(textures.size()));
+        }
+    //----------------------------------------------------------
+
+    //##########################################################
+    // Weld Meshes
+    //##########################################################
+        vector<MeshView> views;
+        vector<QuantizedMesh> quantized;
+
+        if (meshFormat >= 1 && welded.empty())
+        {
+            timer.start();
+
+                welded.push_back(weldMesh(mesh));
+
+            time = timer.stop();
+
+            cout << "Weld time: " << time
+                << " (" << welded.back().indices.size() << " corners to "
+                << welded.back().vertices.size() << " vertexes)" << endl;
+
+            record(stats, "weld_ms", time);
+
+            // the welded copy is all that is drawn from now on
+            mesh = MeshView{};
+        }
+
+        if (args.meshletFaces > 0 && !welded.empty())
+        {
+            timer.start();
+
+                MeshletOptions meshletOpts{};
+                meshletOpts.maxFaces = static_cast<size_t>(args.meshletFaces);
+
+                for (auto & w : welded) {
+                    buildMeshlets(w, meshletOpts);
+                }
+
+            time = timer.stop();
+
+            cout << "Meshlet time: " << time
+                << " (" << welded.back().meshlets.size() << " meshlets)" << endl;
+
+            record(stats, "meshlet_ms", time);
+        }
+
+        if (meshFormat == 2)
+        {
+            quantized.push_back(quantizeMesh(welded.back()));
+
+            cout << "Quantized vertex bytes: "
+                << welded.back().vertices.size() * sizeof(MeshVertex) << " -> "
+                << quantized.back().vertices.size() * sizeof(QuantizedVertex) << endl;
+
+            welded.clear();
+        }
+
+        if (meshFormat == 0)
+        {
+            views.push_back(std::move(mesh));
+        }
     //----------------------------------------------------------
 
     //##########################################################
     // Render
     //##########################################################
-        cout << endl << "Drawing scene" << endl;
+        auto const [
+            M,
+            M_cam
+        ] = getViewTransforms(cam, sz, vvol);
+
+        RasterOptions opts{};
+        opts.stats = &stats;
+        opts.textureFilter = static_cast<TextureFilter>(args.filter);
+        opts.cullBackFaces = args.cullBackFaces;
+
+        auto const drawScene = [&](DepthBufImage & target, TextureMap const & sceneTextures) {
+            if (meshFormat == 2) {
+                drawColorScene(target, lights, quantized, sceneTextures, M, M_cam, opts);
+            } else if (meshFormat == 1) {
+                drawColorScene(target, lights, welded, sceneTextures, M, M_cam, opts);
+            } else {
+                drawColorScene(target, lights, views, sceneTextures, M, M_cam, opts);
+            }
+        };
 
-        timer.start();
+        // at most two images wait to be written at a time
+        AsyncImageWriter writer{2, ImageWriteMode::Mapped};
 
-            auto const [
-                M,
-                M_cam
-            ] = getViewTransforms(cam, sz, vvol);
+        for (long rep = 0; rep < reps; rep++)
+        {
+            cout << endl << "Drawing scene" << endl;
 
-            drawColorScene(
-                img,
-                lights,
-                meshes,
-                textures,
-                M,
-                M_cam);
+            img.reset();
 
-        time = timer.stop();
+            // only the last repetition is counted
+            opts.heatmap = heatmapTile > 0 && rep == reps - 1
+                ? &heatmap
+                : nullptr;
+
+            timer.start();
+
+                drawScene(img, textures);
+
+            time = timer.stop();
+
+            cout << "Draw time: " << time << endl;
+
+            record(stats, "draw_ms", time);
+
+            if (loadOpts.textures.tileCache != nullptr)
+            {
+                cout << "Texture tiles: " << tileCache.hitCount() << " hits, "
+                    << tileCache.misses << " misses, "
+                    << tileCache.evictions << " evictions, "
+                    << tileCache.readErrors << " read errors, hit rate "
+                    << tileCache.hitRate() << endl;
 
-        cout << "Draw time: " << time << endl;
+                record(stats, "tile_hit_rate", tileCache.hitRate());
+
+                tileCache.resetCounters();
+            }
+
+            if (frameFormat > 0)
+            {
+                std::stringstream name{""};
+                name << "raster_frame_" << std::setw(4) << std::setfill('0') << rep
+                    << (frameFormat == 2 ? ".qoi" : ".tga");
+
+                // only blocks when the writer has fallen behind
+                timer.start();
+
+                    writer.submit(name.str(), img.pixels, img.w, img.h);
+
+                time = timer.stop();
+
+                record(stats, "frame_submit_ms", time);
+            }
+        }
     //----------------------------------------------------------
 
     ////////////////////////////////////////////////////////////
@@ -183,12 +603,116 @@ int drawRasterMain(int argc, char** argv)
 
         timer.start();
 
-            saveTargaFile("raster_scene.tga", img.pixels, img.w, img.h);
+            saveTargaFile("raster_scene.tga", img.pixels, img.w, img.h, ImageWriteMode::Mapped);
 
         time = timer.stop();
 
         cout << "File write time: " << time << endl;
 
+        record(stats, "file_write_ms", time);
+
+        if (heatmapTile > 0)
+        {
+            cout << endl << "Saving heatmaps..." << endl;
+
+            auto const saveHeatmap = [&heatmap, &writer](string const & name, CostHeatmap::CountArray const & counts) {
+                writer.submit(name, heatmapImage(heatmap, counts), heatmap.w, heatmap.h);
+
+                cout << name << " max per tile: " << maxCount(counts) << endl;
+            };
+
+            saveHeatmap("raster_heatmap_triangles.tga", heatmap.triangles);
+            saveHeatmap("raster_heatmap_depth_tests.tga", heatmap.depthTests);
+            saveHeatmap("raster_heatmap_shaded.tga", heatmap.shaded);
+        }
+
+        timer.start();
+
+            try {
+                writer.wait();
+            } catch (std::runtime_error const & e) {
+                cout << e.what() << endl;
+                return 1;
+            }
+
+        time = timer.stop();
+
+        cout << "Background writes: " << writer.written
+            << " images, final wait " << time
+            << ", blocked " << writer.blockedMs << endl;
+
+        cout << endl << "Memory:" << endl << memReport();
+
+        recordMemStats(&stats);
+
+        // measure what compression cost against the same
+        // textures uncompressed, after the memory report so
+        // the extra copies are not counted in it
+        if (loadOpts.textures.format != TextureFormat::Rgb8)
+        {
+            cout << endl << "Texture quality:" << endl;
+
+            TextureMap reference;
+
+            // one sample per run, the worst texture, the same
+            // every run so bench_compare holds it to the
+            // threshold without repetitions
+            vector<double> texturePsnrs;
+
+            // atlases from the texels they were compressed from
+            for (size_t a = 0; a < packed.uncompressed.size(); a++)
+            {
+                auto const & texels = packed.uncompressed[a];
+                auto const & atlas = *textures.at(packed.atlases[a]);
+
+                TextureImage ref{atlas.w, atlas.h};
+
+                std::copy(texels.begin(), texels.end(), ref.pixels);
+
+                generateMips(ref);
+
+                reference[packed.atlases[a]] = makeTextureHandle(std::move(ref));
+            }
+
+            for (auto const & [ name, handle ] : textures)
+            {
+                if (reference.count(name) == 0)
+                {
+                    if (!fs::is_regular_file(name)) {
+                        reference[name] = handle;
+                        continue;
+                    }
+
+                    reference[name] = makeTextureHandle(loadTexture(name));
+                }
+
+                auto const psnr = texturePsnr(*reference[name], *handle);
+
+                cout << name << ": " << psnr << " dB" << endl;
+
+                texturePsnrs.push_back(psnr);
+            }
+
+            if (!texturePsnrs.empty()) {
+                record(stats, "texture_psnr_db", *std::min_element(texturePsnrs.begin(), texturePsnrs.end()));
+            }
+
+            opts.heatmap = nullptr;
+            opts.stats = nullptr;
+
+            DepthBufImage refImg{sz};
+
+            drawScene(refImg, reference);
+
+            auto const psnr = imagePsnr(refImg.pixels, img.pixels, img.w * img.h);
+
+            cout << "Frame: " << psnr << " dB" << endl;
+
+            record(stats, "frame_psnr_db", psnr);
+        }
+
+        saveStatsFile("raster_stats.json", stats);
+
     return 0;
 }
 
@@ -35,7 +35,6 @@ int drawRaycastMain()
 
     using std::string;
     using std::vector;
-    using std::unordered_map;
 
     using std::fixed;
     using std::setprecision;
@@ -93,7 +92,7 @@ int drawRaycastMain()
 
         timer.start();
 
-            unordered_map<string,TextureImage> textures;
+            TextureMap textures;
             auto meshes = loadTestMeshes(textures);
 
         time = timer.stop();
@@ -0,0 +1,184 @@
+#include "images.h"
+
+#include "image/async_image_writer.h"
+#include "loaders/tga.h"
+#include "loaders/ppm.h"
+#include "image/texture_image.h"
+
+#include <iostream>
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdexcept>
+
+namespace CxxRay {
+
+static
+std::string
+getDefaultTex()
+{
+    namespace fs = std::filesystem;
+
+    return ((fs::path{"data"} /= "tex") /= "UVCheckerMap09-512.tga").string();
+}
+
+int asyncImageWriterTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+    using std::vector;
+
+    namespace fs = std::filesystem;
+
+    cout << "asyncImageWriterTestMain" << endl;
+
+    string infile = argc > 1 ? argv[1] : getDefaultTex();
+
+    if (!fs::is_regular_file(infile))
+    {
+        cout << "Invalid input file: " << infile << endl;
+        return 1;
+    }
+
+    TextureImage const img = loadTargaFile(infile);
+
+    auto const w = img.w;
+    auto const h = img.h;
+
+    // each frame is the source with its colors rotated so
+    // a frame written under the wrong name is caught
+    auto const makeFrame = [&img](long const k) {
+        DataArray<Rgb> out{img.w * img.h, MemTag::Framebuffer};
+
+        for (long i = 0; i < img.w * img.h; i++)
+        {
+            auto const & p = img.pixels[i];
+            auto & q = out.data[i];
+
+            q = p;
+
+            if (k % 3 == 1) {
+                q.r = p.g; q.g = p.b; q.b = p.r;
+            } else if (k % 3 == 2) {
+                q.r = p.b; q.g = p.r; q.b = p.g;
+            }
+        }
+
+        return out;
+    };
+
+    long const frames = 6;
+    size_t const maxPending = 2;
+
+    vector<string> paths;
+    vector<DataArray<Rgb>> expected;
+
+    bool ok = true;
+
+    {
+        AsyncImageWriter writer{maxPending, ImageWriteMode::Mapped};
+
+        for (long k = 0; k < frames; k++)
+        {
+            std::stringstream name{""};
+            name << "async_image_writer_test_" << std::setw(2) << std::setfill('0') << k
+                << (k % 2 == 0 ? ".tga" : ".ppm");
+
+            paths.push_back(name.str());
+            expected.push_back(makeFrame(k));
+
+            // alternate between copying and handing over
+            if (k < frames / 2) {
+                writer.submit(paths.back(), expected.back().data, w, h);
+            } else {
+                writer.submit(paths.back(), makeFrame(k), w, h);
+            }
+
+            std::lock_guard<std::mutex> lock{writer.mutex};
+
+            if (writer.pending > maxPending || writer.pool.size() > maxPending) {
+                cout << "QUEUE GREW PAST " << maxPending << ": " << writer.pending << endl;
+                ok = false;
+            }
+        }
+
+        writer.wait();
+
+        cout << "Written: " << writer.written << ", blocked " << writer.blockedMs << endl;
+
+        if (writer.written != static_cast<size_t>(frames) || writer.pending != 0) {
+            cout << "NOT ALL FRAMES WRITTEN" << endl;
+            ok = false;
+        }
+    }
+
+    for (long k = 0; k < frames; k++)
+    {
+        auto const & path = paths[static_cast<size_t>(k)];
+
+        auto const loaded = k % 2 == 0
+            ? loadTargaFile(path)
+            : loadPnmFile(path);
+
+        if (!samePixels(expected[static_cast<size_t>(k)].data, loaded, w, h)) {
+            cout << path << ": PIXELS DIFFER" << endl;
+            ok = false;
+        }
+    }
+
+    // the destructor finishes whatever is still queued
+    auto const lastPath = string{"async_image_writer_test_last.tga"};
+
+    fs::remove(lastPath);
+
+    {
+        AsyncImageWriter writer{1};
+
+        writer.submit(lastPath, img.pixels, w, h);
+    }
+
+    if (!fs::is_regular_file(lastPath) || !samePixels(img.pixels, loadTargaFile(lastPath), w, h)) {
+        cout << "QUEUED FRAME LOST ON DESTRUCTION" << endl;
+        ok = false;
+    }
+
+    // a file that can not be written is reported by wait()
+    // and not counted, in either mode and every format
+    for (auto const mode : {ImageWriteMode::Buffered, ImageWriteMode::Mapped})
+    {
+        for (auto const * ext : {".tga", ".ppm", ".qoi"})
+        {
+            auto const badPath = (fs::path{"async_image_writer_test_missing"} /= string{"frame"} + ext).string();
+
+            AsyncImageWriter writer{1, mode};
+
+            writer.submit(badPath, img.pixels, w, h);
+
+            string message = "";
+
+            try {
+                writer.wait();
+            } catch (std::runtime_error const & e) {
+                message = e.what();
+            }
+
+            if (message != "ERROR WRITING: " + badPath || writer.written != 0) {
+                cout << badPath << ": WRITE ERROR NOT REPORTED" << endl;
+                ok = false;
+            }
+        }
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::asyncImageWriterTestMain(argc, argv);
+}
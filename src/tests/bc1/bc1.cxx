@@ -0,0 +1,196 @@
+#include "image/bc1.h"
+#include "image/texture_compress.h"
+#include "image/texture_image.h"
+#include "loaders/texture_cache.h"
+#include "utils/profiler.h"
+
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <cstdlib>
+
+namespace CxxRay {
+
+static
+std::string
+getDefaultTex()
+{
+    namespace fs = std::filesystem;
+
+    return ((fs::path{"data"} /= "tex") /= "UVCheckerMap02-512.tga").string();
+}
+
+static
+Rgb
+rgb(
+    int const r,
+    int const g,
+    int const b)
+{
+    Rgb p;
+    p.r = static_cast<ByteT>(r);
+    p.g = static_cast<ByteT>(g);
+    p.b = static_cast<ByteT>(b);
+    return p;
+}
+
+static
+bool
+same(
+    Rgb const & a,
+    Rgb const & b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+// largest channel difference over a block
+static
+int
+maxError(
+    Bc1Block const & block,
+    Rgb const (&texels)[16])
+{
+    int worst = 0;
+
+    for (unsigned i = 0; i < 16; i++)
+    {
+        auto const p = bc1::paletteColor(block, (block.indices >> (2 * i)) & 3);
+
+        worst = std::max({worst, std::abs(p.r - texels[i].r), std::abs(p.g - texels[i].g), std::abs(p.b - texels[i].b)});
+    }
+
+    return worst;
+}
+
+int bc1TestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    namespace fs = std::filesystem;
+
+    cout << "bc1TestMain" << endl;
+
+    string const infile = argc > 1 ? argv[1] : getDefaultTex();
+    string const cacheDir = argc > 2 ? argv[2] : "bc1_test";
+
+    bool ok = true;
+
+    auto const expect = [&ok](bool const cond, char const * what) {
+        if (!cond) {
+            cout << "FAILED: " << what << endl;
+            ok = false;
+        }
+    };
+
+    // colors that 565 holds exactly come back exactly
+    {
+        Rgb texels[16];
+
+        for (auto & t : texels) {
+            t = rgb(255, 0, 255);
+        }
+
+        expect(maxError(bc1::encodeBlock(texels), texels) == 0, "solid block");
+
+        for (unsigned i = 0; i < 16; i++) {
+            texels[i] = i % 3 == 0 ? rgb(0, 0, 0) : rgb(255, 255, 255);
+        }
+
+        expect(maxError(bc1::encodeBlock(texels), texels) == 0, "two color block");
+    }
+
+    // a gradient along one axis fits the 4 color palette
+    {
+        Rgb texels[16];
+
+        for (int i = 0; i < 16; i++) {
+            texels[i] = rgb(40 + 10 * (i % 4), 80 + 20 * (i % 4), 200 - 30 * (i % 4));
+        }
+
+        expect(maxError(bc1::encodeBlock(texels), texels) <= 8, "gradient block");
+    }
+
+    // the 3 color palette of blocks made elsewhere decodes
+    {
+        Bc1Block block{};
+        block.c0 = bc1::to565(0, 0, 0);
+        block.c1 = bc1::to565(255, 255, 255);
+
+        expect(same(bc1::paletteColor(block, 2), rgb(127, 127, 127)), "3 color midpoint");
+        expect(same(bc1::paletteColor(block, 3), rgb(0, 0, 0)), "3 color black");
+    }
+
+    if (!fs::is_regular_file(infile))
+    {
+        cout << "Invalid input file: " << infile << endl;
+        return 1;
+    }
+
+    fs::remove_all(cacheDir);
+
+    auto const reference = loadMippedTexture(infile);
+
+    Profiler timer;
+
+    auto const compressed = loadMippedTexture(infile, TexelLayout::RowMajor, TextureFormat::Bc1);
+
+    cout << "encode time: " << timer.stop() << endl;
+
+    // the chain's blocks against its uncompressed texels
+    auto const rawBytes = layoutTexels(TexelLayout::RowMajor, reference.w, reference.h) * 3
+        + mipChainTexels(reference.mips) * 3;
+    auto const blockBytes = compressed.blockArray.len * static_cast<long>(sizeof(Bc1Block));
+
+    auto const psnr = texturePsnr(reference, compressed);
+
+    cout << "bytes " << rawBytes << " -> " << blockBytes << ", psnr " << psnr << " dB" << endl;
+
+    expect(compressed.format == TextureFormat::Bc1 && compressed.pixels == nullptr, "compressed format");
+    expect(compressed.levels() == reference.levels(), "mip chain kept");
+    expect(blockBytes * 5 < rawBytes, "at least 5x smaller");
+    expect(psnr > 32, "quality");
+
+    // every level decodes close to the uncompressed one
+    for (long l = 1; l < compressed.levels(); l++)
+    {
+        long worst = 0;
+
+        for (long y = 0; y < compressed.levelH(l); y++)
+        {
+            for (long x = 0; x < compressed.levelW(l); x++)
+            {
+                auto const p = compressed.levelTexel(l, x, y);
+                auto const q = reference.levelTexel(l, x, y);
+
+                worst = std::max({worst, static_cast<long>(std::abs(p.r - q.r)), static_cast<long>(std::abs(p.g - q.g)), static_cast<long>(std::abs(p.b - q.b))});
+            }
+        }
+
+        expect(worst < 64, "mip level error");
+    }
+
+    // compressed textures are cached and mapped like others
+    {
+        auto const first = loadMappedTexture(infile, cacheDir, TexelLayout::RowMajor, TextureFormat::Bc1);
+        auto const second = loadMappedTexture(infile, cacheDir, TexelLayout::Blocked, TextureFormat::Bc1);
+
+        expect(first.mapped() && second.mapped() && second.format == TextureFormat::Bc1, "mapped compressed");
+        expect(texturePsnr(compressed, second) == 100.0, "mapped blocks match");
+        expect(second.levels() == compressed.levels() && same(second.levelTexel(3, 5, 7), compressed.levelTexel(3, 5, 7)), "mapped mips match");
+
+        auto const uncompressed = loadMappedTexture(infile, cacheDir);
+
+        expect(uncompressed.mapped() && uncompressed.format == TextureFormat::Rgb8, "uncompressed cache kept apart");
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::bc1TestMain(argc, argv);
+}
@@ -0,0 +1,374 @@
+#include "utils/stats.h"
+#include "utils/strings.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cmath>
+#include <cstring>
+
+namespace CxxRay {
+
+struct Summary
+{
+    double mean = 0.0;
+    double var = 0.0; // sample variance
+    long n = 0;
+};
+
+static
+Summary
+summarize(
+    std::vector<double> const & samples)
+{
+    Summary s{};
+
+    s.n = static_cast<long>(samples.size());
+
+    if (s.n == 0) {
+        return s;
+    }
+
+    for (auto const x : samples) {
+        s.mean += x;
+    }
+
+    s.mean /= static_cast<double>(s.n);
+
+    if (s.n < 2) {
+        return s;
+    }
+
+    for (auto const x : samples) {
+        s.var += (x - s.mean) * (x - s.mean);
+    }
+
+    s.var /= static_cast<double>(s.n - 1);
+
+    return s;
+}
+
+// two sided normal quantile by bisection on erfc
+static
+double
+normalQuantile(
+    double const confidence)
+{
+    double const tail = (1.0 - confidence) / 2.0;
+
+    double lo = 0.0;
+    double hi = 10.0;
+
+    for (int i = 0; i < 100; i++)
+    {
+        double const mid = (lo + hi) / 2.0;
+
+        if (0.5 * std::erfc(mid / std::sqrt(2.0)) > tail) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return (lo + hi) / 2.0;
+}
+
+// two sided student's t quantile
+//
+// exact for one and two degrees of freedom, otherwise a
+// Cornish-Fisher expansion around the normal quantile
+// which is well within a percent from three upwards
+static
+double
+tQuantile(
+    double const confidence,
+    double const df)
+{
+    constexpr double kPi = 3.14159265358979323846;
+
+    double const p = 1.0 - (1.0 - confidence) / 2.0;
+
+    if (df < 1.5) {
+        return std::tan(kPi * (p - 0.5));
+    }
+
+    if (df < 2.5) {
+        return (2.0 * p - 1.0) / std::sqrt(2.0 * p * (1.0 - p));
+    }
+
+    double const z = normalQuantile(confidence);
+    double const z3 = z * z * z;
+    double const z5 = z3 * z * z;
+    double const z7 = z5 * z * z;
+
+    return z
+        + (z3 + z) / (4.0 * df)
+        + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * df * df)
+        + (3.0 * z7 + 19.0 * z5 + 17.0 * z3 - 15.0 * z) / (384.0 * df * df * df);
+}
+
+static
+bool
+endsWith(
+    std::string const & metric,
+    std::string const & suffix)
+{
+    return metric.size() >= suffix.size() &&
+        metric.compare(metric.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// most metrics are costs (times, misses, bytes) where
+// smaller is better, rates, throughputs and quality in
+// decibels (PSNR) are the exception and are recognized
+// by name
+static
+bool
+isHigherBetter(
+    std::string const & metric)
+{
+    return endsWith(metric, "_per_s") || endsWith(metric, "_rate") || endsWith(metric, "ipc") || endsWith(metric, "_db");
+}
+
+// quality measures what was drawn rather than how long it
+// took, so runs of the same build give the same value and
+// one sample is exact
+static
+bool
+isExact(
+    std::string const & metric)
+{
+    return endsWith(metric, "_db");
+}
+
+int benchCompareMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+    using std::setw;
+    using std::fixed;
+    using std::setprecision;
+
+    namespace fs = std::filesystem;
+
+    auto const usage = []() {
+        cout << "Usage: bench_compare <baseline.json> <candidate.json> [threshold %] [confidence]" << endl;
+    };
+
+    if (argc < 3)
+    {
+        usage();
+        return 2;
+    }
+
+    string const baseFile = argv[1];
+    string const candFile = argv[2];
+
+    // whole argument is a finite number
+    auto const number = [](char const * arg, double & out) {
+        auto const * const last = arg + std::strlen(arg);
+
+        Real n = 0.0;
+
+        if (parseReal(arg, last, n) != last || !std::isfinite(n)) {
+            return false;
+        }
+
+        out = n;
+
+        return true;
+    };
+
+    // changes smaller than the threshold are never
+    // flagged no matter how significant they are
+    double threshold = 5.0;
+    double confidence = 0.95;
+
+    if (argc > 3 && (!number(argv[3], threshold) || threshold < 0.0))
+    {
+        cout << "Invalid threshold: " << argv[3] << endl;
+        usage();
+        return 2;
+    }
+
+    if (argc > 4 && (!number(argv[4], confidence) || confidence <= 0.0 || confidence >= 1.0))
+    {
+        cout << "Invalid confidence, must be between 0 and 1: " << argv[4] << endl;
+        usage();
+        return 2;
+    }
+
+    for (auto const & f : { baseFile, candFile })
+    {
+        if (!fs::is_regular_file(f))
+        {
+            cout << "Invalid input file: " << f << endl;
+            return 2;
+        }
+    }
+
+    // a file that is not stats JSON is bad input the same
+    // as a missing one
+    auto const load = [](string const & f, Stats & out) {
+        try {
+            out = loadStatsFile(f);
+        }
+        catch (std::runtime_error const & e) {
+            cout << "Invalid input file: " << f << ": " << e.what() << endl;
+            return false;
+        }
+
+        return true;
+    };
+
+    Stats base;
+    Stats cand;
+
+    if (!load(baseFile, base) || !load(candFile, cand)) {
+        return 2;
+    }
+
+    cout << "Baseline:  " << baseFile << endl;
+    cout << "Candidate: " << candFile << endl;
+    cout << "Threshold: " << threshold << "%, confidence: " << confidence * 100.0 << "%" << endl;
+    cout << endl;
+
+    cout << fixed << setprecision(3);
+
+    cout
+        << std::left << setw(28) << "metric" << std::right
+        << setw(22) << "baseline"
+        << setw(22) << "candidate"
+        << setw(10) << "change"
+        << setw(24) << "interval"
+        << "  verdict" << endl;
+
+    long regressions = 0;
+
+    for (auto const & [ metric, baseSamples ] : base.metrics)
+    {
+        auto const found = cand.metrics.find(metric);
+
+        if (found == cand.metrics.end())
+        {
+            cout << std::left << setw(28) << metric << std::right << "  missing from candidate" << endl;
+            continue;
+        }
+
+        auto const b = summarize(baseSamples);
+        auto const c = summarize(found->second);
+
+        if (b.n == 0 || c.n == 0) {
+            continue;
+        }
+
+        // a change relative to zero has no size
+        if (b.mean == 0.0)
+        {
+            cout << std::left << setw(28) << metric << std::right << "  zero baseline, not compared" << endl;
+            continue;
+        }
+
+        // welch's t interval on the difference of means,
+        // expressed relative to the baseline mean
+        double const se2 = b.var / static_cast<double>(b.n) + c.var / static_cast<double>(c.n);
+        double const se = std::sqrt(se2);
+
+        double df = 1.0;
+
+        if (se2 > 0.0 && b.n > 1 && c.n > 1)
+        {
+            double const vb = b.var / static_cast<double>(b.n);
+            double const vc = c.var / static_cast<double>(c.n);
+
+            df = se2 * se2 / (
+                vb * vb / static_cast<double>(b.n - 1) +
+                vc * vc / static_cast<double>(c.n - 1));
+        }
+
+        double const diff = c.mean - b.mean;
+        double const margin = se > 0.0 ? tQuantile(confidence, df) * se : 0.0;
+
+        double const change = 100.0 * diff / b.mean;
+        double const lo = 100.0 * (diff - margin) / b.mean;
+        double const hi = 100.0 * (diff + margin) / b.mean;
+
+        // the interval on how much worse the candidate is,
+        // positive is worse
+        double const worseLo = isHigherBetter(metric) ? -hi : lo;
+        double const worseHi = isHigherBetter(metric) ? -lo : hi;
+
+        string verdict = "ok";
+
+        // an exact metric without repetitions has no noise
+        // to estimate, the change is held to the threshold
+        if ((b.n < 2 || c.n < 2) && isExact(metric) && b.var == 0.0 && c.var == 0.0)
+        {
+            double const worse = isHigherBetter(metric) ? -change : change;
+
+            if (worse > threshold)
+            {
+                verdict = "REGRESSION";
+                regressions++;
+            }
+            else if (worse < -threshold)
+            {
+                verdict = "improvement";
+            }
+        }
+        // otherwise without repetitions nothing can be
+        // called significant
+        else if (b.n < 2 || c.n < 2)
+        {
+            verdict = "inconclusive (no repetitions)";
+        }
+        else if (worseLo > threshold)
+        {
+            verdict = "REGRESSION";
+            regressions++;
+        }
+        else if (worseHi < -threshold)
+        {
+            verdict = "improvement";
+        }
+        else if (std::abs(change) >= threshold)
+        {
+            verdict = "noise";
+        }
+
+        auto const fmt = [](Summary const & s) {
+            std::stringstream ss{""};
+            ss << fixed << setprecision(3) << s.mean << " +/- " << std::sqrt(s.var) << " (" << s.n << ")";
+            return ss.str();
+        };
+
+        std::stringstream interval{""};
+        interval << fixed << setprecision(2) << "[" << lo << "%, " << hi << "%]";
+
+        std::stringstream changeStr{""};
+        changeStr << fixed << setprecision(2) << std::showpos << change << "%";
+
+        cout
+            << std::left << setw(28) << metric << std::right
+            << setw(22) << fmt(b)
+            << setw(22) << fmt(c)
+            << setw(10) << changeStr.str()
+            << setw(24) << interval.str()
+            << "  " << verdict << endl;
+    }
+
+    cout << endl << regressions << " regression(s)" << endl;
+
+    return regressions > 0 ? 1 : 0;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::benchCompareMain(argc, argv);
+}
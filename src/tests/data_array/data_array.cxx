@@ -1,4 +1,5 @@
 #include "utils/data_array.h"
+#include "utils/mem_stats.h"
 
 #include <iostream>
 #include <filesystem>
@@ -9,10 +10,48 @@ namespace CxxRay {
 
 int testDataArrayMain()
 {
+    using std::cout;
+    using std::endl;
+
     namespace fs = std::filesystem;
 
     DataArray<int> x(10);
 
+    // tagged arrays are counted while they live
+    auto const before = memCurrent(MemTag::Framebuffer);
+
+    {
+        DataArray<double> buf{1000, MemTag::Framebuffer};
+
+        auto const during = memCurrent(MemTag::Framebuffer);
+
+        cout << "framebuffer bytes while allocated: " << during - before << endl;
+
+        if (during - before != static_cast<long long>(1000 * sizeof(double))) {
+            cout << "ALLOCATION NOT COUNTED" << endl;
+            return 1;
+        }
+
+        buf.reallocate(10);
+
+        if (memCurrent(MemTag::Framebuffer) - before != static_cast<long long>(10 * sizeof(double))) {
+            cout << "REALLOCATION NOT COUNTED" << endl;
+            return 1;
+        }
+    }
+
+    if (memCurrent(MemTag::Framebuffer) != before) {
+        cout << "FREE NOT COUNTED" << endl;
+        return 1;
+    }
+
+    if (memPeak(MemTag::Framebuffer) - before < static_cast<long long>(1000 * sizeof(double))) {
+        cout << "PEAK NOT COUNTED" << endl;
+        return 1;
+    }
+
+    cout << memReport();
+
     return 0;
 }
 
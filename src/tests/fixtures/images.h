@@ -0,0 +1,108 @@
+#ifndef CXXRAY_TESTS_FIXTURES_IMAGES_H
+#define CXXRAY_TESTS_FIXTURES_IMAGES_H
+
+#include "image/texture_image.h"
+#include "rgb/rgb.h"
+
+namespace CxxRay {
+
+inline
+bool
+sameRgb(
+    Rgb const & p,
+    Rgb const & q)
+{
+    return p.r == q.r && p.g == q.g && p.b == q.b;
+}
+
+// every level the same size with the same texels
+inline
+bool
+sameMips(
+    TextureImage const & a,
+    TextureImage const & b)
+{
+    if (a.levels() != b.levels()) {
+        return false;
+    }
+
+    for (long l = 0; l < a.levels(); l++)
+    {
+        if (a.levelW(l) != b.levelW(l) || a.levelH(l) != b.levelH(l)) {
+            return false;
+        }
+
+        for (long y = 0; y < a.levelH(l); y++)
+        {
+            for (long x = 0; x < a.levelW(l); x++)
+            {
+                if (!sameRgb(a.levelTexel(l, x, y), b.levelTexel(l, x, y))) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// full size texels read through texel(), so tiled and
+// compressed images compare by what they sample to
+inline
+bool
+sameTexels(
+    TextureImage const & a,
+    TextureImage const & b)
+{
+    if (a.w != b.w || a.h != b.h) {
+        return false;
+    }
+
+    for (long y = 0; y < a.h; y++)
+    {
+        for (long x = 0; x < a.w; x++)
+        {
+            if (!sameRgb(a.texel(x, y), b.texel(x, y))) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// w by h pixels against a loaded image's pixel array
+inline
+bool
+samePixels(
+    Rgb const * a,
+    TextureImage const & b,
+    long const w,
+    long const h)
+{
+    if (b.w != w || b.h != h) {
+        return false;
+    }
+
+    for (long i = 0; i < w * h; i++)
+    {
+        if (!sameRgb(a[i], b.pixels[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+inline
+bool
+samePixels(
+    TextureImage const & a,
+    TextureImage const & b)
+{
+    return samePixels(a.pixels, b, a.w, a.h);
+}
+
+} // namespace CxxRay
+
+#endif
@@ -12,7 +12,7 @@ inline
 Mesh
 loadTestMesh(
     std::string const & fileName,
-    std::unordered_map<std::string,TextureImage> & textures)
+    TextureMap & textures)
 {
     namespace fs = std::filesystem;
 
@@ -27,13 +27,13 @@ loadTestMesh(
 inline
 std::vector<Mesh>
 loadTestMeshes(
-    std::unordered_map<std::string,TextureImage> & textures)
+    TextureMap & textures)
 {
     auto meshes = std::vector<Mesh>{};
 
     auto mesh = loadTestMesh("icosphere.obj", textures);
 
-    meshes.push_back(mesh);
+    meshes.push_back(std::move(mesh));
 
     return meshes;
 }
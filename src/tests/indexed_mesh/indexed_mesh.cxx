@@ -0,0 +1,135 @@
+#include "world/indexed_mesh.h"
+#include "world/scene_gen.h"
+#include "loaders/wavefront_obj.h"
+#include "loaders/mesh_cache.h"
+#include "image/texture_image.h"
+#include "utils/profiler.h"
+
+#include <iostream>
+#include <filesystem>
+#include <string>
+
+namespace CxxRay {
+
+static
+bool
+sameVec(
+    Vec3 const & a,
+    Vec3 const & b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// every corner of every face must read back the same
+// position, normal, uv and material after welding, and
+// no two welded vertexes may be the same combination
+static
+bool
+checkWeld(
+    std::string const & label,
+    Mesh const & mesh)
+{
+    using std::cout;
+    using std::endl;
+
+    Profiler timer;
+
+    auto const welded = weldMesh(mesh);
+
+    auto const time = timer.stop();
+
+    auto const corners = mesh.faces.size() * 3;
+
+    auto const oldBytes = corners * sizeof(MeshIndex);
+    auto const newBytes = welded.indices.size() * sizeof(uint32_t);
+
+    cout << label
+        << ": corners " << corners
+        << ", vertexes " << welded.vertices.size()
+        << ", index bytes " << oldBytes << " -> " << newBytes
+        << ", time " << time << endl;
+
+    if (welded.faceCount() != mesh.faces.size() || welded.faceMtls.size() != mesh.faces.size()) {
+        cout << label << ": WRONG FACE COUNT" << endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < mesh.faces.size(); i++)
+    {
+        auto const & face = mesh.faces[i];
+
+        if (!sameMtl(welded.faceMtl(i), mesh.faceMtl(i))) {
+            cout << label << ": WRONG MATERIAL ON FACE " << i << endl;
+            return false;
+        }
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            auto const & I = face.vertexIndexes[k];
+            auto const & vtx = welded.vertices[welded.indices[3 * i + k]];
+
+            auto const [ u, v ] = mesh.uvs[static_cast<size_t>(I.uvId - 1)];
+
+            if (!sameVec(vtx.pos, mesh.verts[static_cast<size_t>(I.id - 1)]) ||
+                !sameVec(vtx.norm, mesh.norms[static_cast<size_t>(I.normId - 1)]) ||
+                vtx.u != u || vtx.v != v) {
+                cout << label << ": WRONG VERTEX ON FACE " << i << endl;
+                return false;
+            }
+        }
+    }
+
+    if (welded.vertices.size() > corners) {
+        cout << label << ": MORE VERTEXES THAN CORNERS" << endl;
+        return false;
+    }
+
+    // welding the view of the same mesh gives the same result
+    auto const fromView = weldMesh(makeMeshView(mesh));
+
+    if (fromView.vertices.size() != welded.vertices.size() || fromView.indices != welded.indices) {
+        cout << label << ": VIEW WELD DIFFERS" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+int indexedMeshTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    namespace fs = std::filesystem;
+
+    cout << "Test Indexed Mesh" << endl;
+
+    TextureMap textures;
+
+    bool ok = true;
+
+    auto const infile = argc > 1
+        ? string{argv[1]}
+        : ((fs::path{"data"} /= "models") /= "monkey.obj").string();
+
+    ok = checkWeld(infile, loadWavefrontObjFile(infile, textures)) && ok;
+
+    {
+        SceneGenParams params{};
+        params.triangles = 50000;
+        params.instances = 4;
+        params.textureCount = 2;
+
+        ok = checkWeld("generated", generateScene(params, textures)) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::indexedMeshTestMain(argc, argv);
+}
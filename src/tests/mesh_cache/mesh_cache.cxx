@@ -0,0 +1,326 @@
+#include "loaders/mesh_cache.h"
+#include "loaders/wavefront_obj.h"
+#include "world/scene_gen.h"
+#include "world/mesh_view.h"
+#include "world/indexed_mesh.h"
+#include "raster/draw_scene.h"
+#include "image/texture_image.h"
+#include "utils/profiler.h"
+#include "utils/hash.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <set>
+#include <array>
+#include <vector>
+
+namespace CxxRay {
+
+static
+bool
+sameAsMesh(
+    MeshView const & view,
+    Mesh const & mesh)
+{
+    if (!view.valid() ||
+        view.faceCount != mesh.faces.size() || view.vertCount != mesh.verts.size() ||
+        view.normCount != mesh.norms.size() || view.uvCount != mesh.uvs.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < view.vertCount; i++)
+    {
+        if (view.verts[i].x != mesh.verts[i].x || view.verts[i].y != mesh.verts[i].y || view.verts[i].z != mesh.verts[i].z) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < view.normCount; i++)
+    {
+        if (view.norms[i].x != mesh.norms[i].x || view.norms[i].y != mesh.norms[i].y || view.norms[i].z != mesh.norms[i].z) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < view.uvCount; i++)
+    {
+        if (view.uv(i) != mesh.uvs[i]) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < view.faceCount; i++)
+    {
+        if (!sameMtl(view.faceMtl(i), mesh.faceMtl(i)) ||
+            view.mtlNames[view.faceMtls[i]] != mesh.mtlNames[mesh.faces[i].mtlId]) {
+            return false;
+        }
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            auto const & I = view.faces[i][k];
+            auto const & J = mesh.faces[i].vertexIndexes[k];
+
+            if (I.id != J.id || I.uvId != J.uvId || I.normId != J.normId) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// load through the cache and check the outcome
+static
+bool
+checkLoad(
+    std::string const & label,
+    std::string const & objPath,
+    std::string const & cacheDir,
+    bool const expectCached)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    TextureMap textures;
+
+    Profiler timer;
+
+    auto const view = loadCachedWavefrontObj(objPath, textures, cacheDir);
+
+    auto const time = timer.stop();
+
+    auto const mesh = loadWavefrontObjFile(objPath, textures);
+
+    cout << label
+        << ": faces " << view.faceCount
+        << ", cached " << view.cached
+        << ", time " << time << endl;
+
+    if (view.cached != expectCached) {
+        cout << label << ": EXPECTED " << (expectCached ? "CACHE HIT" : "CACHE MISS") << endl;
+        return false;
+    }
+
+    if (!sameAsMesh(view, mesh)) {
+        cout << label << ": VIEW DIFFERS FROM OBJ" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+int meshCacheTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    namespace fs = std::filesystem;
+
+    cout << "Test Mesh Cache" << endl;
+
+    string const cacheDir = argc > 1 ? argv[1] : "mesh_cache_test";
+
+    std::error_code ec;
+    fs::remove_all(cacheDir, ec);
+
+    bool ok = true;
+
+    // a model with a material library and texture
+    auto const monkey = ((fs::path{"data"} /= "models") /= "monkey.obj").string();
+
+    ok = checkLoad("monkey first", monkey, cacheDir, false) && ok;
+    ok = checkLoad("monkey second", monkey, cacheDir, true) && ok;
+
+    // a generated model that is then edited
+    fs::create_directories(cacheDir, ec);
+
+    auto const sceneObj = (fs::path{cacheDir} /= "scene.obj").string();
+
+    {
+        TextureMap textures;
+
+        SceneGenParams params{};
+        params.triangles = 20000;
+        params.instances = 4;
+
+        saveWavefrontObjFile(sceneObj, generateScene(params, textures));
+    }
+
+    ok = checkLoad("scene first", sceneObj, cacheDir, false) && ok;
+    ok = checkLoad("scene second", sceneObj, cacheDir, true) && ok;
+
+    {
+        std::ofstream fh{sceneObj, std::ios::app};
+        fh << "v 0.0 0.0 0.0\n";
+    }
+
+    ok = checkLoad("scene edited", sceneObj, cacheDir, false) && ok;
+    ok = checkLoad("scene edited second", sceneObj, cacheDir, true) && ok;
+
+    // a damaged cache file is rebuilt rather than used
+    {
+        auto const cachePath = meshCachePath(cacheDir, sceneObj);
+
+        fs::resize_file(cachePath, 100, ec);
+    }
+
+    ok = checkLoad("scene truncated", sceneObj, cacheDir, false) && ok;
+
+    // as is one whose sizes add up but whose faces refer
+    // past the vertexes
+    {
+        auto const cachePath = meshCachePath(cacheDir, sceneObj);
+
+        meshCache::Header header{};
+
+        std::fstream fh{cachePath, std::ios::binary | std::ios::in | std::ios::out};
+        fh.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+        long long const id = static_cast<long long>(header.verts.count) + 1;
+
+        fh.seekp(static_cast<std::streamoff>(header.faces.offset));
+        fh.write(reinterpret_cast<char const *>(&id), sizeof(id));
+    }
+
+    if (openMeshCache(meshCachePath(cacheDir, sceneObj)).valid()) {
+        cout << "FACE INDEX PAST THE VERTEXES ACCEPTED" << endl;
+        ok = false;
+    }
+
+    ok = checkLoad("scene bad index", sceneObj, cacheDir, false) && ok;
+
+    // materials with the same values keep their own names
+    // through the cache and a save of what it gives back
+    auto const twinsObj = (fs::path{cacheDir} /= "twins.obj").string();
+
+    {
+        std::ofstream mtl{(fs::path{cacheDir} /= "twins.mtl").string()};
+
+        mtl << "newmtl red\nKd 1 0 0\nnewmtl crimson\nKd 1 0 0\n";
+
+        std::ofstream obj{twinsObj};
+
+        obj << "mtllib twins.mtl\n"
+            << "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n"
+            << "usemtl red\nf 1/1/1 2/1/1 3/1/1\n"
+            << "usemtl crimson\nf 1/1/1 2/1/1 3/1/1\n"
+            << "usemtl red\nf 1/1/1 2/1/1 3/1/1\n";
+    }
+
+    ok = checkLoad("twins first", twinsObj, cacheDir, false) && ok;
+
+    {
+        TextureMap textures;
+
+        auto const view = loadCachedWavefrontObj(twinsObj, textures, cacheDir);
+
+        auto const resaved = (fs::path{cacheDir} /= "twins_resaved.obj").string();
+
+        saveWavefrontObjFile(resaved, toMesh(view));
+
+        auto const mesh = loadWavefrontObjFile(resaved, textures);
+
+        // a material used again shares its table entry
+        if (mesh.faces.size() != 3 || mesh.mtlTable.size() != 2 || mesh.faces[2].mtlId != mesh.faces[0].mtlId ||
+            mesh.mtlNames[mesh.faces[0].mtlId] != "red" || mesh.mtlNames[mesh.faces[1].mtlId] != "crimson")
+        {
+            cout << "twins: MATERIAL NAMES LOST" << endl;
+            ok = false;
+        }
+    }
+
+    // faces without uvs or normals weld and draw with
+    // default values instead of reading before the arrays
+    auto const bareObj = (fs::path{cacheDir} /= "bare.obj").string();
+
+    {
+        std::ofstream obj{bareObj};
+
+        obj << "v -1 -1 0\nv 1 -1 0\nv 0 1 0\nvn 0 0 1\n"
+            << "f 1 2 3\nf 1//1 2//1 3//1\n";
+    }
+
+    ok = checkLoad("bare first", bareObj, cacheDir, false) && ok;
+
+    {
+        TextureMap textures;
+
+        std::vector<MeshView> views;
+        views.push_back(loadCachedWavefrontObj(bareObj, textures, cacheDir));
+
+        auto const welded = weldMesh(views[0]);
+
+        auto const & vtx = welded.vertices[welded.indices[0]];
+
+        if (welded.faceCount() != 2 || vtx.u != 0.0 || vtx.v != 0.0 || vtx.norm.x != 0.0 || vtx.norm.y != 0.0 || vtx.norm.z != 0.0)
+        {
+            cout << "bare: WRONG DEFAULT UV OR NORMAL" << endl;
+            ok = false;
+        }
+
+        PixPoint const sz{64, 48};
+
+        Camera const cam{3.0, -3.0, 3.0};
+
+        std::vector<Light> const lights{Light{Vec3{3.0, -3.0, 3.0}, RgbReal{0.8, 0.8, 0.8}}};
+
+        auto const [ M, M_cam ] = getViewTransforms(cam, sz, ViewVolume{});
+
+        DepthBufImage img{sz};
+        img.reset();
+
+        drawColorScene(img, lights, views, textures, M, M_cam);
+    }
+
+    // every one and two bit edit of a 16 byte buffer hashes
+    // differently, including flips in the high bytes of both
+    // words which word wise FNV-1a lets cancel
+    {
+        std::set<uint64_t> seen;
+
+        size_t edits = 0;
+
+        auto const add = [&seen, &edits](std::array<unsigned char,16> const & buf) {
+            seen.insert(hashBytes(buf.data(), buf.size()));
+            edits++;
+        };
+
+        add({});
+
+        for (size_t a = 0; a < 128; a++)
+        {
+            std::array<unsigned char,16> buf{};
+            buf[a / 8] ^= static_cast<unsigned char>(1u << (a % 8));
+
+            add(buf);
+
+            for (size_t b = a + 1; b < 128; b++)
+            {
+                auto both = buf;
+                both[b / 8] ^= static_cast<unsigned char>(1u << (b % 8));
+
+                add(both);
+            }
+        }
+
+        if (seen.size() != edits)
+        {
+            cout << "hash: " << edits - seen.size() << " colliding bit flips" << endl;
+            ok = false;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::meshCacheTestMain(argc, argv);
+}
@@ -0,0 +1,275 @@
+#include "loaders/wavefront_obj.h"
+#include "loaders/mesh_cache.h"
+#include "raster/draw_scene.h"
+#include "world/scene_gen.h"
+#include "world/indexed_mesh.h"
+#include "world/quantized_mesh.h"
+
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <cstring>
+
+namespace CxxRay {
+
+// two triangles ahead of any group, an object, an empty
+// group and a group sharing a vertex with the first faces
+static
+char const *
+partsObj()
+{
+    return
+        "v 0 0 0\n"
+        "v 1 0 0\n"
+        "v 0 1 0\n"
+        "v -10 0 0\n"
+        "v -11 0 0\n"
+        "v -10 2 0\n"
+        "v 10 0 1\n"
+        "v 12 0 1\n"
+        "v 10 1 3\n"
+        "vt 0 0\n"
+        "vn 0 0 1\n"
+        "f 1/1/1 2/1/1 3/1/1\n"
+        "f 3/1/1 2/1/1 1/1/1\n"
+        "o left side\n"
+        "f 4/1/1 5/1/1 6/1/1\n"
+        "g\n"
+        "g wheels\n"
+        "f 7/1/1 8/1/1 9/1/1\n"
+        "f 7/1/1 8/1/1 1/1/1\n";
+}
+
+static
+bool
+sameBounds(
+    Bounds const & a,
+    Bounds const & b)
+{
+    return a.lo.x == b.lo.x && a.lo.y == b.lo.y && a.lo.z == b.lo.z &&
+        a.hi.x == b.hi.x && a.hi.y == b.hi.y && a.hi.z == b.hi.z &&
+        a.radius == b.radius;
+}
+
+static
+bool
+sameParts(
+    std::vector<MeshPart> const & a,
+    std::vector<MeshPart> const & b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].name != b[i].name || a[i].firstFace != b[i].firstFace ||
+            a[i].faceCount != b[i].faceCount || !sameBounds(a[i].bounds, b[i].bounds)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// every vertex of the part's faces is in its box and sphere
+static
+bool
+encloses(
+    Mesh const & mesh,
+    MeshPart const & part)
+{
+    auto const & b = part.bounds;
+
+    for (size_t f = part.firstFace; f < part.firstFace + part.faceCount; f++)
+    {
+        for (auto const & I : mesh.faces[f].vertexIndexes)
+        {
+            auto const & p = mesh.verts[static_cast<size_t>(I.id - 1)];
+
+            auto const d = p - b.center;
+
+            if (p.x < b.lo.x || p.y < b.lo.y || p.z < b.lo.z ||
+                p.x > b.hi.x || p.y > b.hi.y || p.z > b.hi.z ||
+                dot(d, d) > b.radius * b.radius * (1 + 1e-12)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int meshPartsTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    namespace fs = std::filesystem;
+
+    cout << "meshPartsTestMain" << endl;
+
+    string const outDir = argc > 1 ? argv[1] : "mesh_parts_test";
+
+    fs::remove_all(outDir);
+    fs::create_directories(outDir);
+
+    bool ok = true;
+
+    auto const expect = [&ok](bool const cond, char const * what) {
+        if (!cond) {
+            cout << "FAILED: " << what << endl;
+            ok = false;
+        }
+    };
+
+    auto const objPath = (fs::path{outDir} /= "parts.obj").string();
+
+    {
+        std::ofstream fh{objPath, std::ios::binary};
+        fh << partsObj();
+    }
+
+    TextureMap textures;
+
+    auto const mesh = loadWavefrontObjFile(objPath, textures);
+
+    // o and g records split the faces, empty groups vanish
+    {
+        auto const & parts = mesh.parts;
+
+        expect(parts.size() == 3, "part count");
+
+        if (parts.size() == 3)
+        {
+            expect(parts[0].name == "" && parts[0].firstFace == 0 && parts[0].faceCount == 2, "unnamed part");
+            expect(parts[1].name == "left side" && parts[1].firstFace == 2 && parts[1].faceCount == 1, "object part");
+            expect(parts[2].name == "wheels" && parts[2].firstFace == 3 && parts[2].faceCount == 2, "group part");
+
+            auto const & b = parts[1].bounds;
+
+            expect(b.lo.x == -11 && b.lo.y == 0 && b.hi.x == -10 && b.hi.y == 2, "object box");
+            expect(b.center.x == -10.5 && b.center.y == 1 && std::abs(b.radius - std::sqrt(1.25)) < 1e-12, "object sphere");
+
+            // reaches back to the first vertex
+            expect(parts[2].bounds.lo.x == 0 && parts[2].bounds.hi.x == 12, "shared vertex bounds");
+        }
+
+        for (auto const & part : parts) {
+            expect(encloses(mesh, part), "bounds enclose faces");
+        }
+    }
+
+    // chunks split mid group still give the same parts
+    {
+        ObjLoadOptions chunked{};
+        chunked.threads = 8;
+        chunked.minChunkBytes = 1;
+
+        expect(sameParts(mesh.parts, loadWavefrontObjFile(objPath, textures, chunked).parts), "chunked parts");
+    }
+
+    // parts survive the mesh cache, welding and writing
+    {
+        auto const view = makeMeshView(mesh);
+
+        expect(view.valid() && sameParts(mesh.parts, view.parts), "cached parts");
+        expect(sameParts(mesh.parts, toMesh(view).parts), "parts copied from view");
+
+        auto const welded = weldMesh(mesh);
+
+        bool inRange = welded.parts.size() == mesh.parts.size();
+
+        for (auto const & part : welded.parts)
+        {
+            for (size_t i = 3 * part.firstFace; i < 3 * (part.firstFace + part.faceCount); i++) {
+                inRange = inRange && welded.indices[i] >= part.firstVertex
+                    && welded.indices[i] < part.firstVertex + part.vertexCount;
+            }
+        }
+
+        expect(inRange, "welded vertex ranges");
+
+        auto const savedPath = (fs::path{outDir} /= "saved.obj").string();
+
+        saveWavefrontObjFile(savedPath, mesh);
+
+        expect(sameParts(mesh.parts, loadWavefrontObjFile(savedPath, textures).parts), "saved parts");
+    }
+
+    // culling parts keeps the image the same while skipping
+    // the instances off screen
+    {
+        SceneGenParams params{};
+        params.triangles = 200000;
+        params.instances = 400;
+        params.extent = 12.0;
+
+        TextureMap sceneTextures;
+
+        auto const scene = generateScene(params, sceneTextures);
+
+        expect(scene.parts.size() == 400, "one part per instance");
+
+        Camera cam{5.0029999, -5.29348290, 5.102934};
+
+        PixPoint sz{400, 300};
+
+        std::vector<Light> lights{Light{Vec3{4.07625, 1.00545, 5.90386}, RgbReal{0.8, 0.8, 0.8}}};
+
+        auto const [ M, M_cam ] = getViewTransforms(cam, sz, ViewVolume{});
+
+        auto const frustum = makeViewFrustum(M, sz.x, sz.y);
+
+        // the point the camera looks at against one far off
+        // to the side
+        expect(!frustum.outside(Bounds{{}, {}, Vec3{0.0, 0.0, 0.0}, 0.1}), "center visible");
+        expect(frustum.outside(Bounds{{}, {}, Vec3{-40.0, -40.0, 0.0}, 0.1}), "far side culled");
+
+        std::vector<IndexedMesh> welded{weldMesh(scene)};
+        std::vector<QuantizedMesh> quantized{quantizeMesh(welded[0])};
+
+        auto const drawBoth = [&](auto const & meshes, char const * label) {
+            Stats stats;
+
+            RasterOptions opts{};
+            opts.stats = &stats;
+            opts.cullParts = false;
+
+            DepthBufImage all{sz};
+            all.reset();
+
+            drawColorScene(all, lights, meshes, sceneTextures, M, M_cam, opts);
+
+            opts.cullParts = true;
+
+            DepthBufImage culled{sz};
+            culled.reset();
+
+            drawColorScene(culled, lights, meshes, sceneTextures, M, M_cam, opts);
+
+            auto const skipped = stats.metrics["faces_culled"].back();
+
+            cout << label << ": culled " << skipped << " of " << scene.faces.size() << " faces" << endl;
+
+            expect(skipped > 0 && skipped < static_cast<double>(scene.faces.size()), label);
+            expect(std::memcmp(all.pixels, culled.pixels, static_cast<size_t>(all.size) * sizeof(Rgb)) == 0, "same pixels");
+            expect(std::memcmp(all.zbuf, culled.zbuf, static_cast<size_t>(all.size) * sizeof(Real)) == 0, "same depths");
+        };
+
+        drawBoth(std::vector<Mesh>{scene}, "mesh");
+        drawBoth(welded, "welded");
+        drawBoth(quantized, "quantized");
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::meshPartsTestMain(argc, argv);
+}
@@ -0,0 +1,247 @@
+#include "raster/draw_scene.h"
+#include "world/meshlets.h"
+#include "world/scene_gen.h"
+#include "world/indexed_mesh.h"
+#include "world/quantized_mesh.h"
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <cstring>
+
+namespace CxxRay {
+
+// a face's corners and material, to compare face sets
+static
+std::vector<std::array<uint32_t,4>>
+faceSet(
+    IndexedMesh const & mesh)
+{
+    std::vector<std::array<uint32_t,4>> out;
+
+    for (size_t f = 0; f < mesh.faceCount(); f++)
+    {
+        auto const * I = mesh.indices.data() + 3 * f;
+
+        out.push_back({I[0], I[1], I[2], mesh.faceMtls[f]});
+    }
+
+    std::sort(out.begin(), out.end());
+
+    return out;
+}
+
+int meshletsTestMain(int, char**)
+{
+    using std::cout;
+    using std::endl;
+
+    cout << "meshletsTestMain" << endl;
+
+    bool ok = true;
+
+    auto const expect = [&ok](bool const cond, char const * what) {
+        if (!cond) {
+            cout << "FAILED: " << what << endl;
+            ok = false;
+        }
+    };
+
+    // a grid of closed spheres, some off screen
+    auto const sphere = makeIcosphere(4);
+
+    Mesh scene;
+
+    auto const mtlId = addFaceMtl(scene, sphere.faceMtl(0));
+
+    for (int y = -2; y < 2; y++) {
+        for (int x = -2; x < 2; x++) {
+            appendMeshInstance(scene, sphere, Vec3{3.0 * x + 1.5, 3.0 * y + 1.5, 0.0}, 1.2, mtlId);
+        }
+    }
+
+    auto const welded = weldMesh(scene);
+
+    MeshletOptions meshletOpts{};
+
+    auto clustered = welded;
+
+    buildMeshlets(clustered, meshletOpts);
+
+    auto const & clusters = clustered.meshlets;
+
+    cout << clusters.size() << " meshlets for " << clustered.faceCount() << " faces" << endl;
+
+    // runs covering every face in order, within a part,
+    // the same faces as before
+    {
+        bool inOrder = true;
+        bool small = true;
+        bool inPart = true;
+
+        size_t next = 0;
+        size_t part = 0;
+
+        for (auto const & m : clusters)
+        {
+            inOrder = inOrder && m.firstFace == next && m.faceCount > 0;
+            small = small && m.faceCount <= meshletOpts.maxFaces;
+
+            auto const & p = clustered.parts[part];
+
+            if (m.firstFace >= p.firstFace + p.faceCount) {
+                part++;
+            }
+
+            auto const & q = clustered.parts[part];
+
+            inPart = inPart && m.firstFace >= q.firstFace
+                && m.firstFace + m.faceCount <= q.firstFace + q.faceCount;
+
+            next = m.firstFace + m.faceCount;
+        }
+
+        expect(inOrder && next == clustered.faceCount(), "meshlets cover the faces in order");
+        expect(small, "meshlet size");
+        expect(inPart, "meshlets stay in their part");
+        expect(clusters.size() * meshletOpts.maxFaces < 2 * clustered.faceCount(), "meshlets mostly full");
+        expect(faceSet(welded) == faceSet(clustered), "same faces");
+    }
+
+    // bounds hold every vertex, cones every face normal
+    {
+        bool enclosed = true;
+        bool coned = true;
+
+        size_t withCone = 0;
+
+        for (auto const & m : clusters)
+        {
+            auto const minDot = std::sqrt(1 - m.cone.cutoff * m.cone.cutoff);
+
+            withCone += m.cone.cutoff < 1 ? 1 : 0;
+
+            for (size_t f = m.firstFace; f < m.firstFace + m.faceCount; f++)
+            {
+                auto const * I = clustered.indices.data() + 3 * f;
+
+                auto const & a = clustered.vertices[I[0]].pos;
+                auto const & b = clustered.vertices[I[1]].pos;
+                auto const & c = clustered.vertices[I[2]].pos;
+
+                for (auto const & p : {a, b, c})
+                {
+                    auto const d = p - m.bounds.center;
+
+                    enclosed = enclosed && dot(d, d) <= m.bounds.radius * m.bounds.radius * (1 + 1e-12);
+                }
+
+                if (m.cone.cutoff < 1) {
+                    coned = coned && dot(meshlets::faceNormal(a, b, c), m.cone.axis) >= minDot - 1e-12;
+                }
+            }
+        }
+
+        cout << withCone << " meshlets have a normal cone" << endl;
+
+        expect(enclosed, "bounds enclose vertexes");
+        expect(coned, "cones hold face normals");
+        expect(withCone == clusters.size(), "every sphere meshlet has a cone");
+    }
+
+    Camera cam{5.0029999, -5.29348290, 5.102934};
+
+    PixPoint sz{400, 300};
+
+    std::vector<Light> lights{Light{Vec3{4.07625, 1.00545, 5.90386}, RgbReal{0.8, 0.8, 0.8}}};
+
+    auto const [ M, M_cam ] = getViewTransforms(cam, sz, ViewVolume{});
+
+    auto frustum = makeViewFrustum(M, sz.x, sz.y);
+    frustum.cullBackFaces = true;
+
+    // the camera point comes back out of the transform and
+    // every meshlet facing away has only back faces
+    {
+        expect(length(frustum.eyePos - cam.B.e) < 1e-9, "eye position");
+
+        size_t away = 0;
+        bool allBack = true;
+
+        for (auto const & m : clusters)
+        {
+            if (!frustum.facesAway(m)) {
+                continue;
+            }
+
+            away++;
+
+            for (size_t f = m.firstFace; f < m.firstFace + m.faceCount; f++)
+            {
+                auto const * I = clustered.indices.data() + 3 * f;
+
+                auto const & a = clustered.vertices[I[0]].pos;
+                auto const n = cross(clustered.vertices[I[1]].pos - a, clustered.vertices[I[2]].pos - a);
+
+                allBack = allBack && dot(n, a - frustum.eyePos) > 0;
+            }
+        }
+
+        cout << away << " of " << clusters.size() << " meshlets face away" << endl;
+
+        expect(away > clusters.size() / 4, "meshlets face away");
+        expect(allBack, "only back faces in meshlets facing away");
+    }
+
+    // culling meshlets draws the same as testing each face
+    std::vector<IndexedMesh> meshes{clustered};
+    std::vector<QuantizedMesh> quantized{quantizeMesh(clustered)};
+
+    auto const drawBoth = [&](auto const & drawn, char const * label) {
+        Stats stats;
+
+        RasterOptions opts{};
+        opts.stats = &stats;
+        opts.cullParts = false;
+        opts.cullBackFaces = true;
+
+        TextureMap textures;
+
+        DepthBufImage all{sz};
+        all.reset();
+
+        drawColorScene(all, lights, drawn, textures, M, M_cam, opts);
+
+        auto const backFaces = stats.metrics["back_faces"].back();
+
+        opts.cullParts = true;
+
+        DepthBufImage culled{sz};
+        culled.reset();
+
+        drawColorScene(culled, lights, drawn, textures, M, M_cam, opts);
+
+        auto const skipped = stats.metrics["faces_culled"].back();
+        auto const faces = static_cast<double>(clustered.faceCount());
+
+        cout << label << ": culled " << skipped << " of " << faces << " faces, "
+            << backFaces << " back faces without meshlets" << endl;
+
+        expect(skipped > 0.5 * faces, label);
+        expect(std::memcmp(all.pixels, culled.pixels, static_cast<size_t>(all.size) * sizeof(Rgb)) == 0, "same pixels");
+        expect(std::memcmp(all.zbuf, culled.zbuf, static_cast<size_t>(all.size) * sizeof(Real)) == 0, "same depths");
+    };
+
+    drawBoth(meshes, "welded");
+    drawBoth(quantized, "quantized");
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::meshletsTestMain(argc, argv);
+}
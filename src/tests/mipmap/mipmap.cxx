@@ -0,0 +1,174 @@
+#include "images.h"
+
+#include "image/mipmap.h"
+#include "image/texture_image.h"
+#include "raster/texture_sampler.h"
+#include "loaders/texture_cache.h"
+#include "loaders/image_file.h"
+
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <cmath>
+
+namespace CxxRay {
+
+static
+std::string
+getDefaultTex()
+{
+    namespace fs = std::filesystem;
+
+    return ((fs::path{"data"} /= "tex") /= "UVCheckerMap02-512.tga").string();
+}
+
+static
+Rgb
+grey(
+    int const v)
+{
+    Rgb p;
+    p.r = static_cast<ByteT>(v);
+    p.g = static_cast<ByteT>(v);
+    p.b = static_cast<ByteT>(v);
+    return p;
+}
+
+static
+bool
+near(
+    Real const a,
+    Real const b)
+{
+    return std::abs(a - b) < 1e-9;
+}
+
+int mipmapTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    namespace fs = std::filesystem;
+
+    cout << "mipmapTestMain" << endl;
+
+    string const infile = argc > 1 ? argv[1] : getDefaultTex();
+    string const cacheDir = argc > 2 ? argv[2] : "mipmap_test";
+
+    bool ok = true;
+
+    auto const expect = [&ok](bool const cond, char const * what) {
+        if (!cond) {
+            cout << "FAILED: " << what << endl;
+            ok = false;
+        }
+    };
+
+    // level sizes halve down to 1x1, odd sides round down
+    expect(mipLevelSizes(512, 512).size() == 9, "512x512 has 9 more levels");
+    expect(mipLevelSizes(1, 1).empty(), "1x1 has no more levels");
+
+    auto const odd = mipLevelSizes(5, 3);
+
+    expect(odd.size() == 2 && odd[0].w == 2 && odd[0].h == 1 && odd[1].w == 1 && odd[1].h == 1, "5x3 levels");
+
+    // 4x2 of greys, level 1 averages 2x2 blocks
+    {
+        TextureImage img{4, 2};
+
+        int const vals[] = {0, 10, 100, 200, 20, 30, 50, 51};
+
+        for (long i = 0; i < 8; i++) {
+            img.pixels[i] = grey(vals[i]);
+        }
+
+        generateMips(img);
+
+        expect(img.levels() == 3, "4x2 has 3 levels");
+        expect(img.levelTexel(1, 0, 0).r == 15 && img.levelTexel(1, 1, 0).r == 100, "2x2 block averages");
+        expect(img.levelTexel(2, 0, 0).r == 58, "last level averages all");
+    }
+
+    // the last column of an odd width is folded into the
+    // block before it
+    {
+        TextureImage img{3, 1};
+
+        img.pixels[0] = grey(30);
+        img.pixels[1] = grey(60);
+        img.pixels[2] = grey(90);
+
+        generateMips(img);
+
+        expect(img.levels() == 2 && img.levelTexel(1, 0, 0).r == 60, "odd width folds");
+    }
+
+    // bilinear hits texel centers exactly and blends halfway
+    // between them, trilinear at a whole level is bilinear
+    {
+        TextureImage img{2, 2};
+
+        img.pixels[0] = grey(0);
+        img.pixels[1] = grey(255);
+        img.pixels[2] = grey(0);
+        img.pixels[3] = grey(255);
+
+        generateMips(img);
+
+        expect(near(sampleBilinear(img, 0, 0.25, 0.25).r, 0.0), "bilinear texel center");
+        expect(near(sampleBilinear(img, 0, 0.75, 0.75).r, 1.0), "bilinear other center");
+        expect(near(sampleBilinear(img, 0, 0.5, 0.5).r, 0.5), "bilinear halfway");
+        expect(near(sampleBilinear(img, 0, 0.0, 0.0).r, 0.0), "bilinear clamps");
+
+        auto const tri = sampleTexture(img, 0.25, 0.25, 0.0, TextureFilter::Trilinear);
+        expect(near(tri.r, 0.0), "trilinear at level 0");
+
+        // level 1 is the 1x1 average
+        auto const mid = sampleTexture(img, 0.25, 0.25, 0.5, TextureFilter::Trilinear);
+        auto const l1 = static_cast<Real>(img.levelTexel(1, 0, 0).r) / 255;
+        expect(near(mid.r, 0.5 * l1), "trilinear blends levels");
+
+        auto const far = sampleTexture(img, 0.25, 0.25, 10.0, TextureFilter::Bilinear);
+        expect(near(far.r, l1), "lod clamps to the last level");
+    }
+
+    // one texel per pixel is level 0, four is level 2
+    {
+        TextureImage img{256, 128};
+
+        expect(near(textureLod(img, 1.0 / 256, 0, 0, 1.0 / 128), 0.0), "lod 0");
+        expect(near(textureLod(img, 4.0 / 256, 0, 0, 1.0 / 128), 2.0), "lod 2");
+        expect(near(textureLod(img, 0, 0, 0, 0), 0.0), "still uv");
+    }
+
+    // mapped textures carry the same chain as decoded ones
+    if (fs::is_regular_file(infile))
+    {
+        fs::remove_all(cacheDir);
+
+        auto const decoded = loadTexture(infile);
+
+        expect(decoded.levels() > 1, "decoded texture has mips");
+
+        auto const first = loadMappedTexture(infile, cacheDir);
+        auto const second = loadMappedTexture(infile, cacheDir);
+
+        expect(first.mapped() && second.mapped(), "mapped from the cache");
+        expect(sameMips(decoded, first) && sameMips(decoded, second), "mapped mips match");
+    }
+    else
+    {
+        cout << "Invalid input file: " << infile << endl;
+        ok = false;
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::mipmapTestMain(argc, argv);
+}
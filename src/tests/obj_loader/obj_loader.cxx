@@ -3,7 +3,12 @@
 
 #include <iostream>
 #include <filesystem>
+#include <fstream>
 #include <string>
+#include <algorithm>
+#include <type_traits>
+#include <tuple>
+#include <vector>
 
 namespace CxxRay {
 
@@ -16,12 +21,157 @@ getDefaultPath()
     return ((fs::path{"data"} /= "models") /= "icosphere.obj").string();
 }
 
+static
+bool
+sameMesh(
+    Mesh const & a,
+    Mesh const & b)
+{
+    if (a.faces.size() != b.faces.size() || a.verts.size() != b.verts.size() ||
+        a.norms.size() != b.norms.size() || a.uvs.size() != b.uvs.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.verts.size(); i++)
+    {
+        if (a.verts[i].x != b.verts[i].x || a.verts[i].y != b.verts[i].y || a.verts[i].z != b.verts[i].z) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < a.norms.size(); i++)
+    {
+        if (a.norms[i].x != b.norms[i].x || a.norms[i].y != b.norms[i].y || a.norms[i].z != b.norms[i].z) {
+            return false;
+        }
+    }
+
+    if (a.uvs != b.uvs) {
+        return false;
+    }
+
+    if (a.parts.size() != b.parts.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.parts.size(); i++)
+    {
+        auto const & p = a.parts[i];
+        auto const & q = b.parts[i];
+
+        if (p.name != q.name || p.firstFace != q.firstFace || p.faceCount != q.faceCount ||
+            p.bounds.radius != q.bounds.radius) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < a.faces.size(); i++)
+    {
+        if (!sameMtl(a.faceMtl(i), b.faceMtl(i)) ||
+            a.mtlNames[a.faces[i].mtlId] != b.mtlNames[b.faces[i].mtlId]) {
+            return false;
+        }
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            auto const & I = a.faces[i].vertexIndexes[k];
+            auto const & J = b.faces[i].vertexIndexes[k];
+
+            if (I.id != J.id || I.uvId != J.uvId || I.normId != J.normId) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// every record form the parser accepts, with CRLF and
+// LF endings, comments, blank lines and malformed lines
+// that are skipped
+static
+char const *
+recordsObj()
+{
+    return
+        "# leading comment\r\n"
+        "v 0 0 0\r\n"
+        "v 1 0 0 # trailing comment\n"
+        "\n"
+        "   \t \n"
+        "v 0 1 0\n"
+        "v 1.5e0 -2 0.25\r\n"
+        "v 1 x 0\n"
+        "v 1 2\n"
+        "vt 0.5 0.25\n"
+        "vt 1 1\r\n"
+        "vt 0.5\n"
+        "vn 0 0 1\n"
+        "vn 0 1 0\r\n"
+        "vn 0 1e 0\n"
+        "f 1//1 2//1 3//1\n"
+        "f 1/1 2/2 3/1\r\n"
+        "f 1/1/2 2/2/2 4/2/1\n"
+        "f -3/-2/-1 -2/-1/-1 -1/-1/-2\n"
+        "f 1 2\n"
+        "f 1/x/1 2 3\n"
+        "f 1 2 3 4\n"
+        "f 1 2 3x\n"
+        "  f 1 2 3   \r\n";
+}
+
+// the exact elements and references a load produced
+static
+bool
+hasContents(
+    Mesh const & mesh,
+    std::vector<Vec3> const & verts,
+    std::vector<std::tuple<Real,Real>> const & uvs,
+    std::vector<Vec3> const & norms,
+    std::vector<MeshFaceIndex> const & faces)
+{
+    auto const sameVec = [](Vec3 const & a, Vec3 const & b) {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    };
+
+    if (mesh.verts.size() != verts.size() || mesh.uvs.size() != uvs.size() ||
+        mesh.norms.size() != norms.size() || mesh.faces.size() != faces.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < verts.size(); i++) {
+        if (!sameVec(mesh.verts[i], verts[i])) { return false; }
+    }
+
+    for (size_t i = 0; i < uvs.size(); i++) {
+        if (mesh.uvs[i] != uvs[i]) { return false; }
+    }
+
+    for (size_t i = 0; i < norms.size(); i++) {
+        if (!sameVec(mesh.norms[i], norms[i])) { return false; }
+    }
+
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        for (size_t k = 0; k < 3; k++)
+        {
+            auto const & I = mesh.faces[i].vertexIndexes[k];
+            auto const & J = faces[i][k];
+
+            if (I.id != J.id || I.uvId != J.uvId || I.normId != J.normId) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 int objLoaderTestMain(int argc, char** argv)
 {
     using std::cout;
     using std::endl;
     using std::string;
-    using std::unordered_map;
 
     namespace fs = std::filesystem;
 
@@ -43,13 +193,197 @@ int objLoaderTestMain(int argc, char** argv)
     // Run Test
     cout << "Loading: " << infile << endl;
 
-    unordered_map<string,TextureImage> textures;
+    TextureMap textures;
 
     auto obj = loadWavefrontObjFile(infile, textures);
 
+    cout << "Faces: " << obj.faces.size() << endl;
+
+    // split into many small chunks parsed in parallel,
+    // the result must match the single threaded load
+    ObjLoadOptions serial{};
+    serial.threads = 1;
+
+    ObjLoadOptions chunked{};
+    chunked.threads = 8;
+    chunked.minChunkBytes = 1;
+
+    auto const one = loadWavefrontObjFile(infile, textures, serial);
+    auto const many = loadWavefrontObjFile(infile, textures, chunked);
+
+    if (!sameMesh(one, many)) {
+        cout << "CHUNKED LOAD MISMATCH" << endl;
+        return 1;
+    }
+
+    // fixture files are named after the input so runs on
+    // different models (ctest -j) do not overwrite them
+    auto const stem = fs::path{infile}.stem().string();
+
+    auto const fixture = [&stem](char const * name) {
+        return "obj_loader_test_" + stem + "_" + name;
+    };
+
+    auto const recordsFile = fixture("records.obj");
+    auto const firstMtl = fixture("first.mtl");
+    auto const lateMtl = fixture("late.mtl");
+    auto const texturesFile = fixture("textures.obj");
+
+    // each record form gives exactly these elements and
+    // references, serial and chunked, malformed lines are
+    // skipped and relative references resolved
+    {
+        {
+            std::ofstream obj{recordsFile, std::ios::binary};
+            obj << recordsObj();
+        }
+
+        std::vector<Vec3> const verts{{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1.5, -2, 0.25}};
+        std::vector<std::tuple<Real,Real>> const uvs{{0.5, 0.25}, {1, 1}};
+        std::vector<Vec3> const norms{{0, 0, 1}, {0, 1, 0}};
+
+        std::vector<MeshFaceIndex> const faces{
+            {MeshIndex{1, 0, 1}, MeshIndex{2, 0, 1}, MeshIndex{3, 0, 1}},
+            {MeshIndex{1, 1, 0}, MeshIndex{2, 2, 0}, MeshIndex{3, 1, 0}},
+            {MeshIndex{1, 1, 2}, MeshIndex{2, 2, 2}, MeshIndex{4, 2, 1}},
+            {MeshIndex{2, 1, 2}, MeshIndex{3, 2, 2}, MeshIndex{4, 2, 1}},
+            {MeshIndex{1, 0, 0}, MeshIndex{2, 0, 0}, MeshIndex{3, 0, 0}},
+        };
+
+        TextureMap noTextures;
+
+        for (auto const * opts : {&serial, &chunked})
+        {
+            auto const records = loadWavefrontObjFile(recordsFile, noTextures, *opts);
+
+            if (!hasContents(records, verts, uvs, norms, faces)) {
+                cout << "WRONG RECORDS: " << records.verts.size() << " verts, " << records.uvs.size()
+                    << " uvs, " << records.norms.size() << " norms, " << records.faces.size() << " faces" << endl;
+                return 1;
+            }
+        }
+    }
+
+    // textures decode in the background, those of an mtllib
+    // ahead of the geometry and of one after it must all be
+    // in the map once the load returns
+    auto const tex = [](char const * name) {
+        return ((fs::path{"data"} /= "tex") /= name).string();
+    };
+
+    auto const qoiTex = fixture("texture.qoi");
+
+    {
+        auto const img = loadTextureFile(tex("UVCheckerMap16-512.tga"));
+
+        saveQoiFile(qoiTex, img.pixels, img.w, img.h);
+    }
+
+    {
+        std::ofstream mtl{firstMtl};
+
+        mtl << "newmtl a\nmap_Kd " << tex("UVCheckerMap01-512.tga") << "\n"
+            << "newmtl b\nmap_Kd " << tex("UVCheckerMap02-512.tga") << "\n"
+            << "newmtl c\nmap_Kd " << tex("UVCheckerMap10-512.tga") << "\n";
+
+        std::ofstream late{lateMtl};
+
+        late << "newmtl d\nmap_Kd " << qoiTex << "\n";
+
+        std::ofstream obj{texturesFile};
+
+        obj << "mtllib " << firstMtl << "\n"
+            << "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n"
+            << "usemtl a\nf 1/1/1 2/1/1 3/1/1\n"
+            << "usemtl b\nf 1/1/1 2/1/1 3/1/1\n"
+            << "usemtl c\nf 1/1/1 2/1/1 3/1/1\n"
+            << "mtllib " << lateMtl << "\n"
+            << "usemtl d\nf 1/1/1 2/1/1 3/1/1\n";
+    }
+
+    TextureMap sceneTextures;
+
+    auto const scene = loadWavefrontObjFile(texturesFile, sceneTextures);
+
+    string const expected[] = {
+        tex("UVCheckerMap01-512.tga"),
+        tex("UVCheckerMap02-512.tga"),
+        tex("UVCheckerMap10-512.tga"),
+        qoiTex,
+    };
+
+    if (scene.faces.size() != 4 || sceneTextures.size() != 4) {
+        cout << "WRONG TEXTURED SCENE: " << scene.faces.size() << " faces, "
+            << sceneTextures.size() << " textures" << endl;
+        return 1;
+    }
+
+    for (size_t i = 0; i < 4; i++)
+    {
+        auto const & texName = scene.faceMtl(i).texName;
+
+        if (texName != expected[i] || sceneTextures.count(texName) == 0) {
+            cout << "FACE " << i << " HAS TEXTURE " << texName << endl;
+            return 1;
+        }
+
+        auto const & got = *sceneTextures.at(texName);
+        auto const want = loadTextureFile(texName);
+
+        if (got.w != want.w || got.h != want.h ||
+            !std::equal(got.pixels, got.pixels + got.w * got.h, want.pixels, [](Rgb const & a, Rgb const & b) {
+                return a.r == b.r && a.g == b.g && a.b == b.b;
+            }))
+        {
+            cout << "TEXTURE DIFFERS: " << texName << endl;
+            return 1;
+        }
+    }
+
+    // a second load into the same map shares what is
+    // already there instead of decoding it again
+    auto const first = sceneTextures.at(expected[0]);
+
+    loadWavefrontObjFile(texturesFile, sceneTextures);
+
+    if (sceneTextures.at(expected[0]) != first) {
+        cout << "TEXTURE LOADED TWICE" << endl;
+        return 1;
+    }
+
+    // saved reals read back exactly, tiny and huge ones too
+    {
+        auto const savedFile = fixture("saved.obj");
+
+        std::vector<Vec3> const verts{{1e-9, -2.5e-7, 0.1}, {123456789.125, 1.0 / 3.0, -0.0}, {6.02e23, 0, 1}};
+        std::vector<std::tuple<Real,Real>> const uvs{{1e-7, 0.7}};
+        std::vector<Vec3> const norms{{0, 0, 1}};
+        std::vector<MeshFaceIndex> const faces{{MeshIndex{1, 1, 1}, MeshIndex{2, 1, 1}, MeshIndex{3, 1, 1}}};
+
+        Mesh mesh;
+
+        auto const mtlId = addFaceMtl(mesh, MeshMtl{});
+
+        mesh.verts.assign(verts.begin(), verts.end());
+        mesh.uvs.assign(uvs.begin(), uvs.end());
+        mesh.norms.assign(norms.begin(), norms.end());
+        mesh.faces.push_back(MeshFace{mtlId, faces[0]});
+
+        saveWavefrontObjFile(savedFile, mesh);
+
+        TextureMap noTextures;
+
+        if (!hasContents(loadWavefrontObjFile(savedFile, noTextures), verts, uvs, norms, faces)) {
+            cout << "SAVED REALS DIFFER" << endl;
+            return 1;
+        }
+    }
+
     return 0;
 }
 
+static_assert(!std::is_copy_constructible_v<TextureImage>, "textures are shared, never copied");
+
 } // namespace CxxRay
 
 int main(int argc, char** argv)
@@ -0,0 +1,378 @@
+#include "loaders/ply.h"
+#include "loaders/wavefront_obj.h"
+#include "world/indexed_mesh.h"
+#include "image/texture_image.h"
+#include "utils/profiler.h"
+
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <cmath>
+
+namespace CxxRay {
+
+static
+std::string
+getDefaultPath()
+{
+    namespace fs = std::filesystem;
+
+    return ((fs::path{"data"} /= "models") /= "monkey.obj").string();
+}
+
+struct PlyLayout
+{
+    bool doubles = false;
+    bool normals = true;
+    bool uvs = true;
+
+    // vertex colors, an edge element and face flags the
+    // loader has to step over
+    bool extras = false;
+};
+
+// write the mesh as a binary PLY, put together here so
+// every layout the loader reads can be produced
+static
+void
+writePly(
+    std::string const & filePath,
+    IndexedMesh const & mesh,
+    PlyLayout const & layout)
+{
+    using std::string;
+
+    string const real = layout.doubles ? "double" : "float";
+
+    string out = "ply\nformat binary_little_endian 1.0\ncomment written by test_ply_loader\n";
+
+    out += "element vertex " + std::to_string(mesh.vertices.size()) + "\n";
+    out += "property " + real + " x\nproperty " + real + " y\nproperty " + real + " z\n";
+
+    if (layout.extras) {
+        out += "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+    }
+
+    if (layout.normals) {
+        out += "property " + real + " nx\nproperty " + real + " ny\nproperty " + real + " nz\n";
+    }
+
+    if (layout.uvs) {
+        out += "property " + real + " s\nproperty " + real + " t\n";
+    }
+
+    if (layout.extras) {
+        out += "element edge 1\nproperty int vertex1\nproperty int vertex2\n";
+    }
+
+    out += "element face " + std::to_string(mesh.faceCount()) + "\n";
+    out += layout.extras
+        ? "property list uchar uint vertex_indices\nproperty int flags\n"
+        : "property list uchar int vertex_indices\n";
+    out += "end_header\n";
+
+    auto const put = [&out](auto const val) {
+        out.append(reinterpret_cast<char const *>(&val), sizeof(val));
+    };
+
+    auto const putReal = [&put, &layout](Real const val) {
+        if (layout.doubles) {
+            put(val);
+        } else {
+            put(static_cast<float>(val));
+        }
+    };
+
+    for (auto const & vtx : mesh.vertices)
+    {
+        putReal(vtx.pos.x); putReal(vtx.pos.y); putReal(vtx.pos.z);
+
+        if (layout.extras) {
+            put(uint8_t{1}); put(uint8_t{2}); put(uint8_t{3});
+        }
+
+        if (layout.normals) {
+            putReal(vtx.norm.x); putReal(vtx.norm.y); putReal(vtx.norm.z);
+        }
+
+        if (layout.uvs) {
+            putReal(vtx.u); putReal(vtx.v);
+        }
+    }
+
+    if (layout.extras) {
+        put(int32_t{0}); put(int32_t{1});
+    }
+
+    for (size_t f = 0; f < mesh.faceCount(); f++)
+    {
+        put(uint8_t{3});
+
+        for (size_t k = 0; k < 3; k++) {
+            put(mesh.indices[3 * f + k]);
+        }
+
+        if (layout.extras) {
+            put(int32_t{7});
+        }
+    }
+
+    std::ofstream fh{filePath, std::ios::binary};
+    fh.write(out.data(), static_cast<std::streamsize>(out.size()));
+}
+
+static
+bool
+closeVec(
+    Vec3 const & a,
+    Vec3 const & b,
+    Real const eps)
+{
+    return std::abs(a.x - b.x) <= eps && std::abs(a.y - b.y) <= eps && std::abs(a.z - b.z) <= eps;
+}
+
+// the loaded mesh must have the source's triangles, with
+// vertexes equal to float precision or exactly for doubles
+static
+bool
+checkPly(
+    std::string const & label,
+    IndexedMesh const & src,
+    PlyLayout const & layout)
+{
+    using std::cout;
+    using std::endl;
+
+    auto const path = "ply_loader_test_" + label + ".ply";
+
+    writePly(path, src, layout);
+
+    Profiler timer;
+
+    auto const view = openPlyFile(path);
+    auto const mesh = weldMesh(view);
+
+    auto const time = timer.stop();
+
+    cout << label << ": " << mesh.vertices.size() << " vertexes, "
+        << mesh.faceCount() << " faces, time " << time << endl;
+
+    if (mesh.vertices.size() != src.vertices.size() || mesh.indices != src.indices) {
+        cout << label << ": WRONG TRIANGLES" << endl;
+        return false;
+    }
+
+    if (view.hasNormals != layout.normals || view.hasUvs != layout.uvs) {
+        cout << label << ": WRONG PROPERTIES FOUND" << endl;
+        return false;
+    }
+
+    Real const eps = layout.doubles ? 0.0 : 1e-6;
+
+    size_t flipped = 0;
+
+    for (size_t i = 0; i < src.vertices.size(); i++)
+    {
+        auto const & a = mesh.vertices[i];
+        auto const & b = src.vertices[i];
+
+        if (!closeVec(a.pos, b.pos, eps)) {
+            cout << label << ": WRONG POSITION " << i << endl;
+            return false;
+        }
+
+        if (layout.uvs && (std::abs(a.u - b.u) > eps || std::abs(a.v - b.v) > eps)) {
+            cout << label << ": WRONG UV " << i << endl;
+            return false;
+        }
+
+        if (layout.normals)
+        {
+            if (!closeVec(a.norm, b.norm, eps)) {
+                cout << label << ": WRONG NORMAL " << i << endl;
+                return false;
+            }
+        }
+        else
+        {
+            // computed normals are unit length and mostly
+            // agree with the modeled ones
+            if (std::abs(length(a.norm) - 1.0) > 1e-9) {
+                cout << label << ": COMPUTED NORMAL NOT UNIT " << i << endl;
+                return false;
+            }
+
+            if (dot(a.norm, b.norm) <= 0.0) {
+                flipped++;
+            }
+        }
+    }
+
+    if (flipped * 10 > src.vertices.size()) {
+        cout << label << ": COMPUTED NORMALS FACE AWAY: " << flipped << endl;
+        return false;
+    }
+
+    // the plain mesh copy must have the same corners
+    auto const plain = loadPlyFile(path);
+
+    if (plain.faces.size() != mesh.faceCount() || plain.verts.size() != mesh.vertices.size() ||
+        plain.uvs.size() != plain.verts.size()) {
+        cout << label << ": MESH COPY DIFFERS" << endl;
+        return false;
+    }
+
+    for (size_t f = 0; f < plain.faces.size(); f++)
+    {
+        for (size_t k = 0; k < 3; k++)
+        {
+            auto const & I = plain.faces[f].vertexIndexes[k];
+
+            if (static_cast<size_t>(I.id - 1) != mesh.indices[3 * f + k]
+                || I.normId != I.id || I.uvId != I.id)
+            {
+                cout << label << ": MESH COPY DIFFERS ON FACE " << f << endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int plyLoaderTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    namespace fs = std::filesystem;
+
+    cout << "plyLoaderTestMain" << endl;
+
+    string infile = argc > 1 ? argv[1] : getDefaultPath();
+
+    if (!fs::is_regular_file(infile))
+    {
+        cout << "Invalid model file: " << infile << endl;
+        return 1;
+    }
+
+    TextureMap textures;
+
+    auto const src = weldMesh(loadWavefrontObjFile(infile, textures));
+
+    bool ok = true;
+
+    ok = checkPly("float", src, PlyLayout{}) && ok;
+    ok = checkPly("extras", src, PlyLayout{false, true, true, true}) && ok;
+    ok = checkPly("double_bare", src, PlyLayout{true, false, false, false}) && ok;
+
+    // a quad is split into two triangles and gets the
+    // normal of its plane
+    {
+        string const path = "ply_loader_test_quad.ply";
+
+        string out = "ply\nformat binary_little_endian 1.0\n"
+            "element vertex 4\nproperty float x\nproperty float y\nproperty float z\n"
+            "element face 1\nproperty list uchar int vertex_indices\nend_header\n";
+
+        float const verts[] = {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0};
+        out.append(reinterpret_cast<char const *>(verts), sizeof(verts));
+
+        out += static_cast<char>(4);
+
+        int32_t const quad[] = {0, 1, 2, 3};
+        out.append(reinterpret_cast<char const *>(quad), sizeof(quad));
+
+        {
+            std::ofstream fh{path, std::ios::binary};
+            fh.write(out.data(), static_cast<std::streamsize>(out.size()));
+        }
+
+        auto const mesh = weldMesh(openPlyFile(path));
+
+        MeshVector<uint32_t> const expected = {0, 1, 2, 0, 2, 3};
+
+        if (mesh.indices != expected || !closeVec(mesh.vertices[3].norm, Vec3{0.0, 0.0, 1.0}, 1e-12)) {
+            cout << "QUAD NOT SPLIT INTO TRIANGLES" << endl;
+            ok = false;
+        }
+
+        // cut into the face list
+        out.resize(out.size() - 6);
+
+        {
+            std::ofstream fh{path, std::ios::binary};
+            fh.write(out.data(), static_cast<std::streamsize>(out.size()));
+        }
+
+        try {
+            openPlyFile(path);
+
+            cout << "TRUNCATED FILE ACCEPTED" << endl;
+            ok = false;
+        } catch (std::runtime_error const & e) {
+            cout << "Truncated file rejected: " << e.what() << endl;
+        }
+    }
+
+    // a face past the vertexes or a vertex count too large
+    // for 32 bit indexes is an error, not clamped
+    {
+        string const path = "ply_loader_test_bad.ply";
+
+        auto const rejected = [&path](string const & count, int32_t const index) {
+            string out = "ply\nformat binary_little_endian 1.0\n"
+                "element vertex " + count + "\nproperty float x\nproperty float y\nproperty float z\n"
+                "element face 1\nproperty list uchar int vertex_indices\nend_header\n";
+
+            float const verts[] = {0, 0, 0, 1, 0, 0, 1, 1, 0};
+            out.append(reinterpret_cast<char const *>(verts), sizeof(verts));
+
+            out += static_cast<char>(3);
+
+            int32_t const tri[] = {0, index, 2};
+            out.append(reinterpret_cast<char const *>(tri), sizeof(tri));
+
+            {
+                std::ofstream fh{path, std::ios::binary};
+                fh.write(out.data(), static_cast<std::streamsize>(out.size()));
+            }
+
+            try {
+                weldMesh(openPlyFile(path));
+            } catch (std::runtime_error const & e) {
+                cout << "Rejected: " << e.what() << endl;
+                return true;
+            }
+
+            return false;
+        };
+
+        if (rejected("3", 1)) {
+            cout << "GOOD FACE REJECTED" << endl;
+            ok = false;
+        }
+
+        if (!rejected("3", 3) || !rejected("3", -1)) {
+            cout << "FACE INDEX OUT OF RANGE ACCEPTED" << endl;
+            ok = false;
+        }
+
+        if (!rejected("4294967296", 1)) {
+            cout << "VERTEX COUNT PAST 32 BITS ACCEPTED" << endl;
+            ok = false;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::plyLoaderTestMain(argc, argv);
+}
@@ -0,0 +1,199 @@
+#include "images.h"
+
+#include "loaders/qoi.h"
+#include "loaders/image_file.h"
+#include "image/texture_image.h"
+
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace CxxRay {
+
+static
+std::string
+getDefaultTex()
+{
+    namespace fs = std::filesystem;
+
+    return ((fs::path{"data"} /= "tex") /= "UVCheckerMap09-512.tga").string();
+}
+
+static
+void
+writeBytes(
+    std::string const & filePath,
+    std::vector<unsigned char> const & bytes)
+{
+    std::ofstream fh{filePath, std::ios::binary};
+
+    fh.write(reinterpret_cast<char const *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+static
+std::vector<unsigned char>
+readBytes(
+    std::string const & filePath)
+{
+    std::ifstream fh{filePath, std::ios::binary};
+
+    return std::vector<unsigned char>{std::istreambuf_iterator<char>{fh}, std::istreambuf_iterator<char>{}};
+}
+
+int qoiTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+    using std::vector;
+
+    namespace fs = std::filesystem;
+
+    cout << "qoiTestMain" << endl;
+
+    string infile = argc > 1 ? argv[1] : getDefaultTex();
+
+    if (!fs::is_regular_file(infile))
+    {
+        cout << "Invalid input file: " << infile << endl;
+        return 1;
+    }
+
+    bool ok = true;
+
+    // a run of black matching the initial pixel, then one
+    // small step up and one back down to the same color
+    {
+        TextureImage img{4, 1};
+
+        img.pixels[0] = Rgb{0};
+        img.pixels[1] = Rgb{0};
+        img.pixels[2] = Rgb{1};
+        img.pixels[3] = Rgb{0};
+
+        vector<unsigned char> out;
+
+        auto const size = qoiParse::encode(img.pixels, img.w, img.h, out);
+
+        vector<unsigned char> const expected = {
+            'q', 'o', 'i', 'f', 0, 0, 0, 4, 0, 0, 0, 1, 3, 0,
+            0xc1, 0x7f, 0x55,
+            0, 0, 0, 0, 0, 0, 0, 1,
+        };
+
+        if (vector<unsigned char>(out.begin(), out.begin() + static_cast<long>(size)) != expected) {
+            cout << "ENCODED BYTES DIFFER" << endl;
+            ok = false;
+        }
+    }
+
+    // a hand written 1x2 RGBA file, the first pixel in the
+    // file is the top row so it lands in the last row here
+    {
+        string const path = "qoi_test_rgba.qoi";
+
+        writeBytes(path, {
+            'q', 'o', 'i', 'f', 0, 0, 0, 1, 0, 0, 0, 2, 4, 0,
+            0xff, 10, 20, 30, 128,
+            0xfe, 40, 50, 60,
+            0, 0, 0, 0, 0, 0, 0, 1,
+        });
+
+        auto const img = loadQoiFile(path);
+
+        auto const & top = img.pixels[1];
+        auto const & bottom = img.pixels[0];
+
+        if (img.w != 1 || img.h != 2
+            || top.r != 10 || top.g != 20 || top.b != 30
+            || bottom.r != 40 || bottom.g != 50 || bottom.b != 60)
+        {
+            cout << "RGBA FILE DECODED WRONG" << endl;
+            ok = false;
+        }
+    }
+
+    // textures and rendered frames must survive the trip
+    // unchanged and TGA and QOI files must load the same
+    auto const tex = loadTargaFile(infile);
+
+    TextureImage frame{320, 240};
+
+    for (long j = 0; j < frame.h; j++)
+    {
+        for (long i = 0; i < frame.w; i++)
+        {
+            // flat background with a gradient in the middle
+            auto const inside = i > 80 && i < 240 && j > 60 && j < 180;
+
+            frame.pixels[j * frame.w + i] = inside
+                ? Rgb{static_cast<int>(i), static_cast<int>(j), static_cast<int>((i * j) % 256)}
+                : Rgb{0};
+        }
+    }
+
+    struct Case
+    {
+        char const * name;
+        TextureImage const * img;
+    };
+
+    Case const cases[] = {
+        {"texture", &tex},
+        {"frame", &frame},
+    };
+
+    for (auto const & c : cases)
+    {
+        auto const tgaPath = string{"qoi_test_"} + c.name + ".tga";
+        auto const qoiPath = string{"qoi_test_"} + c.name + ".qoi";
+
+        saveImageFile(tgaPath, c.img->pixels, c.img->w, c.img->h);
+        saveImageFile(qoiPath, c.img->pixels, c.img->w, c.img->h);
+
+        cout << c.name << ": " << fs::file_size(tgaPath) << " bytes TGA, "
+            << fs::file_size(qoiPath) << " bytes QOI" << endl;
+
+        auto const loaded = loadTextureFile(qoiPath);
+
+        if (!samePixels(*c.img, loaded) || !samePixels(loadTextureFile(tgaPath), loaded)) {
+            cout << c.name << ": PIXELS DIFFER" << endl;
+            ok = false;
+        }
+    }
+
+    // a truncated file keeps what was decoded and leaves
+    // the rest black
+    {
+        auto bytes = readBytes("qoi_test_frame.qoi");
+
+        bytes.resize(bytes.size() / 2);
+
+        writeBytes("qoi_test_truncated.qoi", bytes);
+
+        auto const img = loadQoiFile("qoi_test_truncated.qoi");
+
+        auto const & kept = img.pixels[170 * img.w + 100];
+        auto const & source = frame.pixels[170 * frame.w + 100];
+        auto const & bottom = img.pixels[0];
+
+        if (img.w != frame.w || img.h != frame.h
+            || kept.r != source.r || kept.g != source.g || kept.b != source.b
+            || bottom.r != 0 || bottom.g != 0 || bottom.b != 0)
+        {
+            cout << "TRUNCATED FILE DECODED WRONG" << endl;
+            ok = false;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::qoiTestMain(argc, argv);
+}
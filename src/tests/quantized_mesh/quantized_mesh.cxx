@@ -0,0 +1,184 @@
+#include "world/quantized_mesh.h"
+#include "world/indexed_mesh.h"
+#include "world/scene_gen.h"
+#include "loaders/wavefront_obj.h"
+#include "image/texture_image.h"
+#include "utils/rand.h"
+
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+namespace CxxRay {
+
+// largest decoding errors over a whole mesh
+struct QuantizeErrors
+{
+    Vec3 pos = {};
+    Real normAngle = 0.0;
+    Real u = 0.0;
+    Real v = 0.0;
+};
+
+static
+QuantizeErrors
+measureErrors(
+    IndexedMesh const & mesh,
+    QuantizedMesh const & q)
+{
+    QuantizeErrors err{};
+
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        auto const & a = mesh.vertices[i];
+        auto const b = decodeVertex(q, q.vertices[i]);
+
+        err.pos.x = std::max(err.pos.x, std::abs(a.pos.x - b.pos.x));
+        err.pos.y = std::max(err.pos.y, std::abs(a.pos.y - b.pos.y));
+        err.pos.z = std::max(err.pos.z, std::abs(a.pos.z - b.pos.z));
+
+        err.u = std::max(err.u, std::abs(a.u - b.u));
+        err.v = std::max(err.v, std::abs(a.v - b.v));
+
+        if (length(a.norm) > 0.0)
+        {
+            auto const c = std::clamp(dot(unit(a.norm), b.norm), -1.0, 1.0);
+
+            err.normAngle = std::max(err.normAngle, std::acos(c));
+        }
+    }
+
+    return err;
+}
+
+// positions and uvs must be within half a step of the
+// source and normals within a small fixed angle
+static
+bool
+checkQuantize(
+    std::string const & label,
+    IndexedMesh const & mesh)
+{
+    using std::cout;
+    using std::endl;
+
+    // octahedral normals with 16 bit coordinates stay
+    // well inside a hundredth of a degree
+    constexpr Real kMaxNormAngle = 0.0002;
+
+    // room for rounding in the decode arithmetic
+    constexpr Real kSlack = 1.0 + 1e-9;
+
+    auto const q = quantizeMesh(mesh);
+    auto const err = measureErrors(mesh, q);
+
+    auto const before = mesh.vertices.size() * sizeof(MeshVertex);
+    auto const after = q.vertices.size() * sizeof(QuantizedVertex);
+
+    cout << label
+        << ": vertexes " << mesh.vertices.size()
+        << ", bytes " << before << " -> " << after
+        << ", pos err " << err.pos
+        << ", normal err " << err.normAngle
+        << ", uv err " << err.u << " " << err.v << endl;
+
+    bool ok = true;
+
+    auto const within = [&ok, &label](char const * what, Real const e, Real const bound) {
+        if (e > bound) {
+            cout << label << ": " << what << " ERROR " << e << " OVER BOUND " << bound << endl;
+            ok = false;
+        }
+    };
+
+    within("POSITION X", err.pos.x, 0.5 * q.posStep.x * kSlack);
+    within("POSITION Y", err.pos.y, 0.5 * q.posStep.y * kSlack);
+    within("POSITION Z", err.pos.z, 0.5 * q.posStep.z * kSlack);
+    within("U", err.u, 0.5 * q.uStep * kSlack);
+    within("V", err.v, 0.5 * q.vStep * kSlack);
+    within("NORMAL", err.normAngle, kMaxNormAngle);
+
+    if (q.indices != mesh.indices || q.faceMtls != mesh.faceMtls) {
+        cout << label << ": INDEXES CHANGED" << endl;
+        ok = false;
+    }
+
+    return ok;
+}
+
+// normals spread over the whole sphere including the
+// folded lower half and the poles
+static
+IndexedMesh
+makeNormalSweep()
+{
+    IndexedMesh mesh;
+
+    RandReal rnd{-1.0, 1.0, 7u};
+
+    for (int i = 0; i < 100000; i++)
+    {
+        MeshVertex vtx{};
+
+        vtx.pos = Vec3{get(rnd) * 1000.0, get(rnd), get(rnd) * 0.001};
+        vtx.norm = Vec3{get(rnd), get(rnd), get(rnd)};
+        vtx.u = get(rnd) * 4.0;
+        vtx.v = get(rnd);
+
+        mesh.vertices.push_back(vtx);
+    }
+
+    for (auto const & n : {Vec3{0.0, 0.0, 1.0}, Vec3{0.0, 0.0, -1.0}, Vec3{1.0, 0.0, 0.0}, Vec3{0.0, -1.0, 0.0}})
+    {
+        MeshVertex vtx{};
+        vtx.norm = n;
+
+        mesh.vertices.push_back(vtx);
+    }
+
+    return mesh;
+}
+
+int quantizedMeshTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    namespace fs = std::filesystem;
+
+    cout << "Test Quantized Mesh" << endl;
+
+    TextureMap textures;
+
+    bool ok = true;
+
+    auto const infile = argc > 1
+        ? string{argv[1]}
+        : ((fs::path{"data"} /= "models") /= "monkey.obj").string();
+
+    ok = checkQuantize(infile, weldMesh(loadWavefrontObjFile(infile, textures))) && ok;
+
+    {
+        SceneGenParams params{};
+        params.shape = SceneShape::Terrain;
+        params.sizeDist = TriangleSizeDist::Varied;
+        params.triangles = 50000;
+        params.instances = 8;
+
+        ok = checkQuantize("generated", weldMesh(generateScene(params, textures))) && ok;
+    }
+
+    ok = checkQuantize("normal sweep", makeNormalSweep()) && ok;
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::quantizedMeshTestMain(argc, argv);
+}
@@ -0,0 +1,248 @@
+#include "world/scene_gen.h"
+#include "loaders/wavefront_obj.h"
+#include "image/texture_image.h"
+#include "utils/profiler.h"
+
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <cmath>
+
+namespace CxxRay {
+
+static
+std::string
+getDefaultOutfile()
+{
+    namespace fs = std::filesystem;
+
+    return (fs::path{"."} /= "scene_gen_test_output.obj").string();
+}
+
+static
+bool
+checkIndexes(
+    Mesh const & mesh)
+{
+    auto const nv = static_cast<long long>(mesh.verts.size());
+    auto const nn = static_cast<long long>(mesh.norms.size());
+    auto const nt = static_cast<long long>(mesh.uvs.size());
+
+    for (auto const & face : mesh.faces)
+    {
+        for (auto const & I : face.vertexIndexes)
+        {
+            if (I.id < 1 || I.id > nv || I.normId < 1 || I.normId > nn || I.uvId < 1 || I.uvId > nt) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// the OBJ writer keeps six decimals
+static
+bool
+near(
+    Real const a,
+    Real const b)
+{
+    return std::abs(a - b) <= 1e-6;
+}
+
+static
+bool
+near(
+    Vec3 const & a,
+    Vec3 const & b)
+{
+    return near(a.x, b.x) && near(a.y, b.y) && near(a.z, b.z);
+}
+
+// same vertexes, faces, materials and parts as the mesh
+// written out
+static
+bool
+sameContents(
+    Mesh const & a,
+    Mesh const & b)
+{
+    if (a.verts.size() != b.verts.size() || a.norms.size() != b.norms.size() ||
+        a.uvs.size() != b.uvs.size() || a.faces.size() != b.faces.size() ||
+        a.parts.size() != b.parts.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.verts.size(); i++)
+    {
+        if (!near(a.verts[i], b.verts[i])) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < a.norms.size(); i++)
+    {
+        if (!near(a.norms[i], b.norms[i])) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < a.uvs.size(); i++)
+    {
+        auto const [ au, av ] = a.uvs[i];
+        auto const [ bu, bv ] = b.uvs[i];
+
+        if (!near(au, bu) || !near(av, bv)) {
+            return false;
+        }
+    }
+
+    for (size_t f = 0; f < a.faces.size(); f++)
+    {
+        auto const & fa = a.faces[f];
+        auto const & fb = b.faces[f];
+
+        if (!sameMtl(a.faceMtl(f), b.faceMtl(f)) || a.mtlNames[fa.mtlId] != b.mtlNames[fb.mtlId]) {
+            return false;
+        }
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            auto const & I = fa.vertexIndexes[k];
+            auto const & J = fb.vertexIndexes[k];
+
+            if (I.id != J.id || I.uvId != J.uvId || I.normId != J.normId) {
+                return false;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < a.parts.size(); i++)
+    {
+        auto const & pa = a.parts[i];
+        auto const & pb = b.parts[i];
+
+        if (pa.name != pb.name || pa.firstFace != pb.firstFace || pa.faceCount != pb.faceCount) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static
+bool
+runScene(
+    std::string const & label,
+    SceneGenParams const & params)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    TextureMap textures;
+
+    Profiler timer;
+
+    auto const mesh = generateScene(params, textures);
+
+    auto const time = timer.stop();
+
+    cout << label
+        << ": faces " << mesh.faces.size()
+        << ", verts " << mesh.verts.size()
+        << ", textures " << textures.size()
+        << ", time " << time << endl;
+
+    if (!checkIndexes(mesh)) {
+        cout << label << ": INDEX OUT OF RANGE" << endl;
+        return false;
+    }
+
+    if (textures.size() != static_cast<size_t>(params.textureCount)) {
+        cout << label << ": WRONG TEXTURE COUNT" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+int sceneGenTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    cout << "Test Scene Generator" << endl;
+
+    // optional triangle count for stress runs
+    long const triangles = argc > 1 ? std::stol(argv[1]) : 200000;
+
+    bool ok = true;
+
+    {
+        SceneGenParams params{};
+        params.triangles = triangles;
+
+        ok = runScene("icosphere", params) && ok;
+    }
+
+    {
+        SceneGenParams params{};
+        params.shape = SceneShape::Terrain;
+        params.sizeDist = TriangleSizeDist::Varied;
+        params.triangles = triangles;
+
+        ok = runScene("terrain", params) && ok;
+    }
+
+    {
+        SceneGenParams params{};
+        params.triangles = triangles;
+        params.instances = 50;
+        params.depthLayers = 4;
+        params.textureCount = 8;
+        params.textureSize = 64;
+        params.sizeDist = TriangleSizeDist::Varied;
+
+        ok = runScene("scattered", params) && ok;
+    }
+
+    // round trip through the OBJ writer and loader
+    {
+        TextureMap textures;
+
+        SceneGenParams params{};
+        params.triangles = 5000;
+        params.instances = 3;
+        params.textureCount = 2;
+        params.textureSize = 16;
+
+        auto const mesh = generateScene(params, textures);
+
+        auto const outfile = getDefaultOutfile();
+
+        cout << "Saving to: " << outfile << endl;
+        saveWavefrontObjFile(outfile, mesh);
+
+        auto const loaded = loadWavefrontObjFile(outfile, textures);
+
+        bool const same = sameContents(mesh, loaded);
+
+        if (!same) {
+            cout << "ROUND TRIP MISMATCH" << endl;
+        }
+
+        ok = same && ok;
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::sceneGenTestMain(argc, argv);
+}
@@ -0,0 +1,395 @@
+#include "world/texture_atlas.h"
+#include "world/scene_gen.h"
+#include "raster/texture_sampler.h"
+#include "utils/rand.h"
+
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace CxxRay {
+
+static
+std::tuple<Real,Real>
+faceUv(
+    Mesh const & mesh,
+    MeshFace const & face,
+    Real const a,
+    Real const b)
+{
+    auto const & I = face.vertexIndexes;
+
+    auto const [ u0, v0 ] = mesh.uvs[static_cast<size_t>(I[0].uvId - 1)];
+    auto const [ u1, v1 ] = mesh.uvs[static_cast<size_t>(I[1].uvId - 1)];
+    auto const [ u2, v2 ] = mesh.uvs[static_cast<size_t>(I[2].uvId - 1)];
+
+    auto const c = 1 - a - b;
+
+    return {a * u0 + b * u1 + c * u2, a * v0 + b * v1 + c * v2};
+}
+
+static
+bool
+close(
+    RgbReal const & a,
+    RgbReal const & b)
+{
+    constexpr Real kTol = 1e-6;
+
+    return std::abs(a.r - b.r) < kTol && std::abs(a.g - b.g) < kTol && std::abs(a.b - b.b) < kTol;
+}
+
+// whether the nearest sample of tex at a uv within a
+// small fraction of a texel of (u, v) is expected, a uv
+// that lands on a texel edge may round to either texel
+// once the arithmetic is contracted (FMA)
+static
+bool
+nearestMatches(
+    TextureImage const & tex,
+    Real const u,
+    Real const v,
+    RgbReal const & expected)
+{
+    Real const d = 1e-6;
+
+    for (auto const du : {0.0, -d, d}) {
+        for (auto const dv : {0.0, -d, d})
+        {
+            auto const su = std::clamp(u + du, 0.0, 1.0);
+            auto const sv = std::clamp(v + dv, 0.0, 1.0);
+
+            if (close(sampleNearest(tex, su, sv), expected)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// each face gets a material of its own named after its
+// texture
+static
+void
+addTexturedFace(
+    Mesh & mesh,
+    std::string const & texName,
+    long long const a,
+    long long const b,
+    long long const c)
+{
+    MeshMtl mtl{};
+    mtl.texName = texName;
+
+    MeshFace face{};
+    face.mtlId = addFaceMtl(mesh, mtl, texName);
+    face.vertexIndexes = {MeshIndex{a, a, a}, MeshIndex{b, b, b}, MeshIndex{c, c, c}};
+
+    mesh.faces.push_back(face);
+}
+
+// an uncompressed copy with its mips, optionally
+// compressed
+static
+TextureHandle
+copyTexture(
+    TextureImage const & tex,
+    bool const compress)
+{
+    TextureImage out{tex.w, tex.h};
+
+    for (long y = 0; y < tex.h; y++) {
+        for (long x = 0; x < tex.w; x++) {
+            out.pixels[y * tex.w + x] = tex.texel(x, y);
+        }
+    }
+
+    generateMips(out);
+
+    if (compress) {
+        compressTexture(out);
+    }
+
+    return makeTextureHandle(std::move(out));
+}
+
+int textureAtlasTestMain(int, char**)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    cout << "textureAtlasTestMain" << endl;
+
+    bool ok = true;
+
+    auto const expect = [&ok](bool const cond, char const * what) {
+        if (!cond) {
+            cout << "FAILED: " << what << endl;
+            ok = false;
+        }
+    };
+
+    // packed cells stay inside their atlas and never overlap
+    {
+        RandReal<Real> randSize{1.0, 300.0, 7};
+
+        std::vector<std::tuple<long,long>> rects;
+
+        for (int i = 0; i < 200; i++) {
+            rects.push_back({static_cast<long>(get(randSize)), static_cast<long>(get(randSize))});
+        }
+
+        long const padding = 4;
+
+        std::vector<std::tuple<long,long>> sizes;
+
+        auto const packed = texAtlas::packShelves(rects, 1024, padding, sizes);
+
+        bool inside = true;
+        bool apart = true;
+
+        for (size_t i = 0; i < packed.size(); i++)
+        {
+            auto const & r = packed[i];
+            auto const [ aw, ah ] = sizes[static_cast<size_t>(r.atlas)];
+
+            inside = inside && r.w == std::get<0>(rects[i]) && r.h == std::get<1>(rects[i])
+                && r.x - padding >= 0 && r.y - padding >= 0
+                && r.x + r.w + padding <= aw && r.y + r.h + padding <= ah
+                && aw <= 1024 && ah <= 1024;
+
+            for (size_t j = 0; j < i; j++)
+            {
+                auto const & s = packed[j];
+
+                apart = apart && (r.atlas != s.atlas
+                    || r.x + r.w + padding <= s.x - padding || s.x + s.w + padding <= r.x - padding
+                    || r.y + r.h + padding <= s.y - padding || s.y + s.h + padding <= r.y - padding);
+            }
+        }
+
+        cout << "packed " << rects.size() << " rects into " << sizes.size() << " atlases" << endl;
+
+        expect(inside, "packed in bounds");
+        expect(apart, "packed apart");
+        expect(sizes.size() > 1, "overflow starts a new atlas");
+    }
+
+    // a generated scene with many small textures samples the
+    // same at level 0 from one atlas
+    {
+        SceneGenParams params{};
+        params.triangles = 20000;
+        params.instances = 60;
+        params.textureCount = 48;
+        params.textureSize = 32;
+
+        TextureMap textures;
+
+        auto mesh = generateScene(params, textures);
+
+        auto const before = mesh;
+        auto const originals = textures;
+
+        auto const result = buildTextureAtlases(mesh, textures);
+
+        std::set<string> used;
+
+        for (size_t i = 0; i < mesh.faces.size(); i++) {
+            used.insert(mesh.faceMtl(i).texName);
+        }
+
+        cout << "merged " << result.merged.size() << " textures into " << result.atlases.size()
+            << " atlases, " << textures.size() << " textures left" << endl;
+
+        expect(result.merged.size() == 48 && result.atlases.size() == 1, "all textures merged");
+        expect(used.size() == 1 && textures.size() == 1, "one texture in use");
+        expect(mesh.uvs.size() == before.uvs.size(), "unshared uvs moved in place");
+
+        long nearestMisses = 0;
+        long bilinearMisses = 0;
+
+        for (size_t i = 0; i < mesh.faces.size(); i++)
+        {
+            auto const & tex = *originals.at(before.faceMtl(i).texName);
+            auto const & atlas = *textures.at(mesh.faceMtl(i).texName);
+
+            // inset from the corners, whose uvs often sit on
+            // texel edges
+            for (auto const & [ a, b ] : {std::tuple<Real,Real>{0.3, 0.3}, {0.8, 0.1}, {0.1, 0.8}, {0.1, 0.7}})
+            {
+                auto const [ u, v ] = faceUv(before, before.faces[i], a, b);
+                auto const [ au, av ] = faceUv(mesh, mesh.faces[i], a, b);
+
+                if (!nearestMatches(tex, u, v, sampleNearest(atlas, au, av))) {
+                    nearestMisses++;
+                }
+
+                if (!close(sampleBilinear(tex, 0, u, v), sampleBilinear(atlas, 0, au, av))) {
+                    bilinearMisses++;
+                }
+            }
+        }
+
+        cout << "sample misses: nearest " << nearestMisses << ", bilinear " << bilinearMisses << endl;
+
+        expect(nearestMisses == 0, "nearest samples match");
+        expect(bilinearMisses == 0, "bilinear samples match");
+        expect(textures.begin()->second->levels() > 1, "atlas has mips");
+    }
+
+    // shared uvs are copied, textures that can not be merged
+    // keep their faces untouched
+    {
+        TextureMap textures;
+
+        generateTextures(3, 16, textures);
+
+        textures["big"] = makeTextureHandle(sceneGen::makeCheckerTexture(512, 8, Rgb{0}, Rgb{255}));
+
+        Mesh mesh;
+
+        for (int i = 0; i < 6; i++) {
+            mesh.uvs.push_back({0.25 * (i % 3), 0.5 * (i / 3)});
+        }
+
+        mesh.uvs.push_back({1.5, 0.5});
+
+        addTexturedFace(mesh, "gen_tex_0", 1, 2, 3);
+        addTexturedFace(mesh, "gen_tex_1", 1, 2, 4);
+        addTexturedFace(mesh, "gen_tex_2", 4, 5, 6);
+        addTexturedFace(mesh, "big", 5, 6, 4);
+        addTexturedFace(mesh, "", 6, 5, 4);
+
+        // wraps past the edge so it can not be merged
+        textures["wrapped"] = textures["gen_tex_1"];
+        addTexturedFace(mesh, "wrapped", 5, 6, 7);
+
+        auto const before = mesh;
+
+        auto const result = buildTextureAtlases(mesh, textures);
+
+        expect(result.merged.size() == 3 && result.atlases.size() == 1, "small textures merged");
+        expect(mesh.faceMtl(3).texName == "big" && mesh.faceMtl(5).texName == "wrapped", "others kept");
+
+        // the merged materials now have the same values but
+        // keep their own names
+        expect(sameMtl(mesh.faceMtl(0), mesh.faceMtl(1)) && mesh.mtlNames == before.mtlNames, "material names kept");
+        expect(textures.count("big") == 1 && textures.count("wrapped") == 1 && textures.count("gen_tex_0") == 0, "texture map updated");
+
+        // 1 and 2 are shared by two atlased faces, 4 by two
+        // atlased faces and others, 5 and 6 by an atlased
+        // face and others
+        expect(mesh.uvs.size() == before.uvs.size() + 8, "shared uvs copied");
+        expect(mesh.faces[0].vertexIndexes[2].uvId == 3, "unshared uv moved in place");
+
+        for (size_t f = 3; f < mesh.faces.size(); f++) {
+            for (size_t k = 0; k < 3; k++) {
+                auto const id = static_cast<size_t>(mesh.faces[f].vertexIndexes[k].uvId);
+
+                expect(id <= before.uvs.size() && mesh.uvs[id - 1] == before.uvs[id - 1], "unmerged faces untouched");
+            }
+        }
+    }
+
+    // compressed textures are packed from their uncompressed
+    // sources and the atlas compressed once, without sources
+    // they are left out
+    {
+        TextureMap plain;
+
+        generateTextures(4, 16, plain);
+
+        TextureMap compressed;
+
+        for (auto const & [ name, tex ] : plain) {
+            compressed[name] = copyTexture(*tex, true);
+        }
+
+        Mesh mesh;
+
+        for (int i = 0; i < 3; i++) {
+            mesh.uvs.push_back({0.5 * (i % 2), 0.5 * (i / 2)});
+        }
+
+        for (auto const & [ name, tex ] : plain) {
+            addTexturedFace(mesh, name, 1, 2, 3);
+        }
+
+        AtlasOptions bc1{};
+        bc1.format = TextureFormat::Bc1;
+        bc1.keepUncompressed = true;
+
+        {
+            auto unpacked = mesh;
+            auto textures = compressed;
+
+            auto const result = buildTextureAtlases(unpacked, textures, bc1);
+
+            expect(result.atlases.empty() && textures.size() == 4, "no compressed texture recompressed");
+        }
+
+        auto fromPlain = mesh;
+        auto plainTextures = plain;
+
+        auto const expected = buildTextureAtlases(fromPlain, plainTextures);
+
+        auto fromSources = mesh;
+        auto textures = compressed;
+
+        auto const result = buildTextureAtlases(fromSources, textures, bc1, plain);
+
+        expect(result.merged.size() == 4 && result.atlases.size() == 1, "compressed textures merged from sources");
+        expect(fromSources.uvs == fromPlain.uvs, "same packing as uncompressed");
+
+        if (result.atlases.size() == 1 && expected.atlases.size() == 1 && result.uncompressed.size() == 1)
+        {
+            auto const & atlas = *textures.at(result.atlases[0]);
+            auto const & reference = *plainTextures.at(expected.atlases[0]);
+
+            auto const once = copyTexture(reference, true);
+
+            bool keptSame = static_cast<long>(result.uncompressed[0].size()) == reference.w * reference.h;
+            bool compressedOnce = atlas.format == TextureFormat::Bc1 && atlas.w == once->w && atlas.h == once->h;
+
+            for (long y = 0; y < reference.h; y++)
+            {
+                for (long x = 0; x < reference.w; x++)
+                {
+                    auto const p = reference.texel(x, y);
+                    auto const q = atlas.texel(x, y);
+                    auto const r = once->texel(x, y);
+
+                    if (keptSame) {
+                        auto const k = result.uncompressed[0][static_cast<size_t>(y * reference.w + x)];
+
+                        keptSame = k.r == p.r && k.g == p.g && k.b == p.b;
+                    }
+
+                    compressedOnce = compressedOnce && q.r == r.r && q.g == r.g && q.b == r.b;
+                }
+            }
+
+            expect(keptSame, "uncompressed atlas kept");
+            expect(compressedOnce, "atlas compressed once");
+        }
+        else
+        {
+            expect(false, "one atlas each");
+        }
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::textureAtlasTestMain(argc, argv);
+}
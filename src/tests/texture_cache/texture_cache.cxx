@@ -0,0 +1,122 @@
+#include "images.h"
+
+#include "loaders/texture_cache.h"
+#include "loaders/image_file.h"
+#include "image/texture_image.h"
+#include "utils/profiler.h"
+
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace CxxRay {
+
+static
+std::string
+getDefaultTex()
+{
+    namespace fs = std::filesystem;
+
+    return ((fs::path{"data"} /= "tex") /= "UVCheckerMap02-512.tga").string();
+}
+
+int textureCacheTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    namespace fs = std::filesystem;
+
+    cout << "textureCacheTestMain" << endl;
+
+    string const infile = argc > 1 ? argv[1] : getDefaultTex();
+    string const cacheDir = argc > 2 ? argv[2] : "texture_cache_test";
+
+    if (!fs::is_regular_file(infile))
+    {
+        cout << "Invalid input file: " << infile << endl;
+        return 1;
+    }
+
+    // work on a copy so its time stamp can be changed
+    auto const texPath = (fs::path{cacheDir} /= ("source" + fs::path{infile}.extension().string())).string();
+
+    fs::remove_all(cacheDir);
+    fs::create_directories(cacheDir);
+    fs::copy_file(infile, texPath);
+
+    auto const decoded = loadTextureFile(texPath);
+
+    bool ok = true;
+
+    auto const check = [&](char const * label) {
+        Profiler timer;
+
+        auto const img = loadMappedTexture(texPath, cacheDir);
+
+        auto const time = timer.stop();
+
+        cout << label << ": " << (img.mapped() ? "mapped" : "decoded") << ", time " << time << endl;
+
+        if (!img.mapped()) {
+            cout << label << ": NOT MAPPED" << endl;
+            ok = false;
+        }
+
+        if (!sameTexels(img, decoded)) {
+            cout << label << ": TEXELS DIFFER" << endl;
+            ok = false;
+        }
+    };
+
+    // the first load writes the cache and maps it, the
+    // second maps the file written by the first
+    check("first load");
+    check("cached load");
+
+    auto const cachePath = textureCachePath(texPath, cacheDir);
+
+    if (!fs::is_regular_file(cachePath)) {
+        cout << "NO CACHE FILE: " << cachePath << endl;
+        ok = false;
+    }
+
+    // handles keep the mapping alive after the load
+    {
+        auto const handle = makeTextureHandle(loadMappedTexture(texPath, cacheDir));
+
+        TextureMap textures;
+        textures[texPath] = handle;
+
+        if (!sameTexels(*textures.at(texPath), decoded)) {
+            cout << "SHARED TEXELS DIFFER" << endl;
+            ok = false;
+        }
+    }
+
+    // a changed source or a damaged cache file is rebuilt
+    fs::last_write_time(texPath, fs::last_write_time(texPath) + std::chrono::seconds{10});
+
+    check("after source change");
+
+    fs::resize_file(cachePath, fs::file_size(cachePath) / 2);
+
+    check("after damage");
+
+    // without a cache directory the texture is decoded
+    if (loadTexture(texPath).mapped() || !loadTexture(texPath, cacheDir).mapped()) {
+        cout << "WRONG LOAD PATH" << endl;
+        ok = false;
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::textureCacheTestMain(argc, argv);
+}
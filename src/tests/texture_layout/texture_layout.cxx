@@ -0,0 +1,240 @@
+#include "images.h"
+
+#include "image/texel_layout.h"
+#include "image/texture_image.h"
+#include "image/mipmap.h"
+#include "loaders/texture_cache.h"
+#include "utils/profiler.h"
+#include "utils/stats.h"
+
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cmath>
+
+namespace CxxRay {
+
+static
+std::string
+getDefaultTex()
+{
+    namespace fs = std::filesystem;
+
+    return ((fs::path{"data"} /= "tex") /= "UVCheckerMap02-512.tga").string();
+}
+
+// every texel of a w by h image lands on its own slot
+static
+bool
+checkIndexes(
+    TexelLayout const layout,
+    long const w,
+    long const h)
+{
+    std::vector<char> used(static_cast<size_t>(layoutTexels(layout, w, h)), 0);
+
+    for (long y = 0; y < h; y++)
+    {
+        for (long x = 0; x < w; x++)
+        {
+            auto const i = texelIndex(layout, w, x, y);
+
+            if (i < 0 || i >= static_cast<long>(used.size()) || used[static_cast<size_t>(i)]) {
+                return false;
+            }
+
+            used[static_cast<size_t>(i)] = 1;
+        }
+    }
+
+    return true;
+}
+
+// texture too large for the caches, filled with a pattern
+// that differs texel to texel
+static
+TextureImage
+makeBigTexture(
+    long const size)
+{
+    TextureImage img{size, size};
+
+    for (long y = 0; y < size; y++)
+    {
+        for (long x = 0; x < size; x++)
+        {
+            auto & p = img.pixels[y * size + x];
+
+            p.r = static_cast<ByteT>(x * 7 + y);
+            p.g = static_cast<ByteT>(x ^ y);
+            p.b = static_cast<ByteT>(y * 3);
+        }
+    }
+
+    return img;
+}
+
+// walk a square of screen pixels over a texture rotated by
+// angle degrees and stretched by scale texels per pixel, the
+// way a rasterizer walks a rotated face, returns the time
+//
+// the texture size must be a power of 2 so wrapping around
+// it is a mask and the walk is bound by the texel reads
+static
+double
+walkTexture(
+    TextureImage const & tex,
+    double const angle,
+    double const scale,
+    long const pixels,
+    unsigned long & sum)
+{
+    double const rad = angle * 3.14159265358979323846 / 180.0;
+
+    // 16.16 fixed point steps across and up the screen
+    auto const fixed = [](double const d) { return static_cast<long>(std::lround(d * 65536.0)); };
+
+    auto const dux = fixed(std::cos(rad) * scale);
+    auto const dvx = fixed(std::sin(rad) * scale);
+    auto const duy = -dvx;
+    auto const dvy = dux;
+
+    auto const maskX = tex.w - 1;
+    auto const maskY = tex.h - 1;
+
+    Profiler timer;
+
+    for (long py = 0; py < pixels; py++)
+    {
+        auto u = py * duy;
+        auto v = py * dvy;
+
+        for (long px = 0; px < pixels; px++)
+        {
+            auto const p = tex.texel((u >> 16) & maskX, (v >> 16) & maskY);
+
+            sum += p.r + p.g + p.b;
+
+            u += dux;
+            v += dvx;
+        }
+    }
+
+    return timer.stop();
+}
+
+int textureLayoutTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    namespace fs = std::filesystem;
+
+    cout << "textureLayoutTestMain" << endl;
+
+    string const infile = argc > 1 ? argv[1] : getDefaultTex();
+    string const cacheDir = argc > 2 ? argv[2] : "texture_layout_test";
+
+    // repetitions of each benchmark walk
+    long const reps = argc > 3 ? std::stol(argv[3]) : 3;
+
+    bool ok = true;
+
+    auto const expect = [&ok](bool const cond, char const * what) {
+        if (!cond) {
+            cout << "FAILED: " << what << endl;
+            ok = false;
+        }
+    };
+
+    expect(checkIndexes(TexelLayout::Blocked, 13, 5), "13x5 blocked indexes");
+    expect(checkIndexes(TexelLayout::Blocked, 64, 64), "64x64 blocked indexes");
+    expect(layoutTexels(TexelLayout::Blocked, 13, 5) == 8 * 16, "13x5 pads to whole blocks");
+    expect(texelIndex(TexelLayout::Blocked, 64, 1, 1) == 3, "morton order in a block");
+    expect(texelIndex(TexelLayout::Blocked, 64, 2, 1) == 6, "morton order across the block");
+    expect(texelIndex(TexelLayout::Blocked, 64, 4, 0) == 16, "second block");
+    expect(texelIndex(TexelLayout::Blocked, 64, 0, 4) == 16 * 16, "second row of blocks");
+
+    if (!fs::is_regular_file(infile))
+    {
+        cout << "Invalid input file: " << infile << endl;
+        return 1;
+    }
+
+    fs::remove_all(cacheDir);
+
+    // blocked textures read back the same texels at every
+    // level, decoded or mapped from the cache
+    {
+        auto const rowMajor = loadMippedTexture(infile);
+        auto const blocked = loadMippedTexture(infile, TexelLayout::Blocked);
+
+        expect(blocked.layout == TexelLayout::Blocked, "decoded blocked layout");
+        expect(sameMips(rowMajor, blocked), "decoded blocked texels");
+
+        auto const first = loadMappedTexture(infile, cacheDir, TexelLayout::Blocked);
+        auto const second = loadMappedTexture(infile, cacheDir, TexelLayout::Blocked);
+        auto const mappedRows = loadMappedTexture(infile, cacheDir);
+
+        expect(first.mapped() && second.mapped() && second.layout == TexelLayout::Blocked, "mapped blocked layout");
+        expect(sameMips(rowMajor, second), "mapped blocked texels");
+        expect(mappedRows.mapped() && mappedRows.layout == TexelLayout::RowMajor, "row major cache kept apart");
+    }
+
+    // time both layouts walking a 2048x2048 texture with a
+    // 1024x1024 square of pixels at angles, each layout's times are saved as a stats file
+    // so the two can be compared with bench_compare
+    auto rowMajor = makeBigTexture(2048);
+    generateMips(rowMajor);
+
+    auto blocked = makeBigTexture(2048);
+    generateMips(blocked);
+    relayoutTexture(blocked, TexelLayout::Blocked);
+
+    Stats rowStats;
+    rowStats.name = "texture_layout_row_major";
+
+    Stats blockStats;
+    blockStats.name = "texture_layout_blocked";
+
+    unsigned long rowSum = 0;
+    unsigned long blockSum = 0;
+
+    // with mipmaps the footprint stays near a texel a pixel
+    for (auto const scale : {0.5, 1.0, 1.5})
+    {
+        for (auto const angle : {0.0, 30.0, 45.0, 60.0, 90.0})
+        {
+            auto const metric = "walk_a" + std::to_string(static_cast<long>(angle))
+                + "_s" + std::to_string(static_cast<long>(scale * 10)) + "_ms";
+
+            for (long rep = 0; rep < reps; rep++)
+            {
+                record(rowStats, metric, walkTexture(rowMajor, angle, scale, 1024, rowSum));
+                record(blockStats, metric, walkTexture(blocked, angle, scale, 1024, blockSum));
+            }
+
+            auto const & rowTimes = rowStats.metrics[metric];
+            auto const & blockTimes = blockStats.metrics[metric];
+
+            cout << metric << ": row major " << rowTimes.back()
+                << ", blocked " << blockTimes.back() << endl;
+        }
+    }
+
+    expect(rowSum == blockSum, "both layouts read the same texels");
+
+    saveStatsFile("texture_layout_row_major.json", rowStats);
+    saveStatsFile("texture_layout_blocked.json", blockStats);
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::textureLayoutTestMain(argc, argv);
+}
@@ -0,0 +1,269 @@
+#include "images.h"
+
+#include "loaders/texture_cache.h"
+#include "loaders/image_file.h"
+#include "image/texture_image.h"
+#include "image/tiled_texture.h"
+#include "utils/profiler.h"
+
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <limits>
+#include <cstdint>
+
+namespace CxxRay {
+
+static
+std::string
+getDefaultTex()
+{
+    namespace fs = std::filesystem;
+
+    return ((fs::path{"data"} /= "tex") /= "UVCheckerMap02-512.tga").string();
+}
+
+int textureTilesTestMain(int argc, char** argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+
+    namespace fs = std::filesystem;
+
+    cout << "textureTilesTestMain" << endl;
+
+    string const infile = argc > 1 ? argv[1] : getDefaultTex();
+    string const cacheDir = argc > 2 ? argv[2] : "texture_tiles_test";
+
+    if (!fs::is_regular_file(infile))
+    {
+        cout << "Invalid input file: " << infile << endl;
+        return 1;
+    }
+
+    fs::remove_all(cacheDir);
+
+    auto const decoded = loadTextureFile(infile);
+
+    // not a divisor of the texture size so the right and
+    // top tiles are padded
+    long const tileSize = 48;
+
+    long const tilesX = (decoded.w + tileSize - 1) / tileSize;
+    long const tilesY = (decoded.h + tileSize - 1) / tileSize;
+
+    auto const tileBytes = static_cast<size_t>(tileSize * tileSize) * sizeof(Rgb);
+
+    bool ok = true;
+
+    // everything fits: each tile is read once and every
+    // other texel read is a hit
+    {
+        TileCache cache{static_cast<size_t>(tilesX * tilesY) * tileBytes};
+
+        Profiler timer;
+
+        auto const img = loadTiledTexture(infile, cacheDir, cache, tileSize);
+
+        cout << "first load: " << (img.tiled() ? "tiled" : "decoded") << ", time " << timer.stop() << endl;
+
+        if (!img.tiled() || !sameTexels(img, decoded)) {
+            cout << "FIRST LOAD TEXELS DIFFER" << endl;
+            ok = false;
+        }
+
+        auto const fetches = static_cast<uint64_t>(decoded.w * decoded.h);
+        auto const tiles = static_cast<uint64_t>(tilesX * tilesY);
+
+        cout << "hits " << cache.hitCount() << ", misses " << cache.misses
+            << ", evictions " << cache.evictions << endl;
+
+        if (cache.misses != tiles || cache.hitCount() + cache.misses != fetches || cache.evictions != 0) {
+            cout << "WRONG COUNTERS" << endl;
+            ok = false;
+        }
+    }
+
+    // a budget of four tiles keeps evicting but never grows
+    {
+        TileCache cache{4 * tileBytes};
+
+        auto const img = loadTiledTexture(infile, cacheDir, cache, tileSize);
+
+        if (!img.tiled() || !sameTexels(img, decoded)) {
+            cout << "SMALL BUDGET TEXELS DIFFER" << endl;
+            ok = false;
+        }
+
+        cout << "small budget: hits " << cache.hitCount() << ", misses " << cache.misses
+            << ", evictions " << cache.evictions << ", used " << cache.used << endl;
+
+        if (cache.evictions == 0 || cache.used > cache.budget || cache.misses - cache.evictions != cache.used / tileBytes) {
+            cout << "BUDGET NOT KEPT" << endl;
+            ok = false;
+        }
+
+        // threads sampling the same texture share the cache,
+        // each read counts once whichever thread made it
+        cache.resetCounters();
+
+        std::vector<std::thread> threads;
+        std::vector<char> same(4, 0);
+
+        for (size_t i = 0; i < same.size(); i++) {
+            threads.emplace_back([&img, &decoded, &same, i]() {
+                same[i] = sameTexels(img, decoded);
+            });
+        }
+
+        for (auto & t : threads) {
+            t.join();
+        }
+
+        for (auto const s : same)
+        {
+            if (!s) {
+                cout << "THREADED TEXELS DIFFER" << endl;
+                ok = false;
+            }
+        }
+
+        if (cache.used > cache.budget) {
+            cout << "THREADED BUDGET NOT KEPT" << endl;
+            ok = false;
+        }
+
+        if (cache.hitCount() + cache.misses != same.size() * static_cast<uint64_t>(decoded.w * decoded.h)) {
+            cout << "THREADED COUNTERS: hits " << cache.hitCount() << ", misses " << cache.misses << endl;
+            ok = false;
+        }
+    }
+
+    // a damaged tiled file is rebuilt
+    auto const tilePath = textureCachePath(infile, cacheDir, ".t" + std::to_string(tileSize) + ".cxtile");
+
+    if (!fs::is_regular_file(tilePath))
+    {
+        cout << "NO TILED FILE: " << tilePath << endl;
+        ok = false;
+    }
+    else
+    {
+        fs::resize_file(tilePath, fs::file_size(tilePath) / 2);
+
+        TileCache cache{};
+
+        auto const img = loadTiledTexture(infile, cacheDir, cache, tileSize);
+
+        if (!img.tiled() || !sameTexels(img, decoded)) {
+            cout << "REBUILT TEXELS DIFFER" << endl;
+            ok = false;
+        }
+
+        // cut short again while open and not yet read, the
+        // lost tiles read as kMissingTexel and are counted
+        TileCache unread{};
+
+        auto const cut = loadTiledTexture(infile, cacheDir, unread, tileSize);
+
+        fs::resize_file(tilePath, fs::file_size(tilePath) / 2);
+
+        bool missing = false;
+
+        for (long y = 0; y < cut.h; y++)
+        {
+            for (long x = 0; x < cut.w; x++)
+            {
+                auto const p = cut.texel(x, y);
+
+                missing = missing || (p.r == kMissingTexel.r && p.g == kMissingTexel.g && p.b == kMissingTexel.b);
+            }
+        }
+
+        cout << "short reads: " << unread.readErrors << endl;
+
+        if (unread.readErrors == 0 || !missing) {
+            cout << "SHORT READ NOT CAUGHT" << endl;
+            ok = false;
+        }
+    }
+
+    // a header with an absurd width is rejected before the
+    // tile count is worked out from it, and rebuilt
+    {
+        TileCache cache{};
+
+        loadTiledTexture(infile, cacheDir, cache, tileSize);
+
+        {
+            // w follows the magic, version and tile size
+            int64_t const w = std::numeric_limits<int64_t>::max();
+
+            std::fstream fh{tilePath, std::ios::binary | std::ios::in | std::ios::out};
+            fh.seekp(16);
+            fh.write(reinterpret_cast<char const *>(&w), sizeof(w));
+        }
+
+        auto const img = loadTiledTexture(infile, cacheDir, cache, tileSize);
+
+        if (!img.tiled() || !sameTexels(img, decoded)) {
+            cout << "BAD HEADER NOT REBUILT" << endl;
+            ok = false;
+        }
+    }
+
+    // two textures read in turn keep their own slots, so
+    // they go through the cache only once per tile
+    {
+        TileCache cache{};
+
+        auto const a = loadTiledTexture(infile, cacheDir, cache, tileSize);
+        auto const b = loadTiledTexture(infile, cacheDir, cache, tileSize);
+
+        for (long y = 0; y < tileSize; y++)
+        {
+            for (long x = 0; x < tileSize; x++)
+            {
+                a.texel(x, y);
+                b.texel(x, y);
+            }
+        }
+
+        if (cache.misses != 2 || cache.hitCount() != static_cast<uint64_t>(2 * tileSize * tileSize - 2)) {
+            cout << "ALTERNATING TEXTURES: hits " << cache.hitCount() << ", misses " << cache.misses << endl;
+            ok = false;
+        }
+    }
+
+    // tiles are only used with a tile cache given
+    {
+        TileCache cache{};
+
+        TextureLoadOptions opts{};
+        opts.cacheDir = cacheDir;
+
+        auto const mapped = loadTexture(infile, opts);
+
+        opts.tileCache = &cache;
+
+        auto const tiled = loadTexture(infile, opts);
+
+        if (!mapped.mapped() || mapped.tiled() || !tiled.tiled()) {
+            cout << "WRONG LOAD PATH" << endl;
+            ok = false;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
+
+} // namespace CxxRay
+
+int main(int argc, char** argv)
+{
+    return CxxRay::textureTilesTestMain(argc, argv);
+}
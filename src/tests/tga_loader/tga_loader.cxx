@@ -1,10 +1,17 @@
+#include "images.h"
+
 #include "loaders/tga.h"
+#include "loaders/ppm.h"
 #include "image/texture_image.h"
+#include "image/swizzle.h"
 
 #include <iostream>
 #include <filesystem>
 #include <fstream>
 #include <string>
+#include <iterator>
+#include <vector>
+#include <cstring>
 
 namespace CxxRay {
 
@@ -26,6 +33,153 @@ getDefaultOutfile()
     return (fs::path{"."} /= "tga_loader_test_output.tga").string();
 }
 
+// write the image in one of the layouts the loader
+// reads, bytes are put together here rather than with
+// saveTargaFile so every variant can be produced
+static
+void
+writeTargaVariant(
+    std::string const & filePath,
+    TextureImage const & img,
+    bool const rle,
+    int const depth,
+    bool const topOrigin)
+{
+    using namespace tgaParse;
+
+    std::string out = "";
+
+    auto const word = [&out](long const v) {
+        out += static_cast<char>(v & 0xff);
+        out += static_cast<char>((v >> 8) & 0xff);
+    };
+
+    out += '\0';
+    out += '\0';
+    out += static_cast<char>(rle ? 10 : 2);
+    word(0); word(0);
+    out += '\0';
+    word(0); word(0);
+    word(img.w); word(img.h);
+    out += static_cast<char>(depth);
+    out += static_cast<char>(topOrigin ? kTopOrigin : 0);
+
+    auto const pixel = [&img, topOrigin](long const i) {
+        auto const row = i / img.w;
+        auto const col = i % img.w;
+
+        return img.pixels[(topOrigin ? img.h - 1 - row : row) * img.w + col];
+    };
+
+    auto const put = [&out, depth](Rgb const & p) {
+        out += static_cast<char>(p.b);
+        out += static_cast<char>(p.g);
+        out += static_cast<char>(p.r);
+
+        if (depth == 32) {
+            out += static_cast<char>(0xff);
+        }
+    };
+
+    auto const same = [](Rgb const & a, Rgb const & b) {
+        return a.r == b.r && a.g == b.g && a.b == b.b;
+    };
+
+    long const count = img.w * img.h;
+
+    for (long i = 0; i < count;)
+    {
+        if (!rle) {
+            put(pixel(i++));
+            continue;
+        }
+
+        // runs of equal pixels, otherwise literal packets
+        // up to the next run, packets may cross rows
+        long run = 1;
+
+        while (i + run < count && run < 128 && same(pixel(i + run), pixel(i))) {
+            run++;
+        }
+
+        if (run > 1)
+        {
+            out += static_cast<char>(0x80 | (run - 1));
+            put(pixel(i));
+            i += run;
+            continue;
+        }
+
+        long lit = 1;
+
+        while (i + lit < count && lit < 128 &&
+            !(i + lit + 1 < count && same(pixel(i + lit), pixel(i + lit + 1)))) {
+            lit++;
+        }
+
+        out += static_cast<char>(lit - 1);
+
+        for (long k = 0; k < lit; k++) {
+            put(pixel(i + k));
+        }
+
+        i += lit;
+    }
+
+    std::ofstream fh{filePath, std::ios::binary};
+    fh.write(out.data(), static_cast<std::streamsize>(out.size()));
+}
+
+// the SIMD and scalar swizzles give the same bytes for
+// every length around the shuffle widths
+static
+bool
+swizzlePathsMatch()
+{
+    for (size_t n = 0; n < 40; n++)
+    {
+        std::vector<unsigned char> src(4 * n + 1);
+
+        for (size_t i = 0; i < src.size(); i++) {
+            src[i] = static_cast<unsigned char>(i * 37 + 11);
+        }
+
+        std::vector<Rgb> simd(n + 1, Rgb{7});
+        std::vector<Rgb> scalar(n + 1, Rgb{7});
+
+        for (bool const alpha : {false, true})
+        {
+            if (alpha) {
+                bgraToRgb(src.data(), simd.data(), n, true);
+                bgraToRgb(src.data(), scalar.data(), n, false);
+            } else {
+                bgrToRgb(src.data(), simd.data(), n, true);
+                bgrToRgb(src.data(), scalar.data(), n, false);
+            }
+
+            // the pixel past the end is never written
+            if (std::memcmp(simd.data(), scalar.data(), 3 * (n + 1)) != 0 ||
+                scalar[n].r != 7 || scalar[n].g != 7 || scalar[n].b != 7)
+            {
+                std::cout << "SWIZZLE DIFFERS: " << n << (alpha ? " bgra" : " bgr") << " pixels" << std::endl;
+                return false;
+            }
+
+            auto const bpp = alpha ? 4u : 3u;
+
+            for (size_t i = 0; i < n; i++)
+            {
+                if (scalar[i].r != src[bpp * i + 2] || scalar[i].g != src[bpp * i + 1] || scalar[i].b != src[bpp * i]) {
+                    std::cout << "SWIZZLE WRONG: pixel " << i << " of " << n << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
 int tgaLoaderTestMain(int argc, char** argv)
 {
     std::cout << "tgaLoaderTestMain" << std::endl;
@@ -63,13 +217,92 @@ int tgaLoaderTestMain(int argc, char** argv)
     }
 
     // Run Test
+    cout << "SIMD swizzle: " << (swizzle::hasSsse3() ? "SSSE3" : "none") << endl;
+
+    bool ok = swizzlePathsMatch();
+
     cout << "Loading: " << infile << endl;
     TextureImage img = loadTargaFile(infile);
 
     cout << "Saving to: " << outfile << endl;
     saveTargaFile(outfile, img.pixels, img.w, img.h);
 
-    return 0;
+    if (!samePixels(img, loadTargaFile(outfile))) {
+        cout << "SAVED FILE DIFFERS" << endl;
+        ok = false;
+    }
+
+    // every supported layout must decode to the same pixels
+    struct Variant
+    {
+        char const * name;
+        bool rle;
+        int depth;
+        bool topOrigin;
+    };
+
+    Variant const variants[] = {
+        {"rle24", true, 24, false},
+        {"rle32", true, 32, false},
+        {"raw32", false, 32, false},
+        {"raw24top", false, 24, true},
+        {"rle32top", true, 32, true},
+    };
+
+    for (auto const & v : variants)
+    {
+        auto const path = (fs::path{outfile}.parent_path() /= (string{"tga_loader_test_"} + v.name + ".tga")).string();
+
+        writeTargaVariant(path, img, v.rle, v.depth, v.topOrigin);
+
+        cout << "Checking " << v.name << ": " << fs::file_size(path) << " bytes" << endl;
+
+        if (!samePixels(img, loadTargaFile(path))) {
+            cout << v.name << ": PIXELS DIFFER" << endl;
+            ok = false;
+        }
+    }
+
+    // the mapped writers must produce the same bytes as the
+    // buffered ones, PPM files must load back unchanged
+    auto const readBytes = [](string const & path) {
+        std::ifstream fh{path, std::ios::binary};
+
+        return string{std::istreambuf_iterator<char>{fh}, std::istreambuf_iterator<char>{}};
+    };
+
+    auto const outDir = fs::path{outfile}.parent_path();
+
+    auto const tgaBuffered = (fs::path{outDir} /= "tga_loader_test_buffered.tga").string();
+    auto const tgaMapped = (fs::path{outDir} /= "tga_loader_test_mapped.tga").string();
+    auto const ppmBuffered = (fs::path{outDir} /= "tga_loader_test_buffered.ppm").string();
+    auto const ppmMapped = (fs::path{outDir} /= "tga_loader_test_mapped.ppm").string();
+
+    saveTargaFile(tgaBuffered, img.pixels, img.w, img.h, ImageWriteMode::Buffered);
+    saveTargaFile(tgaMapped, img.pixels, img.w, img.h, ImageWriteMode::Mapped);
+
+    auto const w = static_cast<int>(img.w);
+    auto const h = static_cast<int>(img.h);
+
+    savePnmFile(ppmBuffered, img.pixels, w, h, 255, "P6", ImageWriteMode::Buffered);
+    savePnmFile(ppmMapped, img.pixels, w, h, 255, "P6", ImageWriteMode::Mapped);
+
+    if (readBytes(tgaBuffered) != readBytes(tgaMapped)) {
+        cout << "MAPPED TGA DIFFERS" << endl;
+        ok = false;
+    }
+
+    if (readBytes(ppmBuffered) != readBytes(ppmMapped)) {
+        cout << "MAPPED PPM DIFFERS" << endl;
+        ok = false;
+    }
+
+    if (!samePixels(img, loadPnmFile(ppmMapped))) {
+        cout << "PPM PIXELS DIFFER" << endl;
+        ok = false;
+    }
+
+    return ok ? 0 : 1;
 }
 
 } // namespace CxxRay